@@ -4,164 +4,99 @@
 	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
 */
 
-#include <sys/types.h>
-#include <sys/stat.h>
 #include <stdlib.h>
+#include <sstream>
+#include <pthread.h>
 #include "GaborGlobal.h"	// contains project-wide defines, constants, and globals
-#include "GaborJet.h"
-#include "ContrastFilter.h"
-#include "LogPolar.h"
+#include "GaborConfig.h"
+#include "GaborContext.h"
+#include "GaborService.h"
+#include "FrameStream.h"
+#include "Sweep.h"
+#include "ResultCache.h"
 #include "PGMImage.h"
+#include "Profiler.h"
+#include "WorkQueue.h"
 #include "Utilities.h"
 
-// use these defines to toggle the use of log-polar and contrastfilter
-#define kUseLogPolar	0
-#define kUseContrast	1
-// set to use color or grayscale
-#define	kUsingColor		0
-
-// GLOBAL 
-bool		kSaveFilter = true;	// in case of multiple files, we save GFs only once
-bool		kVerbosity = true; 	// whether to output any messages or not
-
-// LOCAL GLOBALS
-// These are the settings for the Gabor filter jet. These are of course modifiable.
-int			gx = 32;	//	-X	: horizontal size of filter
-int			gy = 32;	//	-Y	: vertical size of filter
-int			sx = 28;	//	-x	: horizontal spacing of filter, i.e. overlap is gx - sx pixels
-int			sy = 28;	//	-y	: vertical spacing of filter
-float		s = 2.0;	//	-s	: sigma modulator
-int			a = 8;		//	-a	: number of angles
-int			f = 1;		//	-f	: number of frequencies
-float		l = 1;		//	-l	: lower bound of frequency
-float		u = 2;		//	-u	: upper bound of frequency
+// GLOBAL
+GaborConfig		gConfig;	// settings from the command line, read-only once parsed
+GaborRegion*	gRegion = NULL;	// windows of the -R file, NULL to filter all of them
+ResultCache		gCache;		// responses of images filtered before, with -H
+uint64_t		gParams;	// hash of the settings, under which the cache keys the images
+
+// a list of files shared by the batch worker threads
+struct Batch
+{
+	char**		files;		// file names
+	float**		responses;	// response vector per file
+	int*		lengths;	// response length per file
+	int***		cells;		// lattice positions of the responses per file, NULL for all
+	int*		numCells;
+	WorkQueue*	queue;		// indices of files still to be filtered
+};
+
+// answers service requests with a context of its own
+class RequestHandler : public ServiceHandler
+{
+public:
+
+	RequestHandler() : mContext( gConfig ) { mContext.SetRegion( gRegion ); mResponse = NULL; mCapacity = 0; }
+	~RequestHandler() { delete[] mResponse; }
+
+	float*	Serve( GaborRequest* request, int* len, int* status );
+
+protected:
+
+	GaborContext	mContext;	// filter bank and scratch buffers, kept warm
+	PGMImage		mImage;		// pixel storage, reused for images of the same size
+	float*			mResponse;	// response vector, reused between requests
+	int				mCapacity;	// allocated length of the response vector
+};
 
 
 // PROTOTYPES
-float*		ProcessFile( char*, int***, int, int, float*, int* );
-float* 		ProcessChannel( float**, int, int, float*, int*, int, char* );
+float*		FilterFile( GaborContext* context, PGMImage* image, char* file, int* len );
+void		PrintResponse( char* file, float* response, int len, int** cells, int numCells );
+int			FilterStream( void );
+int			FilterSweep( char** files, int numFiles );
+void*		BatchWorker( void* batch );
+ServiceHandler*	CreateHandler( void );
 void		Usage( void );
 
 
 // process command line arguments and filter selected files
 int main( int argc, char *argv[] )
 {
-	int		arg;
-	char	file[256];
+	int				arg;
+	ostringstream	echo;
+
+	arg = gConfig.ParseOptions( argc, argv, 1, &echo );
+	if ( arg < 0 ) Usage();
+	Profiler::Start( gConfig.profile, gConfig.traceFile, gConfig.perfCounters );
 
-	cout << "# ";	
-	if ( argc > 1 )
+// the windows to filter, if not all of them
+	if ( gConfig.regionFile[0] != '\0' )
 	{
-	// run down each argument
-		arg = 1;
-		while( arg < argc )
-		{
-		// check if -h is called
-			if( strcmp( argv[arg], "-h") == 0 )
-			{
-				arg++;
-				Usage();
-			}
-			if( strcmp( argv[arg], "-X") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				cout << argv[arg] << " ";
-				gx = atoi( argv[arg] );
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-Y") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				cout << argv[arg] << " ";
-				gy = atoi( argv[arg] );
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-x") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				cout << argv[arg] << " ";
-				sx = atoi( argv[arg] );
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-y") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				cout << argv[arg] << " ";
-				sy = atoi( argv[arg] );
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-s") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				cout << argv[arg] << " ";
-				s = atof( argv[arg] );
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-a") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				cout << argv[arg] << " ";
-				a = atoi( argv[arg] );
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-f") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				f = atoi( argv[arg] );
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-l") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				cout << argv[arg] << " ";
-				l = atof( argv[arg] );
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-u") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				cout << argv[arg] << " ";
-				u = atof( argv[arg] );
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-v") == 0 )
-			{
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				kVerbosity = (bool)atoi( argv[arg] );
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-S") == 0 )
-			{
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				kSaveFilter = (bool)atoi( argv[arg] );
-				goto loop;
-			}
-			if( argv[arg][0] != '-' ) break;
-loop:
-			arg++;
-		}
+		gRegion = new GaborRegion;
+		if ( ! ReadRegion( gConfig.regionFile, gRegion ) ) return 0;
 	}
-	cout << endl;
+
+// run as a service, answering requests until told to quit
+	if ( gConfig.servicePath[0] != '\0' )
+	{
+		gConfig.saveFilter = false;
+		GaborService service( CreateHandler, gConfig.threads );
+		return service.Run( gConfig.servicePath );
+	}
+
+// filter the frames of a stream as they come, writing a binary record for each
+	if ( gConfig.streamPath[0] != '\0' )
+	{
+		gConfig.saveFilter = false;
+		return FilterStream();
+	}
+	cout << "# " << echo.str() << endl;
 
 // better to pass some file to process!
 	if ( arg >= argc )
@@ -169,231 +104,328 @@ loop:
 		Usage();
 		return 0;
 	}
-	
-	for( int i = arg; i < argc; i++ )
+
+// filter every file with every parameter set of a sweep
+	if ( gConfig.sweepFile[0] != '\0' ) return FilterSweep( argv + arg, argc - arg );
+
+// images filtered before with the same settings, by this process or another, come from the cache
+	if ( gConfig.cacheDir[0] != '\0' )
+	{
+		ostringstream	settings;
+		if ( ! gCache.Open( gConfig.cacheDir, gConfig.cacheMegabytes * 1048576LL ) ) return 0;
+		gConfig.Describe( settings );
+		gParams = HashString( settings.str().c_str() );
+	}
+
+	if ( gConfig.threads == 1 )
+	{
+	// filter and print the files one by one
+		GaborContext	context( gConfig );
+		PGMImage		image;
+		context.SetRegion( gRegion );
+		for( int i = arg; i < argc; i++ )
+		{
+			int		len = 0, numCells;
+			float*	response = FilterFile( &context, &image, argv[i], &len );
+			int**	cells = context.GetCells( &numCells );
+
+		// write the filter response to console
+			if ( len == 0 || gConfig.layout != kLayoutCombined ) cells = NULL;
+			PrintResponse( argv[i], response, len, cells, numCells );
+
+		// clean up
+			if ( response != NULL ) delete[] response;
+		}
+		if ( gConfig.verbosity && gCache.IsOpen() ) gCache.PrintStats( cerr );
+		return 0;
+	}
+
+// filter the files in parallel, each worker with its own context, then print them in order
+	Batch		batch;
+	int			numFiles = argc - arg;
+	pthread_t*	workers = new pthread_t[gConfig.threads];
+
+	batch.files = argv + arg;
+	batch.responses = new float*[numFiles];
+	batch.lengths = new int[numFiles];
+	batch.cells = new int**[numFiles];
+	batch.numCells = new int[numFiles];
+	batch.queue = new WorkQueue( numFiles );
+	for ( int i = 0; i < numFiles; i++ ) batch.queue->Push( i );
+	batch.queue->Close();
+
+	for ( int t = 0; t < gConfig.threads; t++ ) pthread_create( &workers[t], NULL, BatchWorker, &batch );
+	for ( int t = 0; t < gConfig.threads; t++ ) pthread_join( workers[t], NULL );
+
+	for ( int i = 0; i < numFiles; i++ )
 	{
-	// copy argument to filename
-		strcpy( file, argv[i] );
-		if ( kVerbosity ) cerr << "Processing file \"" << argv[i] << "\"..." << endl;
-
-	// load the image (only PGM and PPM are supported)
-		int		 imgHeight, imgWidth;
-		int***	 image = NULL;		// allocated and freed by PGMImage
-		PGMImage pgmImage( file );	
-		imgHeight = pgmImage.GetHeight();
-		imgWidth  = pgmImage.GetWidth();
-		image 	  = pgmImage.GetRGBPixels();
-
-	// filter this image (assumes image is in RGB color)
-		float *response = NULL;
-		int	  len = 0;
-		response = ProcessFile( file, image, imgHeight, imgWidth, response, &len );
-
-	// write the filter response to console	
-		cout << "# " << argv[i] << " " << len << endl;
-		for ( int j = 0; j < len; j++ ) cout << response[j] << " ";
-		cout << endl;
-
-	// clean up	
-		if ( response != NULL ) delete[] response;
+		PrintResponse( batch.files[i], batch.responses[i], batch.lengths[i], batch.cells[i], batch.numCells[i] );
+		if ( batch.responses[i] != NULL ) delete[] batch.responses[i];
+		if ( batch.cells[i] != NULL ) DisposeMatrix( batch.cells[i], batch.numCells[i] );
 	}
-		
+
+	delete batch.queue;
+	delete[] batch.lengths;
+	delete[] batch.cells;
+	delete[] batch.numCells;
+	delete[] batch.responses;
+	delete[] workers;
+	if ( gConfig.verbosity && gCache.IsOpen() ) gCache.PrintStats( cerr );
 	return 0;
 }
 
 
-/* 
-pass the rgb pixel data for filtering; the response is returned in the response vector. 
-This vector will be initialized by the Gabor API, but MUST disposed of it by the user.
-respLen is the address of an int holding the length of the response vector. 
-*/
-float* ProcessFile( char* file, int*** rgb, int h, int w, float* response, int* respLen )
+// load an image (only PGM and PPM are supported) into image, whose storage is reused
+// for images of the same size, and filter it with the given context
+float* FilterFile( GaborContext* context, PGMImage* image, char* name, int* len )
 {
-	char 	basename[256];
-	char	dirStr[256];
-	char*	fileStr;
-	int		i, j, len;
-
-// extract directory path from filename
-	strcpy( dirStr, file );
-	fileStr = strrchr( dirStr, '/' );
-	if ( fileStr != NULL )
+	char			file[256];
+	float*			response = NULL;
+	ResultCacheKey	key;
+
+// copy argument to filename
+	*len = 0;
+	if ( strlen( name ) >= sizeof(file) )
 	{
-		strcpy( basename, fileStr );				// save part after last slash
-		dirStr[fileStr-dirStr+1] = '\0';				// save directory string
-		strcat( dirStr, basename );
-		strcat( dirStr, "-globalGF" );
-		basename[strlen(basename)-4] = '\0';			// remove extension
-		for ( i = 0; i < strlen( basename ); i++ )		// remove intial slash
-			basename[i] = basename[i+1];
-		basename[i] = '\0';
+		cerr << "Error: file name longer than " << sizeof(file) - 1 << " characters: \"" << name << "\"" << endl;
+		return response;
 	}
-	else	// we are in working directory
+	strcpy( file, name );
+	if ( gConfig.verbosity ) cerr << "Processing file \"" << name << "\"..." << endl;
+
+	context->PrepareImage( image );
+	image->Read( file );
+	if ( !context->Accepts( image ) )
 	{
-		strcpy( basename, file );
-		basename[strlen(basename)-4] = '\0';			// remove extension
-		strcpy( dirStr, basename );
-		strcat( dirStr, "-globalGF" );
+		cerr << "Error: \"" << name << "\" is not a PGM or PPM image" << endl;
+		return response;
 	}
-	
-// create img directory in extracted path
-	if ( kSaveFilter == 1 )
+
+// its responses from the cache if it was filtered before
+	if ( gCache.IsOpen() )
 	{
-		mkdir( dirStr, S_IRWXU | S_IRWXG );
-		if ( kVerbosity ) cerr << "Created directory: \"" << dirStr << "\"" << endl;
-		strcat( dirStr, "/" );
+		ResultCache::MakeKey( image, gParams, &key );
+		response = gCache.Lookup( key, len );
+		if ( response != NULL ) return response;
 	}
 
-#if kUsingColor	// USING COLOR
+// filter this image, decoded to gray unless the pipeline keeps color
+	response = context->ProcessImage( file, image, response, len );
+	if ( gCache.IsOpen() ) gCache.Store( key, response, *len );
+	return response;
+}
+
+
+// write the response of a file to the console, followed by the lattice positions of 
+// its windows if only some of them were filtered
+void PrintResponse( char* file, float* response, int len, int** cells, int numCells )
+{
+	PROFILE_SCOPE( profile, kStageOutput );
+	PROFILE_COUNT( profile, len, 0 );
+	cout << "# " << file << " " << len << endl;
+	for ( int j = 0; j < len; j++ ) cout << response[j] << " ";
+	cout << endl;
+	if ( cells == NULL ) return;
+	cout << "# cells " << numCells << endl;
+	for ( int k = 0; k < numCells; k++ ) cout << cells[k][0] << " " << cells[k][1] << " ";
+	cout << endl;
+}
+
 
-// allocate pixels for rgb matrix
-	float*** pixels = new float**[3];
-	for ( int i = 0; i < 3; i++ ) pixels[i] = CreateMatrix( (float)255.0, h, w );
-	for ( i = 0; i < h; i++ )
+// Filter every file with every parameter set of the -W sweep, one after the other. Each 
+// set has a context of its own, whose filter bank is kept from file to file. A file is
+// decoded once for all of them, and its maps are made once for each pipeline among the
+// sets (MapCache). Every response is keyed by the file and the index of its set.
+int FilterSweep( char** files, int numFiles )
+{
+	GaborContext**	contexts;
+	GaborConfig		config;
+	MapCache		cache;
+	PGMImage		image;
+	Pipeline*		first;
+	Pipeline*		pipeline;
+	char**			sets;
+	char*			argv[64];
+	char			options[kMaxSweepLine];
+	char			file[256], key[300];
+	float*			response;
+	int**			cells;
+	int				numSets, argc, len, numCells, i, k;
+	bool			gray = true;
+
+	if ( ! ReadSweep( gConfig.sweepFile, &sets, &numSets ) ) return 1;
+	contexts = new GaborContext*[numSets];
+	for ( k = 0; k < numSets; k++ )
 	{
-		for ( j = 0; j < w; j++ )
+		config = gConfig;
+		strcpy( options, sets[k] );
+		argc = SplitOptions( options, argv, 64 );
+		if ( config.ParseOptions( argc, argv, 0, NULL, false ) != argc )
 		{
-			pixels[0][i][j] = (float)rgb[0][i][j];
-			pixels[1][i][j] = (float)rgb[1][i][j];
-			pixels[2][i][j] = (float)rgb[2][i][j];
+			cerr << "bad options in parameter set " << k << ": " << sets[k] << endl;
+			exit(1);
 		}
+		config.saveFilter = false;
+		contexts[k] = new GaborContext( config );
+		contexts[k]->SetRegion( gRegion );
+		contexts[k]->SetMapCache( &cache );
+		cout << "# set " << k << " " << sets[k] << endl;
 	}
 
-// save channels to file
-	if ( kSaveFilter == 1 )
-	{	
-		PGMImage channelImg;
-		strcpy( basename, dirStr );
-		strcat( basename, "red.ppm" );
-		channelImg.Write( basename, pixels[0], h, w, 0 );
-		strcpy( basename, dirStr );
-		strcat( basename, "green.ppm" );
-		channelImg.Write( basename, pixels[1], h, w, 1 );
-		strcpy( basename, dirStr );
-		strcat( basename, "blue.ppm" );
-		channelImg.Write( basename, pixels[2], h, w, 2 );
+// decode straight to gray only if every set filters the same gray
+	first = contexts[0]->GetPipeline();
+	for ( k = 0; k < numSets; k++ )
+	{
+		pipeline = contexts[k]->GetPipeline();
+		if ( pipeline->IsColor() || pipeline->GetGrayConversion() != first->GetGrayConversion() )
+			gray = false;
 	}
-	
-// process red channel and get gabor filter response length to determine
-// the full length of all responses and allocate the to be returned vector
-	len = 0;
-	strcpy( basename, dirStr );
-	strcat( basename, "red" );
-	response = ProcessChannel( pixels[0], h, w, response, &len, 0, basename );
-	*respLen = 3 * len;	
-// process green channel
-	strcpy( basename, dirStr );
-	strcat( basename, "green" );
-	ProcessChannel( pixels[1], h, w, response, &len, len, basename );
-// process blue channel
-	strcpy( basename, dirStr );
-	strcat( basename, "blue" );
-	ProcessChannel( pixels[2], h, w, response, &len, len+len, basename );
-
-// dispose of pixel storage	
-	for ( i = 0; i < 3; i++ )
-		DisposeMatrix( pixels[i], h );
-	delete[] pixels;
-
-#else	// USING GRAYSCALE
-
-// allocate pixels for rgb matrix
-	float** pixels = CreateMatrix( (float)255.0, h, w );
-
-//  convert rgb info to grayscale
-	for ( i = 0; i < h; i++ )
+	image.SetGrayDecode( gray, first->GetGrayConversion() );
+
+	for ( i = 0; i < numFiles; i++ )
 	{
-		for ( j = 0; j < w; j++ )
+		if ( strlen( files[i] ) >= sizeof(file) )
 		{
-			pixels[i][j] = sqrt( (float)( rgb[0][i][j]*rgb[0][i][j] +
-										  rgb[1][i][j]*rgb[1][i][j] + 
-										  rgb[2][i][j]*rgb[2][i][j] ) ) / sqrt( 3.0 );
+			cerr << "Error: file name longer than " << sizeof(file) - 1 << " characters: \"" << files[i] << "\"" << endl;
+			continue;
+		}
+		strcpy( file, files[i] );
+		if ( gConfig.verbosity ) cerr << "Processing file \"" << file << "\"..." << endl;
+		image.Read( file );
+		cache.Clear();
+		for ( k = 0; k < numSets; k++ )
+		{
+			response = contexts[k]->ProcessImage( file, &image, NULL, &len );
+			if ( len == 0 ) cerr << "Error: \"" << file << "\" is not a PGM or PPM image" << endl;
+			cells = contexts[k]->GetCells( &numCells );
+			if ( len == 0 || contexts[k]->GetConfig()->layout != kLayoutCombined ) cells = NULL;
+			sprintf( key, "%s %d", files[i], k );
+			PrintResponse( key, response, len, cells, numCells );
+			if ( response != NULL ) delete[] response;
 		}
 	}
+	if ( gConfig.verbosity )
+		cerr << cache.GetNumStored() << " maps made, " << cache.GetNumFound() << " reused" << endl;
 
-// process grayscale pixels, get gabor filter response length and allocate the return vector
-	len = 0;
-	strcpy( basename, dirStr );
-	strcat( basename, "gf" );
-	response = ProcessChannel( pixels, h, w, response, &len, 0, basename );
-	*respLen = len;
+	for ( k = 0; k < numSets; k++ ) delete contexts[k];
+	delete[] contexts;
+	DisposeSweep( sets, numSets );
+	return 0;
+}
 
-// dispose of pixel storage	
-	DisposeMatrix( pixels, h );
 
-#endif
-	
-	return response;
+// filter the frames of the -V stream in the order they were decoded, with one context and
+// one response vector for all of them, and write their records to stdout
+int FilterStream( void )
+{
+	GaborContext	context( gConfig );
+	FrameStream		stream( gConfig.streamQueue );
+	PGMImage*		image;
+	float*			response = NULL;
+	int				capacity = 0, len, need, slot;
+	char			file[256];
+
+	context.SetRegion( gRegion );
+	for ( int i = 0; i < stream.GetNumImages(); i++ ) context.PrepareImage( stream.GetImage( i ) );
+	if ( ! stream.Start( gConfig.streamPath ) ) return 1;
+
+	strcpy( file, "frame.ppm" );	// only used to name saved files, which are off here
+	while ( stream.Next( &slot ) )
+	{
+		image = stream.GetImage( slot );
+		need = context.Accepts( image ) ? context.GetResponseLength( image->GetHeight(), image->GetWidth() ) : 0;
+		if ( need > capacity )
+		{
+			delete[] response;
+			response = new float[need];
+			capacity = need;
+		}
+		context.ProcessImage( file, image, response, &len );
+		if ( ! WriteFrame( 1, stream.GetFrame( slot ), stream.GetTimestamp( slot ), response, len ) )
+		{
+			cerr << "cannot write the record of frame " << stream.GetFrame( slot ) << endl;
+			exit(1);
+		}
+		stream.Release( slot );
+	}
+
+	if ( gConfig.verbosity ) 
+		cerr << stream.GetNumFrames() << " frames, " << stream.GetNumDropped() << " dropped" << endl;
+	delete[] response;
+	return 0;
+}
+
+
+// filter the files of a batch until none are left, keeping a copy of the lattice 
+// positions of each
+void* BatchWorker( void* arg )
+{
+	Batch*			batch = (Batch*)arg;
+	GaborContext	context( gConfig );
+	PGMImage		image;
+	int**			cells;
+	int				i, k;
+
+	context.SetRegion( gRegion );
+	while ( batch->queue->Pop( &i ) )
+	{
+		batch->responses[i] = FilterFile( &context, &image, batch->files[i], &batch->lengths[i] );
+		cells = context.GetCells( &batch->numCells[i] );
+		batch->cells[i] = NULL;
+		if ( cells == NULL || batch->lengths[i] == 0 || gConfig.layout != kLayoutCombined ) continue;
+		batch->cells[i] = CreateMatrix( 0, batch->numCells[i], 2 );
+		for ( k = 0; k < batch->numCells[i]; k++ )
+		{
+			batch->cells[i][k][0] = cells[k][0];
+			batch->cells[i][k][1] = cells[k][1];
+		}
+	}
+	return NULL;
+}
+
+
+ServiceHandler* CreateHandler( void )
+{
+	return new RequestHandler;
 }
 
 
-// process a single color or grayscale channel
-float* ProcessChannel( float** image, int h, int w, float* response, int* len, int offset, char* file )
+// answer one service request: apply its options on top of the startup settings,
+// load the image and filter it
+float* RequestHandler::Serve( GaborRequest* request, int* len, int* status )
 {
-	LogPolar*		logPolar = NULL;
-	ContrastFilter*	contrastFilter = NULL;
-	int				height = h;
-	int				width = w;
-	float** 		pixels;
-	int				gflen;
-
-// copy pointer
-	pixels = image;
-
-#if kUseContrast
-// apply contrast filter to image
-	contrastFilter = new ContrastFilter( image, height, width );
-	if ( kSaveFilter == 1 )
+	GaborConfig	config = gConfig;
+	char*		argv[64];
+	char		file[256];
+	int			argc, need;
+
+	argc = SplitOptions( request->options, argv, 64 );
+	if ( config.ParseOptions( argc, argv, 0, NULL, false ) != argc )
 	{
-		contrastFilter->SetFileName( file );	
-		contrastFilter->Save();					// save contrast image
+		*status = kStatusBadOptions;
+		return NULL;
 	}
-	pixels = contrastFilter->GetContrast();		// get contrast map
-	width  = contrastFilter->GetWidth();		// obtain contrast dimensions
-	height = contrastFilter->GetHeight();
-#endif
-	
-#if kUseLogPolar
-// apply log-polar filter to image
-	int	minHW;
-	if ( height <= width )
-		minHW = height;
-	else
-		minHW = width;
-	logPolar = new LogPolar( pixels, height, width, minHW, height/2, width/3 );
-	if ( kSaveFilter == 1 )
+	config.saveFilter = false;
+	mContext.SetConfig( config );
+
+	mContext.PrepareImage( &mImage );
+	if ( !LoadRequestImage( request, &mImage ) || !mContext.Accepts( &mImage ) ||
+		 ( need = mContext.GetResponseLength( mImage.GetHeight(), mImage.GetWidth() ) ) == 0 )
 	{
-		logPolar->SetFileName( file );
-		logPolar->Save(kSaveFilter);				// save contrast image
+		*status = kStatusBadImage;
+		return NULL;
 	}
-	pixels = logPolar->GetPolars();		// get contrast map
-	width  = logPolar->GetWidth();		// obtain polar dimensions
-	height = logPolar->GetHeight();
-#endif
-
-// initialize gabor jet
-	GaborJet gaborJet;
-	if ( kSaveFilter == 1 ) gaborJet.SetFileName( file );
-	gaborJet.Initialize( height, width, gy, gx, sy, sx, s, f, u, l, a );
-	
-// filter image
-	// response vector is initialized here, but needs to be disposed by user
-	gaborJet.Filter( pixels, &gflen );
-	if ( *len == 0 ) 
+	if ( need > mCapacity )
 	{
-		*len = gflen;
-	#if kUsingColor	// USING COLOR
-		response = new float[(*len)*3]; // make room for R,G, and B channels
-	#else
-		response = new float[(*len)];
-	#endif
+		delete[] mResponse;
+		mResponse = new float[need];
+		mCapacity = need;
 	}
-	for ( int i = 0; i < *len; i++ ) response[i+offset] = gaborJet.GetResponse(i);
 
-	delete logPolar;
-	delete contrastFilter;
-
-	return response;
+	strcpy( file, "request.ppm" );	// only used to name saved files, which are off here
+	mContext.ProcessImage( file, &mImage, mResponse, len );
+	*status = kStatusOK;
+	return mResponse;
 }
 
 
@@ -412,7 +444,45 @@ void Usage( void )
     cerr << "    -l = minimum frequency value" << endl;
     cerr << "    -u = maximum frequency value" << endl;
     cerr << "    -v = turn on/off verbosity" << endl;
-    cerr << "    -S = save intermediate files" << endl;    
+    cerr << "    -S = save intermediate files" << endl;
+    cerr << "    -t = number of worker threads" << endl;
+    cerr << "    -E = convolution engine: auto (specialized kernels where they fit), generic" << endl;
+    cerr << "         or int16 (16 bit fixed point, faster but less precise)" << endl;
+    cerr << "    -L = response layout: combined (one map for all filters), angle (a map per" << endl;
+    cerr << "         filter) or jet (the filters of a window together); the last two output" << endl;
+    cerr << "         a response per filter" << endl;
+    cerr << "    -B = pixels outside the image: skip, zero, clamp or reflect (default skip)" << endl;
+    cerr << "    -R = filter only the windows overlapping a PGM mask (scaled to the image) or the" << endl;
+    cerr << "         rectangles of a text file: their number, then x y width height of each;" << endl;
+    cerr << "         the output lists the row and column of each window after its responses" << endl;
+    cerr << "    -T = keep the filter taps holding this fraction of the energy, e.g. 0.999" << endl;
+    cerr << "         (default 0: all taps); -v 1 reports the savings and errors per filter" << endl;
+    cerr << "    -k = use only these filters, as angle/frequency index pairs, e.g. 0/0,3/1; the" << endl;
+    cerr << "         combined map sums over them only, the other layouts output their responses" << endl;
+    cerr << "    -K = coarse to fine: the lowest frequency on every other window first, then all" << endl;
+    cerr << "         filters only near those with at least this fraction of the largest energy;" << endl;
+    cerr << "         the other windows output -1 (default 0: off); -v 1 reports the work skipped" << endl;
+    cerr << "         and the recall against the full lattice" << endl;
+    cerr << "    -I = filter consecutive images incrementally: only where tiles of this many pixels" << endl;
+    cerr << "         changed since the previous image (default 0: off); -v 1 reports the windows" << endl;
+    cerr << "         filtered per image" << endl;
+    cerr << "    -c = stages to run, from decode,gray|luma|rgb|opponent,contrast,logpolar,gabor" << endl;
+    cerr << "         (default decode,gray,contrast,gabor)" << endl;
+    cerr << "    -C = read options from a file, # starts a comment line" << endl;
+    cerr << "    -D = serve requests on a unix socket, or on stdin/stdout if \"-\"" << endl;
+    cerr << "    -V = filter back-to-back PGM/PPM frames from a FIFO, or from stdin if \"-\", as they" << endl;
+    cerr << "         come; a binary record per frame goes to stdout" << endl;
+    cerr << "    -Q = frames waiting to be filtered with -V before the oldest is dropped (default 2)" << endl;
+    cerr << "    -W = filter every image with each parameter set of a file: a line of options per" << endl;
+    cerr << "         set, e.g. -s 2 -l 0.5, where a value may list alternatives as 2|3|4; every" << endl;
+    cerr << "         image is decoded and preprocessed once for all sets" << endl;
+    cerr << "    -H = keep the responses in a directory, shared with other processes, and take" << endl;
+    cerr << "         those of images filtered before with the same settings from it; not with -R" << endl;
+    cerr << "    -N = megabytes the -H directory may hold before the least used are removed" << endl;
+    cerr << "         (default 256)" << endl;
+    cerr << "    -p = print time and counters per stage on exit" << endl;
+    cerr << "    -P = write a Chrome trace of the stages to a file on exit" << endl;
+    cerr << "    --perf-counters = also sample hardware counters (Linux) around decode, contrast and jet" << endl;
 	exit(0);
 }
 
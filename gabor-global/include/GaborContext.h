@@ -0,0 +1,139 @@
+/*
+	Description:	Reentrant processing context. A context owns its settings, filter bank
+					and scratch buffers, so separate contexts can filter images in parallel.
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#ifndef __GABORCONTEXT__
+#define __GABORCONTEXT__
+
+#include "GaborGlobal.h"
+#include "GaborConfig.h"
+#include "GaborJet.h"
+#include "Arena.h"
+#include "Pipeline.h"
+#include "PGMImage.h"
+
+// the windows to filter: rectangles of the map, or a mask scaled to the map
+struct GaborRegion
+{
+	int**	rects;		// x, y, width and height of each rectangle; NULL for a mask
+	int		numRects;
+	int**	mask;		// nonzero for the pixels inside; NULL for rectangles
+	int		height;		// size of the mask
+	int		width;
+};
+
+// read a region from a PGM or PPM mask, whose pixels that are not black are inside, or
+// from a text file with the number of rectangles and then x, y, width and height of each
+bool	ReadRegion( char* file, GaborRegion* region );
+void	DisposeRegion( GaborRegion* region );
+
+class GaborContext
+{
+public:
+
+	GaborContext( GaborConfig& config );
+	~GaborContext();
+
+	// change settings; the filter bank is rebuilt only if it no longer fits
+	void				SetConfig( GaborConfig& config );
+	inline GaborConfig*	GetConfig( void ) { return &mConfig; }
+
+	// length of the response vector for an image of h x w pixels, 0 if the image is too small
+	// or no window overlaps the region
+	int		GetResponseLength( int h, int w );
+
+	// filter only the windows that overlap region, which is shared and must stay valid;
+	// NULL filters them all. With the combined layout each channel then has a response
+	// per window, in the order of GetCells().
+	void	SetRegion( GaborRegion* region );
+	// the (ry, rx) lattice positions of the windows of the last image, numCells rows;
+	// NULL if all of them were filtered
+	inline int**	GetCells( int* numCells ) { *numCells = mNumCells; return mCells; }
+
+	// Filter an image given as interleaved RGB values. If response is NULL, it is allocated 
+	// here and MUST be disposed of by the caller. Otherwise it must hold at least 
+	// GetResponseLength( h, w ) floats and no allocation takes place for it.
+	float*	ProcessImageData( int* rgb, int h, int w, float* response, int* len );
+
+	// as above for rgb planes as read by PGMImage; saves intermediate files next to file
+	float*	ProcessFile( char* file, int*** rgb, int h, int w, float* response, int* len );
+
+	// as above for an image that PGMImage decoded straight to grayscale; gray is filtered
+	// in place and must stay valid until the call returns
+	float*	ProcessGray( char* file, float** gray, int h, int w, float* response, int* len );
+
+	// set image up to decode the next files the way the pipeline needs them: straight to
+	// grayscale unless the pipeline keeps color
+	void	PrepareImage( PGMImage* image );
+	// whether image, as read, has the pixels the pipeline needs
+	bool	Accepts( PGMImage* image );
+	// filter an image read by PGMImage with either of the calls above; len is 0 if the 
+	// image is not accepted
+	float*	ProcessImage( char* file, PGMImage* image, float* response, int* len );
+
+	// filter a single color or grayscale channel into response; returns its length
+	int		ProcessChannel( float** image, int h, int w, float* response, char* file );
+
+	// fraction of the windows filtered for the last image, below 1 if -I filtered only 
+	// those over the tiles that changed since the image before
+	inline float		GetRecomputed( void ) { return mRecomputed; }
+
+	// the jet of the last image, whose response maps can be read in place until the next
+	// image; NULL if it saved its output
+	inline GaborJet*	GetJet( void ) { return mJet; }
+
+	// scratch memory in use, for reporting
+	inline Arena*	GetImageArena( void ) { return &mImageArena; }
+	inline Arena*	GetChannelArena( void ) { return &mChannelArena; }
+
+	// the stages in use; with a cache, the maps they make of an image are shared with
+	// the other contexts that use it (see MapCache)
+	inline Pipeline*	GetPipeline( void ) { return &mPipeline; }
+	inline void			SetMapCache( MapCache* cache ) { mPipeline.SetCache( cache ); }
+
+protected:
+
+	float*	ProcessChannels( float* response, int* len, char* dir );
+	int		ProcessColor( float* response );
+	bool	PrepareJet( int height, int width, bool save, char* file );
+	bool	CanRefilter( bool save );
+	int		ProcessIncremental( float** image, int h, int w, float* response );
+	void	FindChanges( float** image, int h, int w );
+	void	AllocatePrevious( int h, int w );
+	void	AllocateChannels( int h, int w );
+	void	MakeOutputDir( char* file, char* dirStr );
+	void	UpdateCells( int h, int w );
+
+	GaborConfig		mConfig;		// settings in use
+	Pipeline		mPipeline;		// stages of mConfig.pipeline
+	GaborJet*		mJet;			// filter bank kept warm between images
+	Arena			mImageArena;	// per-image buffers, reset for each image
+	Arena			mChannelArena;	// per-channel buffers, reset for each channel
+	float**			mChannels[3];	// pixel matrices in mImageArena
+	int				mNumChannels;	// 3 when the pipeline keeps color, 1 for grayscale
+	int				mHeight;		// height of the channel matrices
+	int				mWidth;			// width of the channel matrices
+	GaborRegion*	mRegion;		// windows to filter, NULL for all
+	int**			mCells;			// windows of the region on the last map, NULL without one
+	int				mNumCells;
+	int				mCellsHeight;	// size of that map
+	int				mCellsWidth;
+	GaborConfig		mCellsConfig;	// jet geometry the cells were found for
+	bool			mCellsChanged;	// the jet does not have the cells yet
+	int*			mSubset;		// filters of mConfig.subset, NULL for all
+	int				mNumSubset;		// filters in use
+	float**			mPrevious;		// the last image filtered incrementally, NULL before one
+	float**			mMap;			// its contrast map, if the pipeline has one
+	int				mPrevHeight;	// size of mPrevious
+	int				mPrevWidth;
+	int				mPrevTile;		// tile size mChanged and mDirty were made for
+	bool*			mChanged;		// tiles of the image that differ from mPrevious
+	bool*			mDirty;			// blocks of the map that read a changed tile
+	bool			mHavePrevious;	// the jet holds the responses of mPrevious
+	float			mRecomputed;	// fraction of the windows filtered for the last image
+};
+
+#endif
@@ -7,10 +7,43 @@
 #ifndef __GABORJET__
 #define __GABORJET__
 
-#define kAngleSeparation 0
-
 #include "GaborGlobal.h"
 #include "GaborFilter.h"
+#include "GaborKernels.h"
+#include "Arena.h"
+
+// layouts of the responses, selected with -L
+enum
+{
+	kLayoutCombined = 0,	// one map of the responses summed over all filters
+	kLayoutAngleMajor,		// a map per filter, [angle][freq][ry][rx]
+	kLayoutJetMajor,		// a jet per window, [ry][rx][angle*freq]
+	kNumLayouts
+};
+
+// channels of a color image, filtered together by FilterChannels()
+#define kColorChannels	3
+
+// pixels under a tile of neighbouring windows, copied together so that they stay in 
+// cache while every filter runs over them
+#define kTileBytes		( 32 * 1024 )
+
+// coarse-to-fine filtering: the coarse lattice is every kCoarseStep-th window each way,
+// and the windows left out are marked with kPrunedResponse
+#define kCoarseStep			2
+#define kPrunedResponse		-1.0
+
+// -L names, indexed by layout
+extern const char*	gLayoutNames[kNumLayouts];
+
+// layout of the given name, or -1
+int		FindLayout( const char* name );
+
+// The windows of a jet with the given geometry, over an h x w map, that overlap the
+// nonzero pixels of mask. Their (ry, rx) lattice positions are written to the rows of
+// cells in raster order, unless it is NULL; returns how many there are.
+int		FindMaskCells( int** mask, int h, int w, int sizeY, int sizeX, int spacingY, int spacingX,
+					   int border, int** cells );
 
 
 class GaborJet
@@ -22,15 +55,101 @@ public:
 	
 	void	Initialize( int y, int x, int ys, int xs, int ysp, int xsp, 
 						float s = 2.0, int f = 2, float maxF = 2, float minF = 1, int a = 8 );
+	bool	Matches( int y, int x, int ys, int xs, int ysp, int xsp, 
+					 float s, int f, float maxF, float minF, int a );
 	void	Filter( float** image, int* len );
+	// Filter the kColorChannels images in one pass that shares each filter tap between
+	// them. The normalized responses of each channel follow those of the previous one.
+	// GetMap() and Save() still refer to the last call of Filter().
+	void	FilterChannels( float** images[], float* response, int* len );
 	float	GetResponse( int idx ) { return mNormals[idx]; }
 
 	void	Save( void );
 
 	inline void		SetFileName( char* file ) { strcpy( mFile, file ); saveFilter = true; }
+	inline void		SetEngine( int engine ) { mEngine = engine; }
+	// the layout takes effect with the next Initialize()
+	inline void		SetLayout( int layout ) { mLayout = layout; }
+	inline int		GetLayout( void ) { return mLayout; }
+	// the border policy takes effect with the next Initialize(). With kBorderSkip the
+	// windows lie inside the image; otherwise they are centred on every spacing-th pixel,
+	// over a copy of the image padded by the policy.
+	inline void		SetBorder( int border ) { mBorder = border; }
+	inline int		GetBorder( void ) { return mBorder; }
+	// filter the windows of the combined map a tile at a time (the default), or one 
+	// window at a time over the whole image; both give the same responses
+	inline void		SetTiling( bool tiling ) { mTiling = tiling; }
+	// filter only the numCells windows at the (ry, rx) rows of cells, e.g. from 
+	// FindMaskCells(), or all of them if cells is NULL; call after Initialize(). With
+	// kLayoutCombined the responses are then those of these windows in this order, the 
+	// other layouts sum over them only. The maps hold 0 for the others.
+	void			SetCells( int** cells, int numCells );
+	inline int		GetNumCells( void ) { return mNumCells; }
+	// Coarse-to-fine filtering of the combined map, off if threshold is 0. The lowest 
+	// frequency filters first run over the coarse lattice. All filters then run only 
+	// over the windows next to a coarse window whose energy is at least threshold times
+	// the largest; the others are pruned. Not with SetCells().
+	inline void		SetPruning( float threshold ) { mPruning = threshold; }
+	inline int		GetNumPruned( void ) { return mNumPruned; }
+	// Incremental filtering of the combined map: filter image again only at the windows 
+	// that read a pixel of one of the tile x tile blocks of the map marked in dirty, in 
+	// raster order with ( width + tile - 1 ) / tile blocks a row, and keep the responses
+	// of the others from the last Filter() or Refilter(), which must have run over the 
+	// whole map. Not with SetCells(), pruning or the int16 engine, whose sums differ.
+	// Returns how many windows were filtered.
+	int				Refilter( float** image, bool* dirty, int tile, int* len );
+	// print the work the last Filter() skipped on image, and how many of the windows with
+	// a full response of at least the threshold times the largest it kept; this filters
+	// image again over the whole lattice
+	void			ReportPruning( float** image, ostream& out );
+	// keep only the taps of each filter that hold fraction of its energy, or all of them
+	// if 0; takes effect with the next Initialize(). The int16 engine uses all taps.
+	inline void		SetTrim( float fraction ) { mTrim = fraction; }
+	inline float	GetTrim( void ) { return mTrim; }
+	// print the taps each trimmed filter keeps, and how far its responses over image are 
+	// from those of the whole filter
+	void			ReportTrim( float** image, ostream& out );
+	// build and run only the numFilters filters of the bank at the indices a * freqs + f
+	// of filters, in increasing order as given by ParseSubset(), or all of them if filters
+	// is NULL; takes effect with the next Initialize(). The combined map sums over these
+	// filters only, and the other layouts hold a map or response per filter in this order.
+	void			SetSubset( int* filters, int numFilters );
+	// whether the filters in use are those SetSubset() would give
+	bool			MatchesSubset( int* filters, int numFilters );
+	inline int		GetNumFilters( void ) { return mNumFilters; }
+
+	// The responses of filter (a, f), or of the whole bank with kLayoutCombined, in place:
+	// window (ry, rx) is at map[ry * rowStride + rx * colStride]. NULL if the filter is not
+	// in use. Valid until the next Initialize(), and overwritten by the next Filter().
+	float*			GetMap( int a, int f, int* rowStride, int* colStride );
+	// the responses of the filters in use at window (ry, rx) in a row; kLayoutJetMajor only
+	inline float*	GetJet( int ry, int rx ) 
+		{ return ( mLayout == kLayoutJetMajor ) ? mTensor + ( ry * mRespX + rx ) * mNumFilters : NULL; }
+	inline float*	GetTensor( void ) { return mTensor; }
+	inline int		GetResponseHeight( void ) { return mRespY; }
+	inline int		GetResponseWidth( void ) { return mRespX; }
 	
 protected:
 
+	void	Dispose( void );
+	float*	GetFilterMap( int k, int* rowStride, int* colStride );
+	template <int S>
+	void	FilterFixed( void );
+	template <int S>
+	void	FilterTiled( void );
+	template <int S>
+	void	FilterCells( int* cells, int numCells );
+	void	FilterCoarse( void );
+	float**	LoadTile( int ry, int rx, int ny, int nx );
+	void	QuantizeFilters( int bits );
+	void	FilterInt16( void );
+	void	FilterSeparate( void );
+	void	FilterTrimmed( void );
+	void	FilterPacked( float** images[] );
+	void	NormalizeMap( float* map, float* normals );
+	void	NormalizeCells( int* cells, int numCells, bool sparse );
+	float**	PadImage( float** image, int c );
+
 	int				mHeight;	// vertical size of image
 	int				mWidth;		// horizontal size of image
 	int				mSpacingY;	// vertical amount of pixels between subsequent GFs
@@ -44,16 +163,50 @@ protected:
 	int				mRespX;		// width of response matrix
 	float			mMinFreq;	// minimum frequency
 	float			mMaxFreq;	// maximum frequency
-	GaborFilter**	mFilters;	// set of filters in use
-	float**			mPixels;	// the pixel matrix to filter
-#if kAngleSeparation
-	float****		mResponses;	// the gabor filtered image
-#else
-	float**			mResponses;	// the gabor filtered image
-#endif
+	GaborFilter**	mFilters;	// the bank, [angle][freq]; only the filters in use are built
+	int*			mSubset;	// indices of the filters to build, NULL for all of them
+	int				mNumSubset;
+	GaborFilter**	mBank;		// the filters in use, in the order of their responses
+	int*			mBankIndex;	// index a * freqs + f of each filter in use
+	int				mNumFilters;	// filters in use
+	float**			mPixels;	// the pixel matrix to filter, padded if the border policy asks for it
+	int				mBorder;	// border policy
+	float			mTrim;		// energy fraction of the trimmed filters, 0 if they are whole
+	int				mTaps;		// taps of all filters, as trimmed
+	int				mPadY;		// rows and columns of padding before the image
+	int				mPadX;
+	int				mPaddedY;	// size of the padded matrix, that of the image if there is none
+	int				mPaddedX;
+	float**			mPadded[kColorChannels];	// padded copies of the channels, NULL until needed
+	bool			mTiling;	// whether the combined map is filtered a tile at a time
+	int				mTileY;		// windows per tile, vertically and horizontally
+	int				mTileX;
+	Arena			mTileArena;	// the tile and its sums, set up by Initialize()
+	float**			mTile;		// pixels under the windows of a tile, rows aligned to cache lines
+	float*			mTileSums;	// real and imaginary sums of the windows of a tile
+	int*			mCells;		// indices in the map of the windows to filter, NULL for all
+	int				mNumCells;	// windows to filter
+	float			mPruning;	// energy threshold of coarse-to-fine filtering, 0 if off
+	float*			mCoarse;	// energy of the coarse windows, NULL until needed
+	int*			mRefined;	// indices in the map of the windows not pruned
+	int				mNumRefined;
+	int				mNumPruned;
+	int*			mDirtyCells;	// indices in the map of the windows Refilter() runs, NULL until needed
+	int				mCoarseFilters;	// filters the coarse pass runs
+	int				mLayout;	// layout of the responses
+	float*			mTensor;	// the gabor filtered image, all maps in one block
+	float**			mResponses;	// rows of mTensor: one map, a map per filter, or rows of jets
 	float*			mNormals;	// normalized responses (for NN)
+	float*			mChannelMaps;	// combined responses of each channel, for FilterChannels()
+	float**			mPacked;	// rows of the color channels interleaved, four floats a pixel
 	char			mFile[256];	// filename
 	bool			saveFilter;
+	int				mEngine;	// convolution engine
+	FixedMatrix		mFixedImage;	// quantized pixels, for the int16 engine
+	FixedMatrix*	mFixedReal;	// quantized filters, NULL until the int16 engine runs
+	FixedMatrix*	mFixedImag;
+	float*			mFixedScale;	// per filter, fixed = float * scale
+	int				mFixedLen;	// padded row length of the quantized filters
 };
 
 #endif
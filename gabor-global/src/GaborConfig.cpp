@@ -0,0 +1,340 @@
+/*
+	Description:	Settings for the Gabor filter jet and the processing around it
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include <stdlib.h>
+#include <sstream>
+#include "GaborConfig.h"
+#include "GaborKernels.h"
+#include "FrameStream.h"
+#include "Pipeline.h"
+#include "ResultCache.h"
+#include "Utilities.h"
+#include "GaborJet.h"
+
+// default settings for the Gabor filter jet. These are of course modifiable.
+GaborConfig::GaborConfig()
+{
+	sizeX		= 32;
+	sizeY		= 32;
+	spacingX	= 28;
+	spacingY	= 28;
+	sigma		= 2.0;
+	angles		= 8;
+	freqs		= 1;
+	minFreq		= 1;
+	maxFreq		= 2;
+	verbosity	= true;
+	saveFilter	= true;
+	threads		= 1;
+	engine		= kEngineAuto;
+	border		= kBorderSkip;
+	trim		= 0.0;
+	subset[0]	= '\0';
+	prune		= 0.0;
+	incremental	= 0;
+	strcpy( pipeline, "decode,gray,contrast,gabor" );
+	layout		= kLayoutCombined;
+	regionFile[0] = '\0';
+	servicePath[0] = '\0';
+	streamPath[0] = '\0';
+	streamQueue	= kStreamQueue;
+	sweepFile[0] = '\0';
+	cacheDir[0] = '\0';
+	cacheMegabytes = kCacheMegabytes;
+	profile		= false;
+	traceFile[0] = '\0';
+	perfCounters = false;
+}
+
+
+// process command line arguments
+int GaborConfig::ParseOptions( int argc, char *argv[], int arg, ostream* echo, bool files )
+{
+	ostringstream	ignore;
+	ostream&		out = ( echo != NULL ) ? *echo : ignore;
+
+// run down each argument
+	while( arg < argc )
+	{
+	// check if -h is called
+		if( strcmp( argv[arg], "-h") == 0 ) return -1;
+		if( strcmp( argv[arg], "-X") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			out << argv[arg] << " ";
+			sizeX = atoi( argv[arg] );
+			if ( sizeX < 1 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-Y") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			out << argv[arg] << " ";
+			sizeY = atoi( argv[arg] );
+			if ( sizeY < 1 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-x") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			out << argv[arg] << " ";
+			spacingX = atoi( argv[arg] );
+			if ( spacingX < 1 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-y") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			out << argv[arg] << " ";
+			spacingY = atoi( argv[arg] );
+			if ( spacingY < 1 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-s") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			out << argv[arg] << " ";
+			sigma = atof( argv[arg] );
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-a") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			out << argv[arg] << " ";
+			angles = atoi( argv[arg] );
+			if ( angles < 1 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-f") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			freqs = atoi( argv[arg] );
+			if ( freqs < 1 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-l") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			out << argv[arg] << " ";
+			minFreq = atof( argv[arg] );
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-u") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			out << argv[arg] << " ";
+			maxFreq = atof( argv[arg] );
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-v") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			verbosity = (bool)atoi( argv[arg] );
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-S") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			saveFilter = (bool)atoi( argv[arg] );
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-t") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			threads = Max( atoi( argv[arg] ), 1 );
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-E") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			engine = FindEngine( argv[arg] );
+			if ( engine < 0 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-B") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			border = FindBorder( argv[arg] );
+			if ( border < 0 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-T") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			trim = atof( argv[arg] );
+			if ( trim < 0.0 || trim > 1.0 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-k") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			if ( !CopyOption( subset, sizeof(subset), argv[arg-1], argv[arg] ) ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-K") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			prune = atof( argv[arg] );
+			if ( prune < 0.0 || prune > 1.0 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-I") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			incremental = atoi( argv[arg] );
+			if ( incremental < 0 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-L") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			layout = FindLayout( argv[arg] );
+			if ( layout < 0 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-R") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			if ( !CopyOption( regionFile, sizeof(regionFile), argv[arg-1], argv[arg] ) ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-c") == 0 )
+		{
+			Pipeline	test;
+			arg++;
+			if ( argv[arg] == NULL || !test.Parse( argv[arg] ) ) return -1;
+			if ( !CopyOption( pipeline, sizeof(pipeline), argv[arg-1], argv[arg] ) ) return -1;
+			out << argv[arg-1] << " " << argv[arg] << " ";
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-C") == 0 )
+		{
+			char	text[4096];
+			char*	options[256];
+			int		num;
+			arg++;
+			if ( argv[arg] == NULL || !files ) return -1;
+		// the options of the file, which may not name files themselves
+			num = ReadOptionFile( argv[arg], text, sizeof(text), options, 256 );
+			if ( num < 0 || ParseOptions( num, options, 0, echo, false ) != num ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-D") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			if ( !CopyOption( servicePath, sizeof(servicePath), argv[arg-1], argv[arg] ) ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-V") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			if ( !CopyOption( streamPath, sizeof(streamPath), argv[arg-1], argv[arg] ) ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-Q") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			streamQueue = atoi( argv[arg] );
+			if ( streamQueue < 1 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-W") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			if ( !CopyOption( sweepFile, sizeof(sweepFile), argv[arg-1], argv[arg] ) ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-H") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			if ( !CopyOption( cacheDir, sizeof(cacheDir), argv[arg-1], argv[arg] ) ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-N") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			cacheMegabytes = atoi( argv[arg] );
+			if ( cacheMegabytes < 1 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-p") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			profile = (bool)atoi( argv[arg] );
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-P") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			if ( !CopyOption( traceFile, sizeof(traceFile), argv[arg-1], argv[arg] ) ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "--perf-counters") == 0 )
+		{
+			perfCounters = true;
+			goto loop;
+		}
+		if( argv[arg][0] != '-' ) break;
+loop:
+		arg++;
+	}
+// the filters of -k must be in the bank of -a and -f
+	if ( ParseSubset( subset, angles, freqs, NULL ) < 0 ) return -1;
+// the result cache keeps the responses only, not the windows of -R
+	if ( cacheDir[0] != '\0' && regionFile[0] != '\0' ) return -1;
+	return arg;
+}
+
+
+// the settings as text, with enough digits that different values never read the same;
+// verbosity, threads, incremental filtering and the like leave the responses as they are
+void GaborConfig::Describe( ostream& out )
+{
+	streamsize	precision = out.precision( 9 );
+
+	out << "global " << sizeX << " " << sizeY << " " << spacingX << " " << spacingY << " "
+		<< sigma << " " << angles << " " << freqs << " " << minFreq << " " << maxFreq << " "
+		<< pipeline << " " << engine << " " << border << " " << trim << " " << subset << " "
+		<< prune << " " << layout;
+	out.precision( precision );
+}
@@ -0,0 +1,726 @@
+/*
+	Description:	Reentrant processing context
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "GaborContext.h"
+#include "ContrastFilter.h"
+#include "PGMImage.h"
+#include "Profiler.h"
+#include "Utilities.h"
+
+GaborContext::GaborContext( GaborConfig& config )
+{
+	mJet = NULL;
+	mRegion = NULL;
+	mCells = NULL;
+	mNumCells = 0;
+	mCellsHeight = mCellsWidth = 0;
+	mCellsChanged = false;
+	mSubset = NULL;
+	mPrevious = NULL;
+	mMap = NULL;
+	mPrevHeight = mPrevWidth = mPrevTile = 0;
+	mChanged = NULL;
+	mDirty = NULL;
+	mHavePrevious = false;
+	mRecomputed = 1.0;
+	SetConfig( config );
+	mHeight = 0;
+	mWidth = 0;
+	for ( int c = 0; c < 3; c++ ) mChannels[c] = NULL;
+}
+
+
+GaborContext::~GaborContext()
+{
+	delete mJet;
+	if ( mCells != NULL ) DisposeMatrix( mCells, Max( mNumCells, 1 ) );
+	if ( mSubset != NULL ) delete[] mSubset;
+	AllocatePrevious( 0, 0 );
+}
+
+
+// take new settings, setting up the pipeline stages if they changed
+void GaborContext::SetConfig( GaborConfig& config )
+{
+	mConfig = config;
+	mPipeline.Parse( mConfig.pipeline );
+	mNumChannels = mPipeline.GetNumChannels();
+
+// the filters of -k, or all of them if it names none of the bank
+	if ( mSubset != NULL ) delete[] mSubset;
+	mSubset = NULL;
+	mNumSubset = mConfig.angles * mConfig.freqs;
+	if ( mConfig.subset[0] != '\0' && mNumSubset > 0 )
+	{
+		mSubset = new int[mNumSubset];
+		mNumSubset = ParseSubset( mConfig.subset, mConfig.angles, mConfig.freqs, mSubset );
+		if ( mNumSubset < 0 )
+		{
+			delete[] mSubset;
+			mSubset = NULL;
+			mNumSubset = mConfig.angles * mConfig.freqs;
+		}
+	}
+}
+
+
+// take the channel matrices for an image of h x w pixels from the image arena. 
+// Everything the previous image used is released, so after the first image of a 
+// given size no memory is allocated.
+void GaborContext::AllocateChannels( int h, int w )
+{
+	mImageArena.Reset();
+	mHeight = h;
+	mWidth = w;
+	for ( int c = 0; c < mNumChannels; c++ ) mChannels[c] = mImageArena.NewMatrix( h, w );
+}
+
+
+// take a region to filter, the cells of the previous one no longer hold
+void GaborContext::SetRegion( GaborRegion* region )
+{
+	mRegion = region;
+	if ( mCells != NULL ) DisposeMatrix( mCells, Max( mNumCells, 1 ) );
+	mCells = NULL;
+	mNumCells = 0;
+	mCellsChanged = true;
+}
+
+
+// find the windows of an h x w map that overlap the region, unless they are known
+// for this map and jet geometry
+void GaborContext::UpdateCells( int h, int w )
+{
+	int**	mask;
+	int		i, j, k, y0, y1, x0, x1;
+
+	if ( mRegion == NULL ) return;
+	if ( mCells != NULL && mCellsHeight == h && mCellsWidth == w && 
+		 mCellsConfig.sizeY == mConfig.sizeY && mCellsConfig.sizeX == mConfig.sizeX &&
+		 mCellsConfig.spacingY == mConfig.spacingY && mCellsConfig.spacingX == mConfig.spacingX &&
+		 mCellsConfig.border == mConfig.border ) return;
+
+// the region over the map: the nearest pixel of the mask, or the rectangles clipped to it
+	mask = CreateMatrix( 0, h, w );
+	if ( mRegion->mask != NULL )
+	{
+		for ( i = 0; i < h; i++ )
+			for ( j = 0; j < w; j++ )
+				mask[i][j] = mRegion->mask[i * mRegion->height / h][j * mRegion->width / w];
+	}
+	else
+	{
+		for ( k = 0; k < mRegion->numRects; k++ )
+		{
+			x0 = Max( mRegion->rects[k][0], 0 );
+			y0 = Max( mRegion->rects[k][1], 0 );
+			x1 = Min( mRegion->rects[k][0] + mRegion->rects[k][2], w );
+			y1 = Min( mRegion->rects[k][1] + mRegion->rects[k][3], h );
+			for ( i = y0; i < y1; i++ )
+				for ( j = x0; j < x1; j++ ) mask[i][j] = 1;
+		}
+	}
+
+	if ( mCells != NULL ) DisposeMatrix( mCells, Max( mNumCells, 1 ) );
+	mNumCells = FindMaskCells( mask, h, w, mConfig.sizeY, mConfig.sizeX, mConfig.spacingY, 
+							   mConfig.spacingX, mConfig.border, NULL );
+	mCells = CreateMatrix( 0, Max( mNumCells, 1 ), 2 );
+	FindMaskCells( mask, h, w, mConfig.sizeY, mConfig.sizeX, mConfig.spacingY, mConfig.spacingX, 
+				   mConfig.border, mCells );
+	DisposeMatrix( mask, h );
+
+	mCellsHeight = h;
+	mCellsWidth = w;
+	mCellsConfig = mConfig;
+	mCellsChanged = true;
+}
+
+
+// follow the image dimensions through the processing steps
+int GaborContext::GetResponseLength( int h, int w )
+{
+	int	len;
+
+	mPipeline.GetOutputSize( &h, &w );
+	if ( h <= 0 || w <= 0 ) return 0;
+	if ( mConfig.border == kBorderSkip && ( h < mConfig.sizeY || w < mConfig.sizeX ) ) return 0;
+
+	if ( mConfig.layout != kLayoutCombined )
+		len = mNumSubset;
+	else if ( mRegion != NULL )
+	{
+		UpdateCells( h, w );
+		len = mNumCells;
+	}
+	else if ( mConfig.border == kBorderSkip )
+		len = ( ( h - mConfig.sizeY ) / mConfig.spacingY + 1 ) * 
+			  ( ( w - mConfig.sizeX ) / mConfig.spacingX + 1 );
+	else
+		len = ( ( h - 1 ) / mConfig.spacingY + 1 ) * ( ( w - 1 ) / mConfig.spacingX + 1 );
+
+	return len * mNumChannels;
+}
+
+
+// filter interleaved rgb values, as e.g. piped from a camera capture
+float* GaborContext::ProcessImageData( int* rgb, int h, int w, float* response, int* len )
+{
+	AllocateChannels( h, w );
+	if ( mPipeline.GetColorSpace() == kPipeColor )
+	{
+		int	i, j, k = 0;
+		for ( i = 0; i < h; i++ )
+		{
+			for ( j = 0; j < w; j++ )
+			{
+				mChannels[0][i][j] = (float)rgb[k];
+				mChannels[1][i][j] = (float)rgb[k+1];
+				mChannels[2][i][j] = (float)rgb[k+2];
+				k = k + 3;
+			}
+		}
+	}
+	else if ( mPipeline.GetColorSpace() == kPipeOpponent )
+		ConvertToOpponent( rgb, mChannels, h, w );
+	else
+		ConvertToGray( rgb, mChannels[0], h, w, mPipeline.GetGrayConversion() );
+
+	return ProcessChannels( response, len, NULL );
+}
+
+
+// directory for the intermediate files of file, created if they are saved; dirStr
+// then ends in a slash
+void GaborContext::MakeOutputDir( char* file, char* dirStr )
+{
+	char 	basename[256];
+	char*	fileStr;
+	int		i;
+
+// extract directory path from filename
+	strcpy( dirStr, file );
+	fileStr = strrchr( dirStr, '/' );
+	if ( fileStr != NULL )
+	{
+		strcpy( basename, fileStr );				// save part after last slash
+		dirStr[fileStr-dirStr+1] = '\0';				// save directory string
+		strcat( dirStr, basename );
+		strcat( dirStr, "-globalGF" );
+		basename[strlen(basename)-4] = '\0';			// remove extension
+		for ( i = 0; i < (int)strlen( basename ); i++ )	// remove intial slash
+			basename[i] = basename[i+1];
+		basename[i] = '\0';
+	}
+	else	// we are in working directory
+	{
+		strcpy( basename, file );
+		basename[strlen(basename)-4] = '\0';			// remove extension
+		strcpy( dirStr, basename );
+		strcat( dirStr, "-globalGF" );
+	}
+	
+// create img directory in extracted path
+	if ( mConfig.saveFilter )
+	{
+		mkdir( dirStr, S_IRWXU | S_IRWXG );
+		if ( mConfig.verbosity ) cerr << "Created directory: \"" << dirStr << "\"" << endl;
+		strcat( dirStr, "/" );
+	}
+}
+
+
+/* 
+pass the rgb pixel data for filtering; the response is returned in the response vector. 
+If NULL, this vector will be initialized by the Gabor API, but MUST disposed of it by the user.
+len is the address of an int holding the length of the response vector. 
+*/
+float* GaborContext::ProcessFile( char* file, int*** rgb, int h, int w, float* response, int* len )
+{
+	char 	basename[256];
+	char	dirStr[256];
+	int		i, j;
+
+	MakeOutputDir( file, dirStr );
+
+	AllocateChannels( h, w );
+
+	if ( mPipeline.GetColorSpace() == kPipeColor )
+	{
+	// copy rgb planes to the channel matrices
+		for ( i = 0; i < h; i++ )
+		{
+			for ( j = 0; j < w; j++ )
+			{
+				mChannels[0][i][j] = (float)rgb[0][i][j];
+				mChannels[1][i][j] = (float)rgb[1][i][j];
+				mChannels[2][i][j] = (float)rgb[2][i][j];
+			}
+		}
+
+	// save channels to file
+		if ( mConfig.saveFilter )
+		{	
+			PGMImage channelImg;
+			strcpy( basename, dirStr );
+			strcat( basename, "red.ppm" );
+			channelImg.Write( basename, mChannels[0], h, w, 0 );
+			strcpy( basename, dirStr );
+			strcat( basename, "green.ppm" );
+			channelImg.Write( basename, mChannels[1], h, w, 1 );
+			strcpy( basename, dirStr );
+			strcat( basename, "blue.ppm" );
+			channelImg.Write( basename, mChannels[2], h, w, 2 );
+		}
+	}
+	else if ( mPipeline.GetColorSpace() == kPipeOpponent )
+	{
+	// convert rgb info to an opponent color space while it is copied
+		ConvertToOpponent( rgb, mChannels, h, w );
+		if ( mConfig.saveFilter )
+		{
+			PGMImage	channelImg;
+			const char*	names[3] = { "lum.pgm", "rg.pgm", "by.pgm" };
+			for ( i = 0; i < 3; i++ )
+			{
+				strcpy( basename, dirStr );
+				strcat( basename, names[i] );
+				channelImg.WriteScaled( basename, mChannels[i], h, w );
+			}
+		}
+	}
+	else
+	{
+	//  convert rgb info to grayscale
+		ConvertToGray( rgb, mChannels[0], h, w, mPipeline.GetGrayConversion() );
+	}
+	
+	return ProcessChannels( response, len, mConfig.saveFilter ? dirStr : NULL );
+}
+
+
+// as ProcessFile for an image that was decoded straight to grayscale, which is filtered 
+// in place rather than copied
+float* GaborContext::ProcessGray( char* file, float** gray, int h, int w, float* response, int* len )
+{
+	char	dirStr[256];
+
+	MakeOutputDir( file, dirStr );
+
+	mImageArena.Reset();
+	mHeight = h;
+	mWidth = w;
+	mChannels[0] = gray;
+	
+	return ProcessChannels( response, len, mConfig.saveFilter ? dirStr : NULL );
+}
+
+
+// a grayscale pipeline needs no rgb planes, so the decoder can convert straight to gray
+void GaborContext::PrepareImage( PGMImage* image )
+{
+	image->SetGrayDecode( !mPipeline.IsColor(), mPipeline.GetGrayConversion() );
+}
+
+
+// whether image has the pixels the pipeline needs
+bool GaborContext::Accepts( PGMImage* image )
+{
+	if ( image->GetGrayPixels() != NULL ) return !mPipeline.IsColor();
+	return image->GetRGBPixels() != NULL;
+}
+
+
+// filter an image read by PGMImage, from its grayscale pixels or its rgb planes
+float* GaborContext::ProcessImage( char* file, PGMImage* image, float* response, int* len )
+{
+	*len = 0;
+	if ( !Accepts( image ) ) return response;
+	if ( image->GetGrayPixels() != NULL )
+		return ProcessGray( file, image->GetGrayPixels(), image->GetHeight(), image->GetWidth(),
+							response, len );
+	return ProcessFile( file, image->GetRGBPixels(), image->GetHeight(), image->GetWidth(),
+						response, len );
+}
+
+
+// filter each channel into its part of the response vector; intermediate files
+// are saved in dir unless it is NULL
+float* GaborContext::ProcessChannels( float* response, int* len, char* dir )
+{
+	const char*	rgbNames[3] = { "red", "green", "blue" };
+	const char*	opponentNames[3] = { "lum", "rg", "by" };
+	const char*	grayNames[1] = { "gf" };
+	const char**	names = grayNames;
+	char		basename[256];
+	int			offset = 0;
+
+	*len = GetResponseLength( mHeight, mWidth );
+	if ( *len == 0 ) return response;
+
+// response vector is initialized here, but needs to be disposed by user
+	if ( response == NULL ) response = new float[*len];
+
+// color channels share one pass of the jet, unless their responses are saved
+	if ( mNumChannels == kColorChannels && dir == NULL )
+	{
+		ProcessColor( response );
+		return response;
+	}
+
+	if ( mPipeline.GetColorSpace() == kPipeColor ) names = rgbNames;
+	if ( mPipeline.GetColorSpace() == kPipeOpponent ) names = opponentNames;
+	for ( int c = 0; c < mNumChannels; c++ )
+	{
+		if ( dir != NULL )
+		{
+			strcpy( basename, dir );
+			strcat( basename, names[c] );
+		}
+		offset += ProcessChannel( mChannels[c], mHeight, mWidth, response + offset, 
+								  ( dir != NULL ) ? basename : NULL );
+	}
+
+	return response;
+}
+
+
+// process a single color or grayscale channel
+int GaborContext::ProcessChannel( float** image, int h, int w, float* response, char* file )
+{
+	bool			save = mConfig.saveFilter && file != NULL;
+	int				height, width;
+	float** 		pixels;
+	StageBuffer		buffer = { image, h, w };
+	int				gflen;
+	bool			built;
+
+	if ( CanRefilter( save ) ) return ProcessIncremental( image, h, w, response );
+	mHavePrevious = false;
+	mRecomputed = 1.0;
+
+// run the map stages of the pipeline, their output lives in the channel arena
+	mChannelArena.Reset();
+	mPipeline.Process( &buffer, &mChannelArena, save ? file : NULL );
+	pixels = buffer.pixels;
+	height = buffer.height;
+	width  = buffer.width;
+	
+	built = PrepareJet( height, width, save, file );
+	
+// filter image
+	mJet->Filter( pixels, &gflen );
+	for ( int i = 0; i < gflen; i++ ) response[i] = mJet->GetResponse(i);
+	if ( built && mConfig.trim > 0.0 && mConfig.verbosity ) mJet->ReportTrim( pixels, cerr );
+	if ( mConfig.prune > 0.0 && mConfig.verbosity ) mJet->ReportPruning( pixels, cerr );
+
+// a jet that saves its output is not reused for the next image
+	if ( save )
+	{
+		delete mJet;
+		mJet = NULL;
+	}
+
+	return gflen;
+}
+
+
+// filter the color channels together: each runs through the map stages, and the jet 
+// then takes all three in one pass
+int GaborContext::ProcessColor( float* response )
+{
+	StageBuffer		buffers[kColorChannels];
+	float**			maps[kColorChannels];
+	int				c, len;
+	bool			built;
+
+	mHavePrevious = false;
+	mRecomputed = 1.0;
+	mChannelArena.Reset();
+	for ( c = 0; c < kColorChannels; c++ )
+	{
+		buffers[c].pixels = mChannels[c];
+		buffers[c].height = mHeight;
+		buffers[c].width = mWidth;
+		mPipeline.Process( &buffers[c], &mChannelArena, NULL );
+		maps[c] = buffers[c].pixels;
+	}
+
+	built = PrepareJet( buffers[0].height, buffers[0].width, false, NULL );
+	mJet->FilterChannels( maps, response, &len );
+	if ( built && mConfig.trim > 0.0 && mConfig.verbosity ) mJet->ReportTrim( maps[0], cerr );
+// the channels are filtered one after the other when pruning, the jet knows the last one
+	if ( mConfig.prune > 0.0 && mConfig.verbosity ) mJet->ReportPruning( maps[kColorChannels-1], cerr );
+	return len;
+}
+
+
+// whether a channel can be filtered incrementally (-I): a grayscale channel that goes
+// straight to the combined map, or through the contrast filter only, and whose windows 
+// are all filtered in floating point
+bool GaborContext::CanRefilter( bool save )
+{
+	int		stages = mPipeline.Has( kPipeContrast ) ? 1 : 0;
+
+	return mConfig.incremental > 0 && !save && mNumChannels == 1 && mRegion == NULL &&
+		   mConfig.layout == kLayoutCombined && mConfig.prune == 0.0 && 
+		   mConfig.engine != kEngineInt16 && mPipeline.GetNumStages() == stages;
+}
+
+
+// Filter a channel incrementally. The image is compared with the previous one a tile at
+// a time; only the contrast of the blocks of the map that read a changed tile, and the 
+// windows over those blocks, are computed again. The responses are those of filtering
+// the whole image.
+int GaborContext::ProcessIncremental( float** image, int h, int w, float* response )
+{
+	int		tile = mConfig.incremental;
+	int		halo = mPipeline.Has( kPipeContrast ) ? kContrastHalo : 0;
+	int		height = h - halo;
+	int		width = w - halo;
+	int		i, len, filtered;
+	bool	built;
+	float**	map;
+
+	built = PrepareJet( height, width, false, NULL );
+
+// the first image of its size: all of it
+	if ( built || !mHavePrevious || h != mPrevHeight || w != mPrevWidth || tile != mPrevTile )
+	{
+		AllocatePrevious( h, w );
+		map = ( halo > 0 ) ? mMap : image;
+		for ( i = 0; i < h; i++ ) memcpy( mPrevious[i], image[i], w * sizeof(float) );
+		if ( halo > 0 )
+		{
+			PROFILE_SCOPE( profile, kStageContrast );
+			PROFILE_COUNT( profile, height * width, 81 * height * width );
+			ApplyContrast( image, mMap, 0, 0, height, width );
+		}
+		mJet->Filter( map, &len );
+		filtered = len;
+	}
+// the next ones: what changed
+	else
+	{
+		map = ( halo > 0 ) ? mMap : image;
+		FindChanges( image, h, w );
+		filtered = mJet->Refilter( map, mDirty, tile, &len );
+	}
+
+	mHavePrevious = true;
+	mRecomputed = (float)filtered / len;
+	for ( i = 0; i < len; i++ ) response[i] = mJet->GetResponse( i );
+	if ( built && mConfig.trim > 0.0 && mConfig.verbosity ) mJet->ReportTrim( map, cerr );
+	if ( mConfig.verbosity ) cerr << "filtered " << filtered << " of " << len << " windows" << endl;
+	return len;
+}
+
+
+// compare an image of h x w pixels with mPrevious a tile at a time, keeping the tiles that
+// changed for the next image. Marks the blocks of the map that read one of them in mDirty,
+// and computes their contrast again.
+void GaborContext::FindChanges( float** image, int h, int w )
+{
+	int		tile = mConfig.incremental;
+	int		halo = mPipeline.Has( kPipeContrast ) ? kContrastHalo : 0;
+	int		height = h - halo;
+	int		width = w - halo;
+	int		tilesY = ( h + tile - 1 ) / tile;
+	int		tilesX = ( w + tile - 1 ) / tile;
+	int		blocksY = ( height + tile - 1 ) / tile;
+	int		blocksX = ( width + tile - 1 ) / tile;
+	int		i, ty, tx, by, bx, y0, y1, x0, x1, pixels = 0;
+	bool	changed;
+
+	PROFILE_SCOPE( profile, kStageContrast );
+
+// the tiles that changed
+	for ( ty = 0; ty < tilesY; ty++ )
+	{
+		y0 = ty * tile;
+		y1 = Min( y0 + tile, h );
+		for ( tx = 0; tx < tilesX; tx++ )
+		{
+			x0 = tx * tile;
+			x1 = Min( x0 + tile, w );
+			changed = false;
+			for ( i = y0; i < y1 && !changed; i++ )
+				changed = ( memcmp( mPrevious[i] + x0, image[i] + x0, ( x1 - x0 ) * sizeof(float) ) != 0 );
+			for ( i = y0; changed && i < y1; i++ )
+				memcpy( mPrevious[i] + x0, image[i] + x0, ( x1 - x0 ) * sizeof(float) );
+			mChanged[ty*tilesX+tx] = changed;
+		}
+	}
+
+// the blocks of the map that read one of them: block (by, bx) reads the tiles from
+// (by, bx) to those of its last pixel plus the halo of the contrast filter
+	for ( by = 0; by < blocksY; by++ )
+	{
+		y0 = by * tile;
+		y1 = Min( y0 + tile, height );
+		for ( bx = 0; bx < blocksX; bx++ )
+		{
+			x0 = bx * tile;
+			x1 = Min( x0 + tile, width );
+			changed = false;
+			for ( ty = by; ty <= ( y1 - 1 + halo ) / tile && !changed; ty++ )
+				for ( tx = bx; tx <= ( x1 - 1 + halo ) / tile && !changed; tx++ )
+					changed = mChanged[ty*tilesX+tx];
+			mDirty[by*blocksX+bx] = changed;
+			if ( !changed || halo == 0 ) continue;
+			ApplyContrast( image, mMap, y0, x0, y1, x1 );
+			pixels += ( y1 - y0 ) * ( x1 - x0 );
+		}
+	}
+	PROFILE_COUNT( profile, pixels, 81 * pixels );
+}
+
+
+// keep a copy of an image of h x w pixels, and its contrast map, for incremental 
+// filtering; 0 x 0 releases them
+void GaborContext::AllocatePrevious( int h, int w )
+{
+	int		tile = mConfig.incremental;
+	int		tiles;
+
+	if ( mPrevious != NULL ) DisposeMatrix( mPrevious, mPrevHeight );
+	if ( mMap != NULL ) DisposeMatrix( mMap, mPrevHeight );
+	if ( mChanged != NULL ) delete[] mChanged;
+	if ( mDirty != NULL ) delete[] mDirty;
+	mPrevious = mMap = NULL;
+	mChanged = mDirty = NULL;
+	mPrevHeight = h;
+	mPrevWidth = w;
+	mPrevTile = tile;
+	mHavePrevious = false;
+	if ( h == 0 || w == 0 || tile == 0 ) return;
+
+// the map is at most the size of the image
+	tiles = ( h + tile - 1 ) / tile * ( ( w + tile - 1 ) / tile );
+	PROFILE_BYTES( 2 * h * ( sizeof(float*) + w * sizeof(float) ) + 2 * tiles * sizeof(bool) );
+	mPrevious = CreateMatrix( (float)0.0, h, w );
+	mMap = CreateMatrix( (float)0.0, h, w );
+	mChanged = new bool[tiles];
+	mDirty = new bool[tiles];
+}
+
+
+// initialize gabor jet for a map of height x width, unless the filter bank of the 
+// previous image still fits; returns whether a new one was built
+bool GaborContext::PrepareJet( int height, int width, bool save, char* file )
+{
+	bool	built = false;
+
+	if ( mJet == NULL || save || mJet->GetLayout() != mConfig.layout || 
+		 mJet->GetBorder() != mConfig.border || mJet->GetTrim() != mConfig.trim ||
+		 !mJet->MatchesSubset( mSubset, mNumSubset ) ||
+		 !mJet->Matches( height, width, mConfig.sizeY, mConfig.sizeX, mConfig.spacingY, 
+						 mConfig.spacingX, mConfig.sigma, mConfig.freqs, mConfig.maxFreq, 
+						 mConfig.minFreq, mConfig.angles ) )
+	{
+		delete mJet;
+		mJet = new GaborJet;
+		if ( save ) mJet->SetFileName( file );
+		mJet->SetLayout( mConfig.layout );
+		mJet->SetBorder( mConfig.border );
+		mJet->SetTrim( mConfig.trim );
+		mJet->SetSubset( mSubset, mNumSubset );
+		mJet->Initialize( height, width, mConfig.sizeY, mConfig.sizeX, mConfig.spacingY, 
+						  mConfig.spacingX, mConfig.sigma, mConfig.freqs, mConfig.maxFreq, 
+						  mConfig.minFreq, mConfig.angles );
+		built = true;
+	}
+	mJet->SetEngine( mConfig.engine );
+	mJet->SetPruning( mConfig.prune );
+
+// the windows of the region, found for this map
+	UpdateCells( height, width );
+	if ( built || mCellsChanged )
+	{
+		mJet->SetCells( mCells, mNumCells );
+		mCellsChanged = false;
+	}
+	return built;
+}
+
+
+// read the region of the -R file, see GaborContext.h
+bool ReadRegion( char* file, GaborRegion* region )
+{
+	ifstream	infile;
+	PGMImage	image;
+	float**		gray;
+	int			i, j;
+
+	region->rects = NULL;
+	region->numRects = 0;
+	region->mask = NULL;
+	region->height = region->width = 0;
+
+	infile.open( file );
+	if ( infile.fail() )
+	{
+		FileOpenError( file );
+		return false;
+	}
+
+// an image: the mask
+	if ( infile.peek() == 'P' )
+	{
+		infile.close();
+		image.SetGrayDecode( true );
+		image.Read( file );
+		gray = image.GetGrayPixels();
+		if ( gray == NULL ) 
+		{
+			cerr << "Error: \"" << file << "\" is not a PGM or PPM image" << endl;
+			return false;
+		}
+		region->height = image.GetHeight();
+		region->width = image.GetWidth();
+		region->mask = CreateMatrix( 0, region->height, region->width );
+		for ( i = 0; i < region->height; i++ )
+			for ( j = 0; j < region->width; j++ ) region->mask[i][j] = ( gray[i][j] > 0.0 );
+		return true;
+	}
+
+// otherwise the number of rectangles and their coordinates
+	SkipComments( &infile );
+	infile >> region->numRects;
+	if ( infile.fail() || region->numRects <= 0 )
+	{
+		cerr << "Error: \"" << file << "\" holds no rectangles" << endl;
+		region->numRects = 0;
+		return false;
+	}
+	region->rects = CreateMatrix( 0, region->numRects, 4 );
+	for ( i = 0; i < region->numRects; i++ )
+	{
+		for ( j = 0; j < 4; j++ )
+		{
+			SkipComments( &infile );
+			infile >> region->rects[i][j];
+		}
+	}
+	if ( infile.fail() )
+	{
+		cerr << "Error: \"" << file << "\" holds no rectangles" << endl;
+		DisposeRegion( region );
+		return false;
+	}
+	return true;
+}
+
+
+void DisposeRegion( GaborRegion* region )
+{
+	if ( region->rects != NULL ) DisposeMatrix( region->rects, region->numRects );
+	if ( region->mask != NULL ) DisposeMatrix( region->mask, region->height );
+	region->rects = NULL;
+	region->mask = NULL;
+	region->numRects = 0;
+}
@@ -17,15 +17,22 @@ GaborFilter::GaborFilter()
 	mFrequency = 1.0;
 	mReal = NULL;
 	mImaginary = NULL;
+	mSupport = NULL;
 }
 
 
-// destructor
+// destructor: free up memory
 GaborFilter::~GaborFilter()
+{
+	Dispose();
+}
+
+
+// free the filter values so the filter can be initialized again
+void GaborFilter::Dispose( void )
 {
 	int i;
 	
-	// free up memory
 	if ( mReal != NULL )
 	{
 		for ( i = 0; i < mSizeY; i++ ) delete[] mReal[i];
@@ -36,6 +43,10 @@ GaborFilter::~GaborFilter()
 		for ( i = 0; i < mSizeY; i++ ) delete[] mImaginary[i];
 		delete[] mImaginary;
 	}
+	delete mSupport;
+	mReal = NULL;
+	mImaginary = NULL;
+	mSupport = NULL;
 }
 
 
@@ -44,6 +55,9 @@ void GaborFilter::Initialize( int sizey, int sizex, float a, float f, float s, f
 {
 	float x, y, exponential, sincos;
 	
+// release a previous setup
+	Dispose();
+
 // set internal variables
 	mSizeY = sizey;
 	mSizeX = sizex;
@@ -82,6 +96,14 @@ void GaborFilter::Initialize( int sizey, int sizex, float a, float f, float s, f
 }
 
 
+// find the taps that hold fraction of the energy of the filter
+void GaborFilter::Trim( float fraction )
+{
+	if ( mSupport == NULL ) mSupport = new FilterSupport;
+	mSupport->Compute( mReal, mImaginary, mSizeY, mSizeX, mYO, mXO, fraction );
+}
+
+
 // save the filter image
 void GaborFilter::Save( char* file, int angle, int freq )
 {
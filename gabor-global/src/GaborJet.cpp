@@ -5,6 +5,76 @@
 */
 
 #include "GaborJet.h"
+#include "Profiler.h"
+#include "Utilities.h"
+
+const char*	gLayoutNames[kNumLayouts] = { "combined", "angle", "jet" };
+
+
+int FindLayout( const char* name )
+{
+	for ( int l = 0; l < kNumLayouts; l++ )
+		if ( strcmp( name, gLayoutNames[l] ) == 0 ) return l;
+	return -1;
+}
+
+
+// see GaborJet.h; a summed area table of the mask tells whether a window holds any of it
+int FindMaskCells( int** mask, int h, int w, int sizeY, int sizeX, int spacingY, int spacingX,
+				   int border, int** cells )
+{
+	int		respY, respX, padY, padX, ry, rx, y0, y1, x0, x1, i, j, n = 0;
+	int*	sums;
+
+	if ( border == kBorderSkip )
+	{
+		if ( h < sizeY || w < sizeX ) return 0;
+		respY = ( h - sizeY ) / spacingY + 1;
+		respX = ( w - sizeX ) / spacingX + 1;
+		padY = padX = 0;
+	}
+	else
+	{
+		respY = ( h - 1 ) / spacingY + 1;
+		respX = ( w - 1 ) / spacingX + 1;
+		padY = sizeY / 2;
+		padX = sizeX / 2;
+	}
+
+// sums[i*(w+1)+j] counts the mask pixels above and left of (i, j)
+	sums = new int[(h+1)*(w+1)];
+	for ( j = 0; j <= w; j++ ) sums[j] = 0;
+	for ( i = 0; i < h; i++ )
+	{
+		sums[(i+1)*(w+1)] = 0;
+		for ( j = 0; j < w; j++ )
+			sums[(i+1)*(w+1)+j+1] = sums[i*(w+1)+j+1] + sums[(i+1)*(w+1)+j] - sums[i*(w+1)+j] + 
+									( mask[i][j] != 0 );
+	}
+
+// windows past the edge only count the part inside the map
+	for ( ry = 0; ry < respY; ry++ )
+	{
+		y0 = Max( ry * spacingY - padY, 0 );
+		y1 = Min( ry * spacingY - padY + sizeY, h );
+		for ( rx = 0; rx < respX; rx++ )
+		{
+			x0 = Max( rx * spacingX - padX, 0 );
+			x1 = Min( rx * spacingX - padX + sizeX, w );
+			if ( sums[y1*(w+1)+x1] - sums[y0*(w+1)+x1] - sums[y1*(w+1)+x0] + sums[y0*(w+1)+x0] == 0 ) 
+				continue;
+			if ( cells != NULL )
+			{
+				cells[n][0] = ry;
+				cells[n][1] = rx;
+			}
+			n++;
+		}
+	}
+
+	delete[] sums;
+	return n;
+}
 
 // default constructor just sets everything to default
 GaborJet::GaborJet()
@@ -14,42 +84,147 @@ GaborJet::GaborJet()
 	mSpacingY 	= 4;
 	mSpacingX 	= 4;
 	mFilters 	= NULL;
+	mSubset		= NULL;
+	mNumSubset	= 0;
+	mBank		= NULL;
+	mBankIndex	= NULL;
+	mNumFilters	= 0;
 	mPixels		= NULL;
+	mBorder		= kBorderSkip;
+	mTrim		= 0.0;
+	mTiling		= true;
+	mTile		= NULL;
+	mTileSums	= NULL;
+	mCells		= NULL;
+	mNumCells	= 0;
+	mPruning	= 0.0;
+	mCoarse		= NULL;
+	mRefined	= NULL;
+	mNumRefined	= 0;
+	mNumPruned	= 0;
+	mDirtyCells	= NULL;
+	mCoarseFilters = 0;
+	for ( int c = 0; c < kColorChannels; c++ ) mPadded[c] = NULL;
+	mLayout		= kLayoutCombined;
+	mTensor		= NULL;
 	mResponses	= NULL;
 	mNormals	= NULL;
+	mChannelMaps = NULL;
+	mPacked		= NULL;
 	saveFilter  = false;
+	mEngine		= kEngineAuto;
+	mFixedReal	= NULL;
+	mFixedImag	= NULL;
+	mFixedScale	= NULL;
 }
 
 
 // destructor: free up memory
 GaborJet::~GaborJet()
+{
+	Dispose();
+	if ( mSubset != NULL ) delete[] mSubset;
+}
+
+
+// free filters and responses so the jet can be initialized again
+void GaborJet::Dispose( void )
 {
 	if ( mFilters != NULL )
 	{
 		for ( int i = 0; i < mAngles; i++ ) delete[] mFilters[i];
 		delete[] mFilters;
+		delete[] mBank;
+		delete[] mBankIndex;
 	}
 	
 	if ( mResponses != NULL )
 	{
-	#if kAngleSeparation
-		for ( int i = 0; i < mAngles; i++ )
-		{
-			for ( int j = 0; j < mFreqs; j++ )
-			{
-				for ( int k = 0; k < mRespY; k++ ) delete[] mResponses[i][j][k];
-				delete[] mResponses[i][j];
-			}
-			delete[] mResponses[i];
-		}
-		delete[] mResponses;
-	#else
-		for ( int i = 0; i < mRespY; i++ ) delete[] mResponses[i];
+		delete[] mTensor;
 		delete[] mResponses;	
-	#endif
 	}
 	
 	if ( mNormals != NULL ) delete[] mNormals;
+	if ( mChannelMaps != NULL ) delete[] mChannelMaps;
+	if ( mPacked != NULL )
+	{
+		delete[] mPacked[0];
+		delete[] mPacked;
+	}
+	if ( mFixedReal != NULL )
+	{
+		delete[] mFixedReal;
+		delete[] mFixedImag;
+		delete[] mFixedScale;
+	}
+	if ( mCells != NULL ) delete[] mCells;
+	if ( mCoarse != NULL )
+	{
+		delete[] mCoarse;
+		delete[] mRefined;
+	}
+	if ( mDirtyCells != NULL ) delete[] mDirtyCells;
+	for ( int c = 0; c < kColorChannels; c++ )
+	{
+		if ( mPadded[c] == NULL ) continue;
+		delete[] mPadded[c][0];
+		delete[] mPadded[c];
+		mPadded[c] = NULL;
+	}
+
+	mFilters 	= NULL;
+	mBank		= NULL;
+	mBankIndex	= NULL;
+	mNumFilters	= 0;
+	mTensor		= NULL;
+	mResponses	= NULL;
+	mNormals	= NULL;
+	mChannelMaps = NULL;
+	mPacked		= NULL;
+	mFixedReal	= NULL;
+	mFixedImag	= NULL;
+	mFixedScale	= NULL;
+	mCells		= NULL;
+	mCoarse		= NULL;
+	mRefined	= NULL;
+	mDirtyCells	= NULL;
+}
+
+
+// whether the jet was already initialized with these settings, so that
+// its filter bank can be reused for the next image
+bool GaborJet::Matches( int y, int x, int ys, int xs, int ysp, int xsp, 
+						float s, int f, float maxF, float minF, int a )
+{
+	return mFilters != NULL && mHeight == y && mWidth == x && 
+		   mSizeY == ys && mSizeX == xs && mSpacingY == ysp && mSpacingX == xsp &&
+		   mSigma == (float)( s * M_PI * M_PI ) && mFreqs == f && 
+		   mMaxFreq == maxF && mMinFreq == minF && mAngles == a;
+}
+
+
+// see GaborJet.h
+void GaborJet::SetSubset( int* filters, int numFilters )
+{
+	if ( mSubset != NULL ) delete[] mSubset;
+	mSubset = NULL;
+	mNumSubset = 0;
+	if ( filters == NULL ) return;
+	mSubset = new int[Max( numFilters, 1 )];
+	for ( int k = 0; k < numFilters; k++ ) mSubset[k] = filters[k];
+	mNumSubset = numFilters;
+}
+
+
+// see GaborJet.h
+bool GaborJet::MatchesSubset( int* filters, int numFilters )
+{
+	if ( mFilters == NULL ) return false;
+	if ( filters == NULL ) return mNumFilters == mAngles * mFreqs;
+	if ( numFilters != mNumFilters ) return false;
+	for ( int k = 0; k < numFilters; k++ )
+		if ( filters[k] != mBankIndex[k] ) return false;
+	return true;
 }
 
 
@@ -57,9 +232,15 @@ GaborJet::~GaborJet()
 void GaborJet::Initialize( int y, int x, int ys, int xs, int ysp, int xsp, 
 						float s, int f, float maxF, float minF, int a )
 {
-	int		i, j, k, l;
+	int		i, j, k, maps, rows, side, cols;
 	float	angle, freq;
+	bool*	used;
 	
+	PROFILE_SCOPE( profile, kStageFilterBank );
+
+// release a previous setup
+	Dispose();
+
 // set internal variables
 	mHeight 	= y;
 	mWidth 		= x;
@@ -73,7 +254,17 @@ void GaborJet::Initialize( int y, int x, int ys, int xs, int ysp, int xsp,
 	mMinFreq 	= minF;
 	mMaxFreq 	= maxF;
 	
+// the filters in use, all of them unless SetSubset() chose some
+	used = new bool[mAngles*mFreqs];
+	for ( k = 0; k < mAngles * mFreqs; k++ ) used[k] = ( mSubset == NULL );
+	for ( k = 0; mSubset != NULL && k < mNumSubset; k++ )
+		if ( mSubset[k] >= 0 && mSubset[k] < mAngles * mFreqs ) used[mSubset[k]] = true;
+	mBank = new GaborFilter*[mAngles*mFreqs];
+	mBankIndex = new int[mAngles*mFreqs];
+	mNumFilters = 0;
+
 // allocate memory for filters
+	mTaps = 0;
 	mFilters = new GaborFilter*[mAngles]; // angles * freqs = total filters
 	for ( i = 0; i < mAngles; i++ )
 	{
@@ -84,221 +275,1008 @@ void GaborJet::Initialize( int y, int x, int ys, int xs, int ysp, int xsp,
 	// initialize each one	
 		for ( j = 0; j < mFreqs; j++ )
 		{
+			if ( !used[i*mFreqs+j] ) continue;
 		// calculate frequency
 			freq = minF + ( j * ( maxF - minF ) ) / (float)mFreqs;
 		// initialize filter
 			mFilters[i][j].Initialize( mSizeY, mSizeX, angle, freq, mSigma );
+			if ( mTrim > 0.0 ) mFilters[i][j].Trim( mTrim );
+			mTaps += ( mTrim > 0.0 ) ? mFilters[i][j].GetSupport()->GetTaps() : mSizeY * mSizeX;
 			if ( saveFilter ) mFilters[i][j].Save( mFile, i, j );
+			mBank[mNumFilters] = &mFilters[i][j];
+			mBankIndex[mNumFilters++] = i * mFreqs + j;
 		}
 	}
+	delete[] used;
 	
-// allocate memory for the responses
-	mRespY = ( mHeight - mSizeY ) / mSpacingY + 1;
-	mRespX = ( mWidth - mSizeX ) / mSpacingX + 1;
-#if kAngleSeparation
-	mResponses = new float***[mAngles];
-	for ( i = 0; i < mAngles; i++ )
+// allocate memory for the responses, one block for all maps with a row pointer
+// for each row of each map (or each row of jets)
+	if ( mBorder == kBorderSkip )
 	{
-		mResponses[i] = new float**[mFreqs];
-		for ( j = 0; j < mFreqs; j++ )
+		mRespY = ( mHeight - mSizeY ) / mSpacingY + 1;
+		mRespX = ( mWidth - mSizeX ) / mSpacingX + 1;
+		mPadY = mPadX = 0;
+		mPaddedY = mHeight;
+		mPaddedX = mWidth;
+	}
+	else
+	{
+		mRespY = ( mHeight - 1 ) / mSpacingY + 1;
+		mRespX = ( mWidth - 1 ) / mSpacingX + 1;
+		mPadY = mSizeY / 2;
+		mPadX = mSizeX / 2;
+		mPaddedY = ( mRespY - 1 ) * mSpacingY + mSizeY;
+		mPaddedX = ( mRespX - 1 ) * mSpacingX + mSizeX;
+	}
+	mNumCells = mRespY * mRespX;
+
+// tiles of as many windows as fit in kTileBytes, with rows of whole cache lines; 
+// a tile of a single window would only add a copy, so then there are none
+	side = (int)sqrt( kTileBytes / (float)sizeof(float) );
+	mTileY = Min( mRespY, Max( 1, ( side - mSizeY ) / mSpacingY + 1 ) );
+	mTileX = Min( mRespX, Max( 1, ( side - mSizeX ) / mSpacingX + 1 ) );
+	mTileArena.Reset();
+	mTile = NULL;
+	mTileSums = NULL;
+	if ( mTileY * mTileX > 1 )
+	{
+		rows = ( mTileY - 1 ) * mSpacingY + mSizeY;
+		cols = ( ( mTileX - 1 ) * mSpacingX + mSizeX + 15 ) & ~15;
+		PROFILE_BYTES( rows * ( sizeof(float*) + cols * sizeof(float) ) + 2 * mTileY * mTileX * sizeof(float) );
+		mTile = mTileArena.NewMatrix( rows, cols );
+		mTileSums = (float*)mTileArena.Allocate( 2 * mTileY * mTileX * sizeof(float) );
+	}
+
+	maps = ( mLayout == kLayoutCombined ) ? 1 : mNumFilters;
+	rows = ( mLayout == kLayoutAngleMajor ) ? maps * mRespY : mRespY;
+	PROFILE_COUNT( profile, mNumFilters * mSizeY * mSizeX, 0 );
+	PROFILE_BYTES( mNumFilters * 2 * mSizeY * ( sizeof(float*) + mSizeX * sizeof(float) ) );
+	PROFILE_BYTES( maps * mRespY * mRespX * sizeof(float) + rows * sizeof(float*) );
+	mTensor = new float[maps*mRespY*mRespX];
+	for ( i = 0; i < maps * mRespY * mRespX; i++ ) mTensor[i] = 0.0;
+	mResponses = new float*[rows];
+	for ( i = 0; i < rows; i++ ) mResponses[i] = mTensor + i * ( maps * mRespY * mRespX / rows );
+	if ( mLayout == kLayoutCombined )
+	{
+		PROFILE_BYTES( mRespY * mRespX * sizeof(float) );
+		mNormals = new float[mRespX*mRespY];
+	}
+	else
+	{
+		PROFILE_BYTES( maps * sizeof(float) );
+		mNormals = new float[maps];
+	}
+}
+
+
+// see GaborJet.h
+void GaborJet::SetCells( int** cells, int numCells )
+{
+	int		k, maps;
+
+	if ( mCells != NULL ) delete[] mCells;
+	mCells = NULL;
+	mNumCells = mRespY * mRespX;
+	if ( cells != NULL )
+	{
+		PROFILE_BYTES( numCells * sizeof(int) );
+		mCells = new int[Max( numCells, 1 )];
+		for ( k = 0; k < numCells; k++ ) mCells[k] = cells[k][0] * mRespX + cells[k][1];
+		mNumCells = numCells;
+	}
+
+// the windows left out keep a response of 0
+	maps = ( mLayout == kLayoutCombined ) ? 1 : mNumFilters;
+	for ( k = 0; k < maps * mRespY * mRespX; k++ ) mTensor[k] = 0.0;
+}
+
+
+// the matrix the windows of channel c run over: image itself, or a copy of it with a 
+// band around it filled in by the border policy
+float** GaborJet::PadImage( float** image, int c )
+{
+	if ( mBorder == kBorderSkip ) return image;
+	if ( mPadded[c] == NULL )
+	{
+		PROFILE_BYTES( mPaddedY * ( sizeof(float*) + mPaddedX * sizeof(float) ) );
+		mPadded[c] = new float*[mPaddedY];
+		mPadded[c][0] = new float[mPaddedY*mPaddedX];
+		for ( int i = 1; i < mPaddedY; i++ ) mPadded[c][i] = mPadded[c][0] + i * mPaddedX;
+	}
+	GatherBorder( image, mHeight, mWidth, -mPadY, -mPadX, mPaddedY, mPaddedX, mBorder, mPadded[c] );
+	return mPadded[c];
+}
+
+
+// responses of filter (a, f) in place, see GaborJet.h
+float* GaborJet::GetMap( int a, int f, int* rowStride, int* colStride )
+{
+	if ( mLayout == kLayoutCombined ) return GetFilterMap( 0, rowStride, colStride );
+	for ( int k = 0; k < mNumFilters; k++ )
+		if ( mBankIndex[k] == a * mFreqs + f ) return GetFilterMap( k, rowStride, colStride );
+	return NULL;
+}
+
+
+// responses of the k-th filter in use in place, or of all of them with kLayoutCombined
+float* GaborJet::GetFilterMap( int k, int* rowStride, int* colStride )
+{
+	switch ( mLayout )
+	{
+		case kLayoutAngleMajor:
+			*rowStride = mRespX;
+			*colStride = 1;
+			return mResponses[k*mRespY];
+		case kLayoutJetMajor:
+			*rowStride = mRespX * mNumFilters;
+			*colStride = mNumFilters;
+			return mTensor + k;
+		default:
+			*rowStride = mRespX;
+			*colStride = 1;
+			return mTensor;
+	}
+}
+
+
+// responses of all windows with an S x S filter, two neighbouring windows at a time.
+// Windows always lie inside the (padded) image, so no bounds are checked.
+template <int S>
+void GaborJet::FilterFixed( void )
+{
+	int		rx, ry, x, y, k;
+	float	sumR0, sumI0, sumR1, sumI1;
+
+	y = 0;
+	for ( ry = 0; ry < mRespY; ry++ )
+	{
+		x = 0;
+		for ( rx = 0; rx + 1 < mRespX; rx += 2 )
+		{
+			sumR0 = sumI0 = sumR1 = sumI1 = 0.0;
+			for ( k = 0; k < mNumFilters; k++ )
+				CorrelateWindowPair<S,S>( mPixels, y, x, mSpacingX, mBank[k]->GetRealPart(),
+										  mBank[k]->GetImaginaryPart(), sumR0, sumI0, sumR1, sumI1 );
+			mResponses[ry][rx] = sqrt( sumR0*sumR0 + sumI0*sumI0 );
+			mResponses[ry][rx+1] = sqrt( sumR1*sumR1 + sumI1*sumI1 );
+			x = x + 2 * mSpacingX;
+		}
+	// an odd window at the end of the row
+		if ( rx < mRespX )
 		{
-			mResponses[i][j] = new float*[mRespY];
-			for ( k = 0; k < mRespY; k++ )
+			sumR0 = sumI0 = 0.0;
+			for ( k = 0; k < mNumFilters; k++ )
+				CorrelateWindow<S,S>( mPixels, y, x, mBank[k]->GetRealPart(),
+									  mBank[k]->GetImaginaryPart(), sumR0, sumI0 );
+			mResponses[ry][rx] = sqrt( sumR0*sumR0 + sumI0*sumI0 );
+		}
+		y = y + mSpacingY;
+	}
+}
+
+
+// the pixels under the ny x nx windows from window (ry, rx) on, copied to mTile
+float** GaborJet::LoadTile( int ry, int rx, int ny, int nx )
+{
+	int		y = ry * mSpacingY;
+	int		x = rx * mSpacingX;
+	int		rows = ( ny - 1 ) * mSpacingY + mSizeY;
+	int		cols = ( nx - 1 ) * mSpacingX + mSizeX;
+
+	for ( int i = 0; i < rows; i++ )
+		memcpy( mTile[i], mPixels[y+i] + x, cols * sizeof(float) );
+	return mTile;
+}
+
+
+// responses of all windows a tile at a time, with an S x S filter or, if S is 0, any
+// size. Each filter runs over all windows of the tile before the next one, four windows
+// at a time, so the filter stays in L1 and the tile in L2 instead of the filter bank
+// streaming through the cache for every window. The sums of a window are added up in 
+// the same order as by FilterFixed() and the generic loops, so the responses are the same.
+template <int S>
+void GaborJet::FilterTiled( void )
+{
+	int		ty, tx, ny, nx, ry, rx, x, y, h, i, j, k;
+	float	sumR0, sumI0, sumR1, sumI1;
+	float*	sumR;
+	float*	sumI;
+	float**	real;
+	float**	imag;
+	float**	tile;
+
+	for ( ty = 0; ty < mRespY; ty += mTileY )
+	{
+		ny = Min( mTileY, mRespY - ty );
+		for ( tx = 0; tx < mRespX; tx += mTileX )
+		{
+			nx = Min( mTileX, mRespX - tx );
+			tile = LoadTile( ty, tx, ny, nx );
+			sumR = mTileSums;
+			sumI = mTileSums + ny * nx;
+			for ( k = 0; k < 2 * ny * nx; k++ ) mTileSums[k] = 0.0;
+
+			for ( h = 0; h < mNumFilters; h++ )
 			{
-				mResponses[i][j][k] = new float[mRespX];
-				for ( l = 0; l < mRespX; l++ ) mResponses[i][j][k][l] = 0.0;
+				real = mBank[h]->GetRealPart();
+				imag = mBank[h]->GetImaginaryPart();
+				k = 0;
+				for ( ry = 0; ry < ny; ry++ )
+				{
+					y = ry * mSpacingY;
+					x = 0;
+					rx = 0;
+				// four neighbouring windows at a time, then two, then one
+					for ( ; rx + 3 < nx; rx += 4 )
+					{
+						CorrelateWindowQuad( tile, y, x, mSpacingX, real, imag, ( S > 0 ) ? S : mSizeY,
+											 ( S > 0 ) ? S : mSizeX, sumR + k, sumI + k );
+						k += 4;
+						x = x + 4 * mSpacingX;
+					}
+					for ( ; S > 0 && rx + 1 < nx; rx += 2 )
+					{
+						sumR0 = sumR[k];
+						sumI0 = sumI[k];
+						sumR1 = sumR[k+1];
+						sumI1 = sumI[k+1];
+						CorrelateWindowPair<S,S>( tile, y, x, mSpacingX, real, imag, 
+												  sumR0, sumI0, sumR1, sumI1 );
+						sumR[k] = sumR0;
+						sumI[k] = sumI0;
+						sumR[k+1] = sumR1;
+						sumI[k+1] = sumI1;
+						k += 2;
+						x = x + 2 * mSpacingX;
+					}
+					for ( ; rx < nx; rx++ )
+					{
+						sumR0 = sumR[k];
+						sumI0 = sumI[k];
+						if ( S > 0 ) CorrelateWindow<S,S>( tile, y, x, real, imag, sumR0, sumI0 );
+						else
+						{
+							for ( i = 0; i < mSizeY; i++ )
+								for ( j = 0; j < mSizeX; j++ )
+								{
+									sumR0 += tile[y+i][x+j] * real[i][j];
+									sumI0 += tile[y+i][x+j] * imag[i][j];
+								}
+						}
+						sumR[k] = sumR0;
+						sumI[k] = sumI0;
+						k++;
+						x = x + mSpacingX;
+					}
+				}
 			}
+
+			k = 0;
+			for ( ry = 0; ry < ny; ry++ )
+				for ( rx = 0; rx < nx; rx++, k++ )
+					mResponses[ty+ry][tx+rx] = sqrt( sumR[k]*sumR[k] + sumI[k]*sumI[k] );
 		}
-	}	
-	mNormals = new float[mAngles*mFreqs];
-#else
-	mResponses = new float*[mRespY];
-	for ( i = 0; i < mRespY; i++ )
+	}
+}
+
+
+// responses of the numCells windows at the map indices cells only, in the combined 
+// map, with an S x S filter or, if S is 0, any size; the sums are added up as by the 
+// loops over all windows
+template <int S>
+void GaborJet::FilterCells( int* cells, int numCells )
+{
+	int		k, x, y, h, i, j;
+	float	sumR, sumI;
+	float**	real;
+	float**	imag;
+
+	for ( k = 0; k < numCells; k++ )
 	{
-		mResponses[i] = new float[mRespX];
-		for ( j = 0; j < mRespX; j++ ) mResponses[i][j] = 0.0;
+		y = cells[k] / mRespX * mSpacingY;
+		x = cells[k] % mRespX * mSpacingX;
+		sumR = sumI = 0.0;
+		for ( h = 0; h < mNumFilters; h++ )
+		{
+			real = mBank[h]->GetRealPart();
+			imag = mBank[h]->GetImaginaryPart();
+			if ( mTrim > 0.0 ) 
+				CorrelateSupport( mPixels, y, x, real, imag, mBank[h]->GetSupport(), sumR, sumI );
+			else if ( S > 0 ) 
+				CorrelateWindow<S,S>( mPixels, y, x, real, imag, sumR, sumI );
+			else
+			{
+				for ( i = 0; i < mSizeY; i++ )
+					for ( j = 0; j < mSizeX; j++ )
+					{
+						sumR += mPixels[y+i][x+j] * real[i][j];
+						sumI += mPixels[y+i][x+j] * imag[i][j];
+					}
+			}
+		}
+		mTensor[cells[k]] = sqrt( sumR*sumR + sumI*sumI );
 	}
-	mNormals = new float[mRespX*mRespY];
-#endif
 }
 
 
-// process an image
-void GaborJet::Filter( float** image, int* len )
-{	
-	int			rx, ry;		// iterating over mResponses
-	int			x, y;		// iterating over location
-	int			gx, gy;		// iterating over filters
-	int			a, f;		// iterating over angles and frequencies
-	int			i, j;		// iterating over filter field
-	int			h = 0;		// iterates over normal vector
-	float		sumI, sumR;	// sum of imaginary and of real parts
-	float		local_sumI, 
-				local_sumR;	// sum of imaginary and of real parts
-	float		norm;		// for normalization
-	
-	mPixels = image;
+// the coarse pass of coarse-to-fine filtering: the energy of the lowest frequency in 
+// use, summed over its angles, at each coarse window; then the windows to refine, those
+// with a coarse window above the threshold at one of the corners of their cell
+void GaborJet::FilterCoarse( void )
+{
+	int		coarseY = ( mRespY - 1 ) / kCoarseStep + 1;
+	int		coarseX = ( mRespX - 1 ) / kCoarseStep + 1;
+	int		cy, cx, cy1, cx1, ry, rx, x, y, h, i, j, lowest;
+	float	sumR, sumI, energy, threshold, max = 0.0;
+	float*	c0;
+	float*	c1;
+	float**	real;
+	float**	imag;
 
-#if kAngleSeparation
+	if ( mCoarse == NULL )
+	{
+		PROFILE_BYTES( coarseY * coarseX * sizeof(float) + mRespY * mRespX * sizeof(int) );
+		mCoarse = new float[coarseY*coarseX];
+		mRefined = new int[mRespY*mRespX];
+	}
+	lowest = mFreqs;
+	for ( h = 0; h < mNumFilters; h++ ) lowest = Min( lowest, mBankIndex[h] % mFreqs );
+	mCoarseFilters = 0;
+	for ( h = 0; h < mNumFilters; h++ ) if ( mBankIndex[h] % mFreqs == lowest ) mCoarseFilters++;
 
-// start collecting responses
-	h = 0;
-	for ( a = 0; a < mAngles; a++ )
+	for ( cy = 0; cy < coarseY; cy++ )
 	{
-		for ( f = 0; f < mFreqs; f++ )
+		for ( cx = 0; cx < coarseX; cx++ )
 		{
-			sumI = 0.0;
-			sumR = 0.0;
-
-			y = 0;
-			for ( ry = 0; ry < mRespY; ry++ )
+			y = cy * kCoarseStep * mSpacingY;
+			x = cx * kCoarseStep * mSpacingX;
+			energy = 0.0;
+			for ( h = 0; h < mNumFilters; h++ )
 			{
-				x = 0;
-				for ( rx = 0; rx < mRespX; rx++ )
+				if ( mBankIndex[h] % mFreqs != lowest ) continue;
+				real = mBank[h]->GetRealPart();
+				imag = mBank[h]->GetImaginaryPart();
+				sumR = sumI = 0.0;
+				if ( mTrim > 0.0 ) 
+					CorrelateSupport( mPixels, y, x, real, imag, mBank[h]->GetSupport(), sumR, sumI );
+				else
 				{
-					local_sumI = 0.0;
-					local_sumR = 0.0;
-					
-					for ( gy = y; gy < y + mSizeY; gy++ )
-					{
-						for ( gx = x; gx < x + mSizeX; gx++ )
+					for ( i = 0; i < mSizeY; i++ )
+						for ( j = 0; j < mSizeX; j++ )
 						{
-						// make sure we are not out of bounds
-							if ( gx > mWidth || gy > mHeight ) break;
-						// offset to local coordinates of filter
-							i = gy - y;
-							j = gx - x;
-						// get real and imaginary products
-							sumR += mPixels[gy][gx] * mFilters[a][f].GetReal(i,j);
-							sumI += mPixels[gy][gx] * mFilters[a][f].GetImaginary(i,j);
-							local_sumR += mPixels[gy][gx] * mFilters[a][f].GetReal(i,j);
-							local_sumI += mPixels[gy][gx] * mFilters[a][f].GetImaginary(i,j);
+							sumR += mPixels[y+i][x+j] * real[i][j];
+							sumI += mPixels[y+i][x+j] * imag[i][j];
 						}
-					}					
-				// collect responses
-					mResponses[a][f][ry][rx] = sqrt( local_sumR*local_sumR + local_sumI*local_sumI );
-					
-					x = x + mSpacingX;			
-				}	// rx
-				y = y + mSpacingY;
-			}	// ry
-
-			mNormals[h] = sqrt( sumR*sumR + sumI*sumI );
-			h++;
-		}	// f
-	}	// a
-
-	float max, min;
+				}
+				energy += sqrt( sumR*sumR + sumI*sumI );
+			}
+			mCoarse[cy*coarseX+cx] = energy;
+			if ( energy > max ) max = energy;
+		}
+	}
+
+	threshold = mPruning * max;
+	mNumRefined = 0;
+	for ( ry = 0; ry < mRespY; ry++ )
+	{
+		cy = ry / kCoarseStep;
+		cy1 = Min( ( ry + kCoarseStep - 1 ) / kCoarseStep, coarseY - 1 );
+		c0 = mCoarse + cy * coarseX;
+		c1 = mCoarse + cy1 * coarseX;
+		for ( rx = 0; rx < mRespX; rx++ )
+		{
+			cx = rx / kCoarseStep;
+			cx1 = Min( ( rx + kCoarseStep - 1 ) / kCoarseStep, coarseX - 1 );
+			mTensor[ry*mRespX+rx] = 0.0;
+			if ( c0[cx] >= threshold || c0[cx1] >= threshold || c1[cx] >= threshold || c1[cx1] >= threshold )
+				mRefined[mNumRefined++] = ry * mRespX + rx;
+		}
+	}
+	mNumPruned = mRespY * mRespX - mNumRefined;
+}
+
+
+// see GaborJet.h
+void GaborJet::ReportPruning( float** image, ostream& out )
+{
+	int		cells = mRespY * mRespX;
+	int		coarse = ( ( mRespY - 1 ) / kCoarseStep + 1 ) * ( ( mRespX - 1 ) / kCoarseStep + 1 );
+	int		refined = mNumRefined;
+	int		significant = 0, kept = 0, h, k, len;
+	float	pruning = mPruning, max = 0.0, lost = 0.0;
+	bool	save = saveFilter;
+	bool*	pruned;
+	double	done;
+
+	if ( mPruning <= 0.0 || mCells != NULL || mLayout != kLayoutCombined ) return;
+	pruned = new bool[cells];
+	for ( h = 0; h < cells; h++ ) pruned[h] = true;
+	for ( k = 0; k < mNumRefined; k++ ) pruned[mRefined[k]] = false;
+
+// the full map, as it would be without pruning
+	mPruning = 0.0;
+	saveFilter = false;
+	Filter( image, &len );
+	mPruning = pruning;
+	saveFilter = save;
+
+	for ( h = 0; h < cells; h++ ) if ( mTensor[h] > max ) max = mTensor[h];
+	for ( h = 0; h < cells; h++ )
+	{
+		if ( mTensor[h] >= mPruning * max )
+		{
+			significant++;
+			if ( !pruned[h] ) kept++;
+		}
+		if ( pruned[h] && mTensor[h] > lost ) lost = mTensor[h];
+	}
+
+// the coarse pass runs one frequency, the refined windows all filters
+	done = (double)coarse * mCoarseFilters / mNumFilters + refined;
+	out << "pruned " << cells - refined << " of " << cells << " windows, ";
+	out << 100.0 * ( 1.0 - done / cells ) << "% fewer flops" << endl;
+	out << "recall " << ( ( significant > 0 ) ? (double)kept / significant : 1.0 ) << " of the ";
+	out << significant << " windows with a full response of at least " << mPruning;
+	out << " of the largest; largest pruned response " << ( ( max > 0.0 ) ? lost / max : 0.0 ) << endl;
+
+	delete[] pruned;
+}
+
+
+// responses of all windows, each filter over the taps it kept
+void GaborJet::FilterTrimmed( void )
+{
+	int		rx, ry, x, y, k;
+	float	sumR, sumI;
+
+	y = 0;
+	for ( ry = 0; ry < mRespY; ry++ )
+	{
+		x = 0;
+		for ( rx = 0; rx < mRespX; rx++ )
+		{
+			sumR = sumI = 0.0;
+			for ( k = 0; k < mNumFilters; k++ )
+				CorrelateSupport( mPixels, y, x, mBank[k]->GetRealPart(), mBank[k]->GetImaginaryPart(),
+								  mBank[k]->GetSupport(), sumR, sumI );
+			mResponses[ry][rx] = sqrt( sumR*sumR + sumI*sumI );
+			x = x + mSpacingX;
+		}
+		y = y + mSpacingY;
+	}
+}
+
+
+// see GaborJet.h; the error of a filter is the largest difference of its responses
+// over all windows, relative to the largest whole response
+void GaborJet::ReportTrim( float** image, ostream& out )
+{
+	int		rx, ry, x, y, a, f, h, i, j;
+	int		taps = mSizeY * mSizeX;
+	float	fullR, fullI, trimR, trimI, full, error, peak;
+	double	kept = 0.0;
+	FilterSupport*	support;
+	float**	pixels = PadImage( image, 0 );
+
+	for ( h = 0; h < mNumFilters; h++ )
+	{
+		a = mBankIndex[h] / mFreqs;
+		f = mBankIndex[h] % mFreqs;
+		support = mBank[h]->GetSupport();
+		if ( support == NULL ) return;
+		float**	real = mBank[h]->GetRealPart();
+		float**	imag = mBank[h]->GetImaginaryPart();
+		error = peak = 0.0;
+		y = 0;
+		for ( ry = 0; ry < mRespY; ry++ )
+		{
+			x = 0;
+			for ( rx = 0; rx < mRespX; rx++ )
+			{
+				fullR = fullI = trimR = trimI = 0.0;
+				for ( i = 0; i < mSizeY; i++ )
+					for ( j = 0; j < mSizeX; j++ )
+					{
+						fullR += pixels[y+i][x+j] * real[i][j];
+						fullI += pixels[y+i][x+j] * imag[i][j];
+					}
+				CorrelateSupport( pixels, y, x, real, imag, support, trimR, trimI );
+				full = sqrt( fullR*fullR + fullI*fullI );
+				peak = Max( peak, full );
+				error = Max( error, (float)fabs( full - sqrt( trimR*trimR + trimI*trimI ) ) );
+				x = x + mSpacingX;
+			}
+			y = y + mSpacingY;
+		}
+		kept += support->GetTaps();
+		out << "filter " << a << "," << f << ": " << support->GetTaps() << " of " << taps;
+		out << " taps, " << 100.0 * support->GetEnergy() << "% of the energy, response error ";
+		out << ( ( peak > 0.0 ) ? error / peak : 0.0 ) << endl;
+	}
+	out << "trimmed filters: " << 100.0 * ( 1.0 - kept / ( (double)taps * mNumFilters ) );
+	out << "% fewer flops" << endl;
+}
+
+
+// int16 copies of the filters, each scaled so that its largest coefficient uses all bits
+void GaborJet::QuantizeFilters( int bits )
+{
+	int		k;
+	float	maxR, maxI;
+
+	mFixedReal = new FixedMatrix[mNumFilters];
+	mFixedImag = new FixedMatrix[mNumFilters];
+	mFixedScale = new float[mNumFilters];
+	for ( k = 0; k < mNumFilters; k++ )
+	{
+		float**	real = mBank[k]->GetRealPart();
+		float**	imag = mBank[k]->GetImaginaryPart();
+		maxR = MaxMagnitude( real, 0, 0, mSizeY, mSizeX );
+		maxI = MaxMagnitude( imag, 0, 0, mSizeY, mSizeX );
+		mFixedScale[k] = ( Max( maxR, maxI ) > 0.0 ) ? ( ( 1 << bits ) - 1 ) / Max( maxR, maxI ) : 1.0;
+		mFixedReal[k].Quantize( real, 0, 0, mSizeY, mSizeX, mFixedScale[k], mFixedLen );
+		mFixedImag[k].Quantize( imag, 0, 0, mSizeY, mSizeX, mFixedScale[k], mFixedLen );
+	}
+}
+
+
+// responses of all windows in 16 bit fixed point. The image is quantized once, each
+// filter is a run of pmaddwd over its rows, and the integer sums of a filter are 
+// scaled back before they are added up.
+void GaborJet::FilterInt16( void )
+{
+	int		rx, ry, x, y, k;
+	int		pixelBits, coefBits;
+	long long	fixedR, fixedI;
+	float	sumR, sumI, pixelScale, max;
+
+	mFixedLen = ( mSizeX + kFixedLanes - 1 ) / kFixedLanes * kFixedLanes;
+	FixedPointBits( mSizeY * mFixedLen, &pixelBits, &coefBits );
+	if ( mFixedReal == NULL ) QuantizeFilters( coefBits );
+
+// rows are padded so that the padded filter rows never read past them
+	max = MaxMagnitude( mPixels, 0, 0, mPaddedY, mPaddedX );
+	pixelScale = ( max > 0.0 ) ? ( ( 1 << pixelBits ) - 1 ) / max : 1.0;
+	mFixedImage.Quantize( mPixels, 0, 0, mPaddedY, mPaddedX, pixelScale, mPaddedX + mFixedLen );
+
+	y = 0;
+	for ( ry = 0; ry < mRespY; ry++ )
+	{
+		x = 0;
+		for ( rx = 0; rx < mRespX; rx++ )
+		{
+			sumR = sumI = 0.0;
+			for ( k = 0; k < mNumFilters; k++ )
+			{
+				DotFixed( mFixedImage.GetRow( y ) + x, mFixedImage.GetStride(), mFixedReal[k].GetRow( 0 ),
+						  mFixedImag[k].GetRow( 0 ), mSizeY, mFixedLen, &fixedR, &fixedI );
+				sumR += fixedR / ( pixelScale * mFixedScale[k] );
+				sumI += fixedI / ( pixelScale * mFixedScale[k] );
+			}
+			mResponses[ry][rx] = sqrt( sumR*sumR + sumI*sumI );
+			x = x + mSpacingX;
+		}
+		y = y + mSpacingY;
+	}
+}
+
+
+// a response map per filter, written to the tensor in the current layout. The 
+// response of a filter is that of its sums over all windows, as input for the NN.
+void GaborJet::FilterSeparate( void )
+{
+	int		rx, ry, x, y, gx, gy, i, j, h, k;
+	int		rowStride, colStride;
+	float	sumI, sumR, local_sumI, local_sumR, max, min, norm;
+	float*	map;
+	int		firstRow, lastRow, start, end;
+	FilterSupport*	support;
+
+	for ( h = 0; h < mNumFilters; h++ )
+	{
+		sumI = 0.0;
+		sumR = 0.0;
+		map = GetFilterMap( h, &rowStride, &colStride );
+	// the taps a trimmed filter kept, all of them otherwise
+		support = mBank[h]->GetSupport();
+		firstRow = ( support != NULL ) ? support->GetFirstRow() : 0;
+		lastRow = ( support != NULL ) ? support->GetLastRow() : mSizeY;
+
+		y = 0;
+		k = 0;
+		for ( ry = 0; ry < mRespY; ry++ )
+		{
+			x = 0;
+			for ( rx = 0; rx < mRespX; rx++ )
+			{
+			// windows left out by SetCells()
+				if ( mCells != NULL && ( k == mNumCells || mCells[k] != ry * mRespX + rx ) )
+				{
+					x = x + mSpacingX;
+					continue;
+				}
+				k++;
+				local_sumI = 0.0;
+				local_sumR = 0.0;
+				
+				for ( i = firstRow; i < lastRow; i++ )
+				{
+					start = ( support != NULL ) ? support->GetStart( i ) : 0;
+					end = ( support != NULL ) ? support->GetEnd( i ) : mSizeX;
+					for ( j = start; j < end; j++ )
+					{
+					// offset to image coordinates
+						gy = y + i;
+						gx = x + j;
+					// get real and imaginary products
+						sumR += mPixels[gy][gx] * mBank[h]->GetReal(i,j);
+						sumI += mPixels[gy][gx] * mBank[h]->GetImaginary(i,j);
+						local_sumR += mPixels[gy][gx] * mBank[h]->GetReal(i,j);
+						local_sumI += mPixels[gy][gx] * mBank[h]->GetImaginary(i,j);
+					}
+				}					
+			// collect responses
+				map[ry*rowStride+rx*colStride] = sqrt( local_sumR*local_sumR + local_sumI*local_sumI );
+				
+				x = x + mSpacingX;			
+			}	// rx
+			y = y + mSpacingY;
+		}	// ry
+
+		mNormals[h] = sqrt( sumR*sumR + sumI*sumI );
+	}	// h
+
 	max = min = mNormals[0];
-	for ( h = 0; h < mAngles*mFreqs; h++ )
+	for ( h = 0; h < mNumFilters; h++ )
 	{	
 		if( mNormals[h] > max ) max = mNormals[h];
 		if( mNormals[h] < min ) min = mNormals[h];
 	}
 	norm = max - min;
-	for ( h = 0; h < mAngles*mFreqs; h++ )
+	for ( h = 0; h < mNumFilters; h++ )
 		mNormals[h] = 1.0 * ( ( mNormals[h] - min ) / norm );
+}
 
-	*len = mAngles * mFreqs;
 
-#else
-	y = 0;
-	for ( ry = 0; ry < mRespY; ry++ )
+// process an image
+void GaborJet::Filter( float** image, int* len )
+{	
+	int			rx, ry;		// iterating over mResponses
+	int			x, y;		// iterating over location
+	int			gx, gy;		// iterating over filters
+	int			k;			// iterating over the filters in use
+	int			i, j;		// iterating over filter field
+	float		sumI, sumR;	// sum of imaginary and of real parts
+	
+	PROFILE_SCOPE( profile, kStageJet );
+	PROFILE_COUNT( profile, mHeight * mWidth, (long long)mNumCells * 
+				   ( ( mEngine == kEngineInt16 && mCells == NULL ) ? mNumFilters * mSizeY * mSizeX : mTaps ) );
+
+	mPixels = PadImage( image, 0 );
+
+// a map per filter, each normalized to a single response
+	if ( mLayout != kLayoutCombined )
 	{
-		x = 0;
-		for ( rx = 0; rx < mRespX; rx++ )
+		FilterSeparate();
+		*len = mNumFilters;
+		if ( saveFilter ) Save();
+		return;
+	}
+
+// only the windows of mCells, as a vector in their order, in floating point whatever
+// the engine
+	if ( mCells != NULL )
+	{
+		if ( mEngine == kEngineAuto && mSizeY == 8 && mSizeX == 8 ) FilterCells<8>( mCells, mNumCells );
+		else if ( mEngine == kEngineAuto && mSizeY == 16 && mSizeX == 16 ) FilterCells<16>( mCells, mNumCells );
+		else if ( mEngine == kEngineAuto && mSizeY == 32 && mSizeX == 32 ) FilterCells<32>( mCells, mNumCells );
+		else FilterCells<0>( mCells, mNumCells );
+		NormalizeCells( mCells, mNumCells, false );
+		*len = mNumCells;
+		if ( saveFilter ) Save();
+		return;
+	}
+
+// coarse to fine: the whole map, with the pruned windows marked
+	if ( mPruning > 0.0 )
+	{
+		FilterCoarse();
+		if ( mEngine == kEngineAuto && mSizeY == 8 && mSizeX == 8 ) FilterCells<8>( mRefined, mNumRefined );
+		else if ( mEngine == kEngineAuto && mSizeY == 16 && mSizeX == 16 ) FilterCells<16>( mRefined, mNumRefined );
+		else if ( mEngine == kEngineAuto && mSizeY == 32 && mSizeX == 32 ) FilterCells<32>( mRefined, mNumRefined );
+		else FilterCells<0>( mRefined, mNumRefined );
+		NormalizeCells( mRefined, mNumRefined, true );
+		*len = mRespY * mRespX;
+		if ( saveFilter ) Save();
+		return;
+	}
+
+// a kernel specialized for the filter size, if there is one
+	if ( mEngine == kEngineInt16 ) FilterInt16();
+	else if ( mTrim > 0.0 ) FilterTrimmed();
+	else if ( mTiling && mTile != NULL )
+	{
+		if ( mEngine == kEngineAuto && mSizeY == 8 && mSizeX == 8 ) FilterTiled<8>();
+		else if ( mEngine == kEngineAuto && mSizeY == 16 && mSizeX == 16 ) FilterTiled<16>();
+		else if ( mEngine == kEngineAuto && mSizeY == 32 && mSizeX == 32 ) FilterTiled<32>();
+		else FilterTiled<0>();
+	}
+	else if ( mEngine == kEngineAuto && mSizeY == 8 && mSizeX == 8 ) FilterFixed<8>();
+	else if ( mEngine == kEngineAuto && mSizeY == 16 && mSizeX == 16 ) FilterFixed<16>();
+	else if ( mEngine == kEngineAuto && mSizeY == 32 && mSizeX == 32 ) FilterFixed<32>();
+	else
+	{
+		y = 0;
+		for ( ry = 0; ry < mRespY; ry++ )
 		{
-		// start collecting responses
-			sumI = 0.0;
-			sumR = 0.0;
-			for ( a = 0; a < mAngles; a++ )
+			x = 0;
+			for ( rx = 0; rx < mRespX; rx++ )
 			{
-				for ( f = 0; f < mFreqs; f++ )
+			// start collecting responses
+				sumI = 0.0;
+				sumR = 0.0;
+				for ( k = 0; k < mNumFilters; k++ )
 				{
 					for ( gy = y; gy < y + mSizeY; gy++ )
 					{
 						for ( gx = x; gx < x + mSizeX; gx++ )
 						{
-						// make sure we are not out of bounds
-							if ( gx > mWidth || gy > mHeight ) break;
 						// offset to local coordinates of filter
 							i = gy - y;
 							j = gx - x;
 						// get real and imaginary products
-							sumR += mPixels[gy][gx] * mFilters[a][f].GetReal(i,j);
-							sumI += mPixels[gy][gx] * mFilters[a][f].GetImaginary(i,j);
+							sumR += mPixels[gy][gx] * mBank[k]->GetReal(i,j);
+							sumI += mPixels[gy][gx] * mBank[k]->GetImaginary(i,j);
 						}
 					}					
-				}	// f
-			}	// a
-			// collect responses
-			x = x + mSpacingX;
-			mResponses[ry][rx] = sqrt( sumR*sumR + sumI*sumI );
-		}	// rx
-		y = y + mSpacingY;
-	}	// ry
+				}	// k
+				// collect responses
+				x = x + mSpacingX;
+				mResponses[ry][rx] = sqrt( sumR*sumR + sumI*sumI );
+			}	// rx
+			y = y + mSpacingY;
+		}	// ry
+	}
 
-	h = 0;
 // normalize the responses
-	
-	float max, min;
-		
-	max = min = mResponses[0][0];
+	NormalizeMap( mTensor, mNormals );
+	*len = mRespX * mRespY;
+
+// save normals and responses to file
+	if ( saveFilter ) Save();
+}
+
+// see GaborJet.h. The rows and columns a window reads inside the map are those from its
+// top left pixel to its bottom right one, clipped to the map; pixels a border policy puts
+// past the edge repeat or mirror pixels within that range.
+int GaborJet::Refilter( float** image, bool* dirty, int tile, int* len )
+{
+	int		blocksX = ( mWidth + tile - 1 ) / tile;
+	int		ry, rx, by0, by1, bx0, bx1, by, bx, n = 0;
+	bool	touched;
+
+	if ( mDirtyCells == NULL )
+	{
+		PROFILE_BYTES( mRespY * mRespX * sizeof(int) );
+		mDirtyCells = new int[mRespY*mRespX];
+	}
+
+// the windows over a dirty block, in raster order
 	for ( ry = 0; ry < mRespY; ry++ )
+	{
+		by0 = Max( ry * mSpacingY - mPadY, 0 ) / tile;
+		by1 = ( Min( ry * mSpacingY - mPadY + mSizeY, mHeight ) - 1 ) / tile;
 		for ( rx = 0; rx < mRespX; rx++ )
 		{
-			if( mResponses[ry][rx] > max ) max = mResponses[ry][rx];
-			if( mResponses[ry][rx] < min ) min = mResponses[ry][rx];
+			bx0 = Max( rx * mSpacingX - mPadX, 0 ) / tile;
+			bx1 = ( Min( rx * mSpacingX - mPadX + mSizeX, mWidth ) - 1 ) / tile;
+			touched = false;
+			for ( by = by0; by <= by1 && !touched; by++ )
+				for ( bx = bx0; bx <= bx1 && !touched; bx++ ) touched = dirty[by*blocksX+bx];
+			if ( touched ) mDirtyCells[n++] = ry * mRespX + rx;
 		}
+	}
+
+	PROFILE_SCOPE( profile, kStageJet );
+	PROFILE_COUNT( profile, mHeight * mWidth, (long long)n * mTaps );
+
+	mPixels = PadImage( image, 0 );
+	if ( mEngine == kEngineAuto && mSizeY == 8 && mSizeX == 8 ) FilterCells<8>( mDirtyCells, n );
+	else if ( mEngine == kEngineAuto && mSizeY == 16 && mSizeX == 16 ) FilterCells<16>( mDirtyCells, n );
+	else if ( mEngine == kEngineAuto && mSizeY == 32 && mSizeX == 32 ) FilterCells<32>( mDirtyCells, n );
+	else FilterCells<0>( mDirtyCells, n );
+	NormalizeMap( mTensor, mNormals );
+	*len = mRespY * mRespX;
+	return n;
+}
+
+
+// scale the responses of the numCells windows at the map indices cells to [0,1], into
+// mNormals in their order, or if sparse at their place in the map with the others 
+// marked as pruned
+void GaborJet::NormalizeCells( int* cells, int numCells, bool sparse )
+{
+	float	max, min, norm;
+	int		k;
+
+	if ( sparse )
+		for ( k = 0; k < mRespY * mRespX; k++ ) mNormals[k] = kPrunedResponse;
+	if ( numCells == 0 ) return;
+	max = min = mTensor[cells[0]];
+	for ( k = 0; k < numCells; k++ )
+	{
+		if( mTensor[cells[k]] > max ) max = mTensor[cells[k]];
+		if( mTensor[cells[k]] < min ) min = mTensor[cells[k]];
+	}
 
 	norm = max - min;
-	h = 0;
+	for ( k = 0; k < numCells; k++ )
+		mNormals[sparse ? cells[k] : k] = 1.0 * ( ( mTensor[cells[k]] - min ) / norm );
+}
+
+
+// scale a combined response map to [0,1]
+void GaborJet::NormalizeMap( float* map, float* normals )
+{
+	float	max, min, norm;
+	int		h;
+	
+	max = min = map[0];
+	for ( h = 0; h < mRespY * mRespX; h++ )
+	{
+		if( map[h] > max ) max = map[h];
+		if( map[h] < min ) min = map[h];
+	}
+
+	norm = max - min;
+	for ( h = 0; h < mRespY * mRespX; h++ )
+		normals[h] = 1.0 * ( ( map[h] - min ) / norm );
+}
+
+
+// responses of all windows of the color channels, interleaved so that the three of 
+// them (and an idle fourth lane) are filtered at once
+void GaborJet::FilterPacked( float** images[] )
+{
+	int		rx, ry, x, y, k, c, i, j;
+	float	sumR[4], sumI[4];
+
+	if ( mPacked == NULL )
+	{
+		PROFILE_BYTES( mPaddedY * ( sizeof(float*) + 4 * mPaddedX * sizeof(float) ) );
+		mPacked = new float*[mPaddedY];
+		mPacked[0] = new float[4*mPaddedY*mPaddedX];
+		for ( i = 1; i < mPaddedY; i++ ) mPacked[i] = mPacked[0] + 4 * i * mPaddedX;
+	}
+	for ( i = 0; i < mPaddedY; i++ )
+		for ( j = 0; j < mPaddedX; j++ )
+		{
+			for ( c = 0; c < kColorChannels; c++ ) mPacked[i][4*j+c] = images[c][i][j];
+			mPacked[i][4*j+3] = 0.0;
+		}
+
+	y = 0;
 	for ( ry = 0; ry < mRespY; ry++ )
+	{
+		x = 0;
 		for ( rx = 0; rx < mRespX; rx++ )
 		{
-			mNormals[h] = 1.0 * ( ( mResponses[ry][rx] - min ) / norm );
-			h++;
+			for ( c = 0; c < 4; c++ ) sumR[c] = sumI[c] = 0.0;
+			for ( k = 0; k < mNumFilters; k++ )
+				CorrelatePacked( mPacked, y, x, mBank[k]->GetRealPart(), mBank[k]->GetImaginaryPart(),
+								 mSizeY, mSizeX, sumR, sumI );
+			for ( c = 0; c < kColorChannels; c++ )
+				mChannelMaps[(c*mRespY+ry)*mRespX+rx] = sqrt( sumR[c]*sumR[c] + sumI[c]*sumI[c] );
+			x = x + mSpacingX;
 		}
+		y = y + mSpacingY;
+	}
+}
 
-	*len = mRespX * mRespY;
 
-#endif
+// process the channels of a color image together
+void GaborJet::FilterChannels( float** images[], float* response, int* len )
+{
+	int		rx, ry, x, y, gx, gy, k, c, i, j, n;
+	float	sumR[kColorChannels], sumI[kColorChannels];
+	float	real, imag;
+	float**	padded[kColorChannels];
 
-// save normals and responses to file
-	if ( saveFilter ) Save();
-}
+// a map per filter, fixed point, trimmed filters, some of the windows and coarse to 
+// fine are done one channel at a time
+	if ( mLayout != kLayoutCombined || mEngine == kEngineInt16 || mTrim > 0.0 || mCells != NULL ||
+		 mPruning > 0.0 )
+	{
+		*len = 0;
+		for ( c = 0; c < kColorChannels; c++ )
+		{
+			Filter( images[c], &n );
+			for ( i = 0; i < n; i++ ) response[*len+i] = mNormals[i];
+			*len += n;
+		}
+		return;
+	}
 
-#if kAngleSeparation
+	PROFILE_SCOPE( profile, kStageJet );
+	PROFILE_COUNT( profile, kColorChannels * mHeight * mWidth, 
+				   (long long)kColorChannels * mNumFilters * mRespY * mRespX * mSizeY * mSizeX );
 
-// save gabor responses and normals to file
-void GaborJet::Save( void )
-{
-	PGMImage	pgmImage;
-	char		filename[256];
-	char		suffix[32];
-	ofstream	outfile;
-	
-	for ( int a = 0; a < mAngles; a++ )
-		for ( int f = 0; f < mFreqs; f++ )
+	if ( mChannelMaps == NULL )
+	{
+		PROFILE_BYTES( kColorChannels * mRespY * mRespX * sizeof(float) );
+		mChannelMaps = new float[kColorChannels*mRespY*mRespX];
+	}
+	for ( c = 0; c < kColorChannels; c++ ) padded[c] = PadImage( images[c], c );
+
+// every coefficient is loaded once for the three channels
+	if ( mEngine == kEngineAuto ) FilterPacked( padded );
+	else
+	{
+		y = 0;
+		for ( ry = 0; ry < mRespY; ry++ )
 		{
-			strcpy( filename, mFile );
-			sprintf( suffix, "-response-%d-%d.pgm", a, f );
-			strcat( filename, suffix );
-			pgmImage.WriteScaled( filename, mResponses[a][f], mRespY, mRespX );
+			x = 0;
+			for ( rx = 0; rx < mRespX; rx++ )
+			{
+				for ( c = 0; c < kColorChannels; c++ ) sumR[c] = sumI[c] = 0.0;
+				for ( k = 0; k < mNumFilters; k++ )
+					for ( gy = y; gy < y + mSizeY; gy++ )
+						for ( gx = x; gx < x + mSizeX; gx++ )
+						{
+							i = gy - y;
+							j = gx - x;
+							real = mBank[k]->GetReal(i,j);
+							imag = mBank[k]->GetImaginary(i,j);
+							for ( c = 0; c < kColorChannels; c++ )
+							{
+								sumR[c] += padded[c][gy][gx] * real;
+								sumI[c] += padded[c][gy][gx] * imag;
+							}
+						}
+				for ( c = 0; c < kColorChannels; c++ )
+					mChannelMaps[(c*mRespY+ry)*mRespX+rx] = sqrt( sumR[c]*sumR[c] + sumI[c]*sumI[c] );
+				x = x + mSpacingX;
+			}
+			y = y + mSpacingY;
 		}
+	}
+
+// each channel is scaled on its own, as when filtered alone
+	for ( c = 0; c < kColorChannels; c++ )
+		NormalizeMap( mChannelMaps + c * mRespY * mRespX, response + c * mRespY * mRespX );
+	*len = kColorChannels * mRespY * mRespX;
 }
 
-#else
 
+// save gabor responses to file, a map per filter unless they are combined
 void GaborJet::Save( void )
 {
 	PGMImage	pgmImage;
 	char		filename[256];
-	ofstream	outfile;
+	char		suffix[32];
+	float**		map;
+	float*		src;
+	int			rowStride, colStride;
 	
-	strcpy( filename, mFile );
-	strcat( filename, "-response.pgm" );
-	pgmImage.WriteScaled( filename, mResponses, mRespY, mRespX );
-}
+	if ( mLayout == kLayoutCombined )
+	{
+		strcpy( filename, mFile );
+		strcat( filename, "-response.pgm" );
+		pgmImage.WriteScaled( filename, mResponses, mRespY, mRespX );
+		return;
+	}
 
-#endif
+	map = CreateMatrix( (float)0.0, mRespY, mRespX );
+	for ( int k = 0; k < mNumFilters; k++ )
+	{
+		src = GetFilterMap( k, &rowStride, &colStride );
+		for ( int ry = 0; ry < mRespY; ry++ )
+			for ( int rx = 0; rx < mRespX; rx++ )
+				map[ry][rx] = src[ry*rowStride+rx*colStride];
+		strcpy( filename, mFile );
+		sprintf( suffix, "-response-%d-%d.pgm", mBankIndex[k] / mFreqs, mBankIndex[k] % mFreqs );
+		strcat( filename, suffix );
+		pgmImage.WriteScaled( filename, map, mRespY, mRespX );
+	}
+	DisposeMatrix( map, mRespY );
+}
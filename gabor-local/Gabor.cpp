@@ -4,417 +4,491 @@
 	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
 */
 
-#include <sys/types.h>
-#include <sys/stat.h>
 #include <stdlib.h>
+#include <sstream>
+#include <pthread.h>
 #include "GaborGlobal.h" // contains project-wide defines, constants, and globals
-#include "GaborJet.h"
-#include "ContrastFilter.h"
+#include "GaborConfig.h"
+#include "GaborContext.h"
+#include "GaborService.h"
+#include "FiducialManifest.h"
+#include "FrameStream.h"
+#include "Sweep.h"
+#include "ResultCache.h"
 #include "PGMImage.h"
+#include "Profiler.h"
+#include "WorkQueue.h"
 #include "Utilities.h"
 
-#define kUseContrast	1
-
-// GLOBAL GLOBALS
-bool		kSaveFilter = true;	// in case of multiple files, we save GFs only once
-bool		kVerbosity  = true; // whether to output any messages or not
-
-// LOCAL GLOBALS
-// These are the default settings for the Gabor filter jet
-int			gRadius = 32;			//	-r	: radius of filter
-float		gS = 10.0;				//	-s	: sigma modulator
-int			gA = 4;					//	-a	: number of angles
-int			gF = 2;					//	-f	: number of frequencies
-float		gL = 0.2;				//	-l	: lower bound of frequency
-float		gU = 1.0;				//	-u	: upper bound of frequency
+// GLOBAL
+// settings and fiducials from the command line, read-only once parsed
+GaborConfig	gConfig;
 int			gNumLocs = 0;			// number of fiducials
 int			**gLocations = NULL;	// coordinates of fiducials
-char		gLocationsFile[256];
+FiducialManifest	gManifest;		// images with fiducials of their own, with -m
+ResultCache		gCache;			// responses of images filtered before, with -H
+uint64_t		gParams;		// hash of the settings, under which the cache keys the images
+
+// a list of files shared by the batch worker threads
+struct Batch
+{
+	char**		files;		// file names
+	float**		responses;	// response vector per file
+	int*		lengths;	// response length per file
+	WorkQueue*	queue;		// indices of files still to be filtered
+};
+
+// answers service requests with a context of its own
+class RequestHandler : public ServiceHandler
+{
+public:
+
+	RequestHandler() : mContext( gConfig ) { mResponse = NULL; mCapacity = 0; }
+	~RequestHandler() { delete[] mResponse; }
+
+	float*	Serve( GaborRequest* request, int* len, int* status );
+
+protected:
+
+	GaborContext	mContext;	// filter bank and scratch buffers, kept warm
+	PGMImage		mImage;		// pixel storage, reused for images of the same size
+	float*			mResponse;	// response vector, reused between requests
+	int				mCapacity;	// allocated length of the response vector
+};
+
 
 // PROTOTYPES
-float*		ProcessFile( char* file, int*** rgb, int h, int w, float* response, int* respLen );
-float* 		ProcessChannel( float** image, int h, int w, float* response, int* len, char* file );
-bool 		ReadLocations( void );
+float*		FilterFile( GaborContext* context, PGMImage* image, char* file, int index, int* len );
+int**		FileLocations( int index, int* numLocs );
+void*		BatchWorker( void* batch );
+int			FilterStream( void );
+int			FilterSweep( char** files, int numFiles );
+ServiceHandler*	CreateHandler( void );
+bool 		ReadLocations( char* file );
+void		PrintResponse( char* file, float* response, int len, int** fiducials, int numLocs );
 void		Usage( void );
 
 
 // process command line arguments and filter selected files
 int main( int argc, char *argv[] )
 {
-	int		arg;
-	char	file[256];
-	bool	ok = false;
+	int				arg;
+	ostringstream	echo;
 	
-	cout << "# ";	
-	if ( argc > 1 )
+	arg = gConfig.ParseOptions( argc, argv, 1, &echo );
+	if ( arg < 0 ) Usage();
+	Profiler::Start( gConfig.profile, gConfig.traceFile, gConfig.perfCounters );
+
+// run as a service; fiducials come with the requests or from the -F file
+	if ( gConfig.servicePath[0] != '\0' )
 	{
-	// run down each argument
-		arg = 1;
-		while( arg < argc )
-		{
-		// check if -h is called
-			if( strcmp( argv[arg], "-h") == 0 )
-			{
-				arg++;
-				Usage();
-			}
-			if( strcmp( argv[arg], "-r") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				gRadius = atoi( argv[arg] );
-				cout << "gRadius" << " " << gRadius << endl;
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-s") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				gS = atof( argv[arg] );
-				cout << "gS" << " " << gS << endl;
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-a") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				gA = atoi( argv[arg] );
-				cout << "gA" << " " << gA << endl;
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-f") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				gF = atoi( argv[arg] );
-				cout << "gF" << " " << gF << endl;
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-l") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				gL = atof( argv[arg] );
-				cout << "gL" << " " << gL << endl;
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-u") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				gU = atof( argv[arg] );
-				cout << "gU" << " " << gU << endl;
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-F") == 0 )
-			{
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				strcpy( gLocationsFile, argv[arg] );
-				ok = true;
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-v") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				cout << argv[arg] << " ";
-				kVerbosity = (bool)atoi( argv[arg] );
-				goto loop;
-			}
-			if( strcmp( argv[arg], "-S") == 0 )
-			{
-				cout << argv[arg] << " ";
-				arg++;
-				if ( argv[arg] == NULL ) Usage();
-				cout << argv[arg] << " ";
-				kSaveFilter = (bool)atoi( argv[arg] );
-				goto loop;
-			}
-			if( argv[arg][0] != '-' ) break;
-loop:
-			arg++;
-		}
+		if ( gConfig.locationsFile[0] != '\0' && ! ReadLocations( gConfig.locationsFile ) ) return 0;
+		gConfig.saveFilter = false;
+		GaborService service( CreateHandler, gConfig.threads );
+		return service.Run( gConfig.servicePath );
 	}
-	cout << endl;
+
+// filter the frames of a stream as they come at the fiducials of the -F file
+	if ( gConfig.streamPath[0] != '\0' )
+	{
+		if ( gConfig.locationsFile[0] == '\0' ) Usage();
+		if ( ! ReadLocations( gConfig.locationsFile ) ) return 0;
+		gConfig.saveFilter = false;
+		return FilterStream();
+	}
+	cout << "# " << echo.str() << endl;
 	
+// the images of a manifest come with fiducials of their own
+	char**	files = argv + arg;
+	int		numFiles = argc - arg;
+	if ( gConfig.manifestFile[0] != '\0' )
+	{
+		if ( arg < argc ) Usage();
+		if ( ! gManifest.Read( gConfig.manifestFile ) ) return 0;
+		files = gManifest.GetImages();
+		numFiles = gManifest.GetNumImages();
+	}
+
 // better to pass some file to process!
-	if ( arg >= argc || ok == false )
+	else if ( arg >= argc || gConfig.locationsFile[0] == '\0' )
 	{
 		Usage();
 		return 0;
 	}
+	else if ( ! ReadLocations( gConfig.locationsFile ) ) return 0;
 
-	if ( ! ReadLocations() ) return 0;
+// filter every file with every parameter set of a sweep
+	if ( gConfig.sweepFile[0] != '\0' ) return FilterSweep( files, numFiles );
+
+// images filtered before with the same settings, by this process or another, come from the cache
+	if ( gConfig.cacheDir[0] != '\0' )
+	{
+		ostringstream	settings;
+		if ( ! gCache.Open( gConfig.cacheDir, gConfig.cacheMegabytes * 1048576LL ) ) return 0;
+		gConfig.Describe( settings );
+		gParams = HashString( settings.str().c_str() );
+	}
+
+// the fiducials are tracked through the files in order
+	if ( gConfig.track > 0 ) gConfig.threads = 1;
 	
-	for( int i = arg; i < argc; i++ )
+	if ( gConfig.threads == 1 )
+	{
+	// filter and print the files one by one
+		GaborContext	context( gConfig );
+		PGMImage		image;
+		for( int i = 0; i < numFiles; i++ )
+		{
+			int		len = 0;
+			float*	response = FilterFile( &context, &image, files[i], i, &len );
+			int**	fiducials = ( gConfig.track > 0 && len > 0 ) ? context.GetTrackedLocations() : NULL;
+
+		// write the filter response to console
+			PrintResponse( files[i], response, len, fiducials, context.GetNumLocations() );
+			
+		// clean up	
+			if ( response != NULL ) delete[] response;
+		}
+		if ( gConfig.verbosity && gCache.IsOpen() ) gCache.PrintStats( cerr );
+		return 0;
+	}
+
+// filter the files in parallel, each worker with its own context, then print them in order
+	Batch		batch;
+	pthread_t*	workers = new pthread_t[gConfig.threads];
+
+	batch.files = files;
+	batch.responses = new float*[numFiles];
+	batch.lengths = new int[numFiles];
+	batch.queue = new WorkQueue( numFiles );
+	for ( int i = 0; i < numFiles; i++ ) batch.queue->Push( i );
+	batch.queue->Close();
+
+// only the first file saves its filters, as when filtering one by one
+	for ( int t = 0; t < gConfig.threads; t++ ) pthread_create( &workers[t], NULL, BatchWorker, &batch );
+	for ( int t = 0; t < gConfig.threads; t++ ) pthread_join( workers[t], NULL );
+
+	for ( int i = 0; i < numFiles; i++ )
 	{
-	// copy argument to filename
-		strcpy( file, argv[i] );
-		if ( kVerbosity ) cerr << "Processing file \"" << argv[i] << "\"..." << endl;
-
-	// load the image (only PGM and PPM are supported)
-		int		 imgHeight, imgWidth;
-		int***	 image = NULL;		// allocated and freed by PGMImage
-		PGMImage pgmImage( file );	
-		imgHeight = pgmImage.GetHeight();
-		imgWidth  = pgmImage.GetWidth();
-		image 	  = pgmImage.GetRGBPixels();
-
-	// filter this image
-		float* response = NULL;
-		int	len = 0;
-		response = ProcessFile( file, image, imgHeight, imgWidth, response, &len );
-
-	// write the filter response to console	
-		cout << "# " << argv[i] << " " << len << endl;
-		for ( int j = 0; j < len; j++ ) cout << response[j] << " ";
-		cout << endl;
-		
-	// clean up	
-		if ( response != NULL ) delete[] response;
+		PrintResponse( batch.files[i], batch.responses[i], batch.lengths[i], NULL, 0 );
+		if ( batch.responses[i] != NULL ) delete[] batch.responses[i];
 	}
-		
+
+	delete batch.queue;
+	delete[] batch.lengths;
+	delete[] batch.responses;
+	delete[] workers;
+	if ( gConfig.verbosity && gCache.IsOpen() ) gCache.PrintStats( cerr );
 	return 0;
 }
 
 
-/* 
-pass the rgb pixel vector for filtering; the response is returned in the response vector. 
-This vector will be initialized by the Gabor API, but MUST disposed of it by the user.
-respLen is the address of an int holding the length of the response vector. 
-*/
-float* ProcessFile( char* file, int*** rgb, int h, int w, float* response, int* respLen )
+// load an image (only PGM and PPM are supported) into image, whose storage is reused
+// for images of the same size, and filter it with the given context at the fiducials
+// of the index-th file
+float* FilterFile( GaborContext* context, PGMImage* image, char* name, int index, int* len )
 {
-	char 	basename[256];
-	char	dirStr[256];
-	char*	fileStr;
-	int		i, j, len;
-	float	norm, max, min;
-
-// extract directory path from filename
-	strcpy( dirStr, file );
-	fileStr = strrchr( dirStr, '/' );
-	if ( fileStr != NULL )
+	int		numLocs;
+	int**	locations = FileLocations( index, &numLocs );
+
+	char			file[256];
+	float*			response = NULL;
+	ResultCacheKey	key;
+
+// copy argument to filename
+	*len = 0;
+	if ( strlen( name ) >= sizeof(file) )
 	{
-		strcpy( basename, fileStr );				// save part after last slash
-		dirStr[fileStr-dirStr+1] = '\0';				// save directory string
-		strcat( dirStr, basename );
-		strcat( dirStr, "-localGF" );
-		basename[strlen(basename)-4] = '\0';			// remove extension
-		for ( i = 0; i < strlen( basename ); i++ )		// remove intial slash
-			basename[i] = basename[i+1];
-		basename[i] = '\0';
+		cerr << "Error: file name longer than " << sizeof(file) - 1 << " characters: \"" << name << "\"" << endl;
+		return response;
 	}
-	else	// we are in working directory
+	strcpy( file, name );
+	if ( gConfig.verbosity ) cerr << "Processing file \"" << name << "\"..." << endl;
+
+	context->PrepareImage( image );
+	image->Read( file );	
+	if ( !context->Accepts( image ) )
 	{
-		strcpy( basename, file );
-		basename[strlen(basename)-4] = '\0';			// remove extension
-		strcpy( dirStr, basename );
-		strcat( dirStr, "-localGF" );
+		cerr << "Error: \"" << name << "\" is not a PGM or PPM image" << endl;
+		return response;
 	}
 
-// create img directory in extracted path
-	if ( kSaveFilter == 1 )
+// its responses from the cache if it was filtered before at the same fiducials
+	if ( gCache.IsOpen() )
 	{
-		mkdir( dirStr, S_IRWXU | S_IRWXG );
-		if ( kVerbosity ) cerr << "Created directory: \"" << dirStr << "\"" << endl;
-		strcat( dirStr, "/" );
+		uint64_t	params = gParams;
+		for ( int k = 0; k < numLocs; k++ ) params = HashBytes( locations[k], 2 * sizeof(int), params );
+		ResultCache::MakeKey( image, params, &key );
+		response = gCache.Lookup( key, len );
+		if ( response != NULL ) return response;
 	}
 
-// allocate pixels for rgb matrix
-	float** pixels = CreateMatrix( (float)255.0, h, w );
+// filter this image at its fiducials
+	context->SetLocations( locations, numLocs );
+	response = context->ProcessImage( file, image, response, len );
+	if ( gCache.IsOpen() ) gCache.Store( key, response, *len );
+	return response;
+}
+
 
-//  convert rgb info to grayscale
-	for ( i = 0; i < h; i++ )
+// fiducials of the index-th file: its own with a manifest, those of the -F file otherwise
+int** FileLocations( int index, int* numLocs )
+{
+	if ( gConfig.manifestFile[0] == '\0' )
 	{
-		for ( j = 0; j < w; j++ )
-		{
-			if (rgb[0][i][j] == 0) {
-				pixels[i][j] = 1;
-			} else {
-				pixels[i][j] = 0;
-			}
-//			pixels[i][j] = sqrt( (float)( rgb[0][i][j]*rgb[0][i][j] +
-//										  rgb[1][i][j]*rgb[1][i][j] + 
-//										  rgb[2][i][j]*rgb[2][i][j] ) ) / sqrt( 3.0 );
-			cout << pixels[i][j];
-		}
-		cout << endl;
+		*numLocs = gNumLocs;
+		return gLocations;
+	}
+	*numLocs = gManifest.GetNumLocations( index );
+	return gManifest.GetLocations( index );
+}
+
+
+// filter the files of a batch until none are left
+void* BatchWorker( void* arg )
+{
+	Batch*			batch = (Batch*)arg;
+	GaborContext	context( gConfig );
+	PGMImage		image;
+	int				i;
+
+	while ( batch->queue->Pop( &i ) )
+	{
+		if ( i != 0 ) context.SetFiltersSaved();
+		batch->responses[i] = FilterFile( &context, &image, batch->files[i], i, &batch->lengths[i] );
 	}
+	return NULL;
+}
 
-// process grayscale pixels, get gabor filter response length and allocate the return vector
-	len = 0;
-	strcpy( basename, dirStr );
 
+// write the response of a file to the console, followed by the positions of the 
+// fiducials if they were tracked
+void PrintResponse( char* file, float* response, int len, int** fiducials, int numLocs )
+{
+	PROFILE_SCOPE( profile, kStageOutput );
+	PROFILE_COUNT( profile, len, 0 );
+	cout << "# " << file << " " << len << endl;
+	for ( int j = 0; j < len; j++ ) cout << response[j] << " ";
 	cout << endl;
+	if ( fiducials == NULL ) return;
+	cout << "# fiducials " << numLocs << endl;
+	for ( int k = 0; k < numLocs; k++ ) cout << fiducials[k][0] << " " << fiducials[k][1] << " ";
 	cout << endl;
-	for ( i = 0; i < h; i++ )
+}
+
+
+// Filter every file with every parameter set of the -W sweep, one after the other. Each 
+// set has a context of its own, whose filter bank is kept from file to file. A file is
+// decoded once for all of them, and its maps are made once for each pipeline among the
+// sets (MapCache). Every response is keyed by the file and the index of its set.
+int FilterSweep( char** files, int numFiles )
+{
+	GaborContext**	contexts;
+	GaborConfig		config;
+	MapCache		cache;
+	PGMImage		image;
+	char**			sets;
+	char*			argv[64];
+	char			options[kMaxSweepLine];
+	char			file[256], key[300];
+	float*			response;
+	int**			locations;
+	int**			fiducials;
+	int				numSets, argc, len, numLocs, i, k;
+
+	if ( ! ReadSweep( gConfig.sweepFile, &sets, &numSets ) ) return 1;
+	contexts = new GaborContext*[numSets];
+	for ( k = 0; k < numSets; k++ )
 	{
-		for ( j = 0; j < w; j++ )
+		config = gConfig;
+		strcpy( options, sets[k] );
+		argc = SplitOptions( options, argv, 64 );
+		if ( config.ParseOptions( argc, argv, 0, NULL, false ) != argc )
 		{
-			cout << pixels[i][j];
+			cerr << "bad options in parameter set " << k << ": " << sets[k] << endl;
+			exit(1);
 		}
-		cout << endl;
+		config.saveFilter = false;
+		contexts[k] = new GaborContext( config );
+		contexts[k]->SetMapCache( &cache );
+		cout << "# set " << k << " " << sets[k] << endl;
 	}
-	response = ProcessChannel( pixels, h, w, response, &len, basename );
-	*respLen = len;
-
-// original float values scaled to [0,1]
-	if ( kVerbosity ) cerr << "scaling..." << endl;
-	max = min = response[0];
-	cerr << endl;
-	for ( i = 0; i < len; i++ )
+
+// decode straight to gray only if every set filters the same gray
+	for ( k = 1; k < numSets; k++ )
+		if ( contexts[k]->GetPipeline()->GetGrayConversion() != contexts[0]->GetPipeline()->GetGrayConversion() )
+			break;
+	image.SetGrayDecode( k == numSets, contexts[0]->GetPipeline()->GetGrayConversion() );
+
+	for ( i = 0; i < numFiles; i++ )
 	{
-		if( response[i] > max ) max = response[i];
-		if( response[i] < min ) min = response[i];
-	}
-	cerr << endl;
-	norm = max - min;
-	for ( i = 0; i < len; i++ ) {
-		response[i] = 1.0 * ( ( response[i] - min ) / norm );
-		cerr << response[i] << " ";
+		if ( strlen( files[i] ) >= sizeof(file) )
+		{
+			cerr << "Error: file name longer than " << sizeof(file) - 1 << " characters: \"" << files[i] << "\"" << endl;
+			continue;
+		}
+		strcpy( file, files[i] );
+		if ( gConfig.verbosity ) cerr << "Processing file \"" << file << "\"..." << endl;
+		image.Read( file );
+		cache.Clear();
+		locations = FileLocations( i, &numLocs );
+		for ( k = 0; k < numSets; k++ )
+		{
+			contexts[k]->SetLocations( locations, numLocs );
+			response = contexts[k]->ProcessImage( file, &image, NULL, &len );
+			if ( len == 0 ) cerr << "Error: \"" << file << "\" is not a PGM or PPM image" << endl;
+			fiducials = ( contexts[k]->GetConfig()->track > 0 && len > 0 ) ? contexts[k]->GetTrackedLocations() : NULL;
+			sprintf( key, "%s %d", files[i], k );
+			PrintResponse( key, response, len, fiducials, numLocs );
+			if ( response != NULL ) delete[] response;
+		}
 	}
-	
-// dispose of pixel storage	
-	if ( pixels != NULL ) DisposeMatrix( pixels, h );
-	
-	return response;
+	if ( gConfig.verbosity )
+		cerr << cache.GetNumStored() << " maps made, " << cache.GetNumFound() << " reused" << endl;
+
+	for ( k = 0; k < numSets; k++ ) delete contexts[k];
+	delete[] contexts;
+	DisposeSweep( sets, numSets );
+	return 0;
 }
 
 
-float* ProcessChannel( float** image, int h, int w, float* response, int* len, char* file )
+// filter the frames of the -V stream in the order they were decoded, with one context and
+// one response vector for all of them, and write their records to stdout. With -M the
+// responses of a frame are followed by the x and y of each fiducial as tracked.
+int FilterStream( void )
 {
-	ContrastFilter*	contrastFilter = NULL;
-	GaborJet*		gaborJet = NULL;
-	int				height = h;
-	int				width = w;
-	float** 		pixels;
-	int				gflen, dummy;
-	int				i, j, offset = 0;
-	char			filename[256], suffix[5];
-
-// copy pointer
-	pixels = image;
-
-#if kUseContrast
-// apply contrast filter to image
-	contrastFilter = new ContrastFilter( image, height, width );
-// set filename if intermediate files should be saved
-	if ( kSaveFilter == 1 )
-	{
-		contrastFilter->SetFileName( file );	
-		contrastFilter->Save();					// save contrast image
-	}
-	pixels = contrastFilter->GetContrast();		// get contrast map
-	width = contrastFilter->GetWidth();			// obtain contrast dimensions
-	height = contrastFilter->GetHeight();
-#endif
-
-// initialize gabor jet for the first fiducial point
-	gaborJet = new GaborJet;
-	if ( kSaveFilter == 1 )
+	GaborContext	context( gConfig );
+	FrameStream		stream( gConfig.streamQueue );
+	PGMImage*		image;
+	float*			response;
+	int**			fiducials;
+	int				len, slot;
+	char			file[256];
+
+	context.SetLocations( gLocations, gNumLocs );
+	response = new float[context.GetResponseLength() + 2 * gNumLocs];
+	for ( int i = 0; i < stream.GetNumImages(); i++ ) context.PrepareImage( stream.GetImage( i ) );
+	if ( ! stream.Start( gConfig.streamPath ) ) return 1;
+
+	strcpy( file, "frame.ppm" );	// only used to name saved files, which are off here
+	while ( stream.Next( &slot ) )
 	{
-		strcpy( filename, file );
-		sprintf( suffix, "%d-", 0 );
-		strcat( filename, suffix );
-		gaborJet->SetFileName( filename );
-	}
-	gaborJet->Initialize( height, width, gLocations[0][0], gLocations[0][1],
-						  gRadius, gS, gF, gU, gL, gA, kSaveFilter );
-	
-// filter image
-	// response vector is initialized here, but needs to be disposed by user
-	gaborJet->Filter( pixels, &gflen );
-	if ( *len == 0 ) 
-	{
-		*len = gflen * gNumLocs;
-		response = new float[(*len)]; // numLocs locations
-	}
-	for ( i = 0; i < *len; i++ ) response[i+offset] = gaborJet->GetResponse(i);
-	delete gaborJet;
-	
-// we already save the filters for the first fiducial, so turn it off for the others
-	kSaveFilter = 0;
-	
-// process the rest of the fiducial points
-	for ( i = 1; i < gNumLocs; i++ )
-	{
-		offset = offset + gflen;
-
-		gaborJet = new GaborJet;
-		if ( kSaveFilter == 1 )
+		image = stream.GetImage( slot );
+		context.ProcessImage( file, image, response, &len );
+		if ( gConfig.track > 0 && len > 0 )
 		{
-			strcpy( filename, file );
-			sprintf( suffix, "%d-", i );
-			strcat( filename, suffix );
-			gaborJet->SetFileName( filename );
+			fiducials = context.GetTrackedLocations();
+			for ( int k = 0; k < gNumLocs; k++, len += 2 )
+			{
+				response[len] = fiducials[k][0];
+				response[len+1] = fiducials[k][1];
+			}
 		}
-		gaborJet->Initialize( height, width, gLocations[i][0], gLocations[i][1], 
-							  gRadius, gS, gF, gU, gL, gA );
-		
-	// filter image
-		// response vector is initialized here, but needs to be disposed by user
-		gaborJet->Filter( pixels, &dummy );
-		for ( j = 0; j < gflen; j++ ) response[j+offset] = gaborJet->GetResponse(j);
-		delete gaborJet;
-	}	
-	
-#if kUseContrast
-	delete contrastFilter;
-#endif
+		if ( ! WriteFrame( 1, stream.GetFrame( slot ), stream.GetTimestamp( slot ), response, len ) )
+		{
+			cerr << "cannot write the record of frame " << stream.GetFrame( slot ) << endl;
+			exit(1);
+		}
+		stream.Release( slot );
+	}
 
-	return response;
+	if ( gConfig.verbosity ) 
+		cerr << stream.GetNumFrames() << " frames, " << stream.GetNumDropped() << " dropped" << endl;
+	delete[] response;
+	return 0;
+}
+
+
+ServiceHandler* CreateHandler( void )
+{
+	return new RequestHandler;
 }
 
 
 // read in patterns from file
-bool ReadLocations( void ) 
+bool ReadLocations( char* file ) 
 {
 	ifstream infile;
+	bool	 ok;
 	
 // open the file
-	infile.open( gLocationsFile );
+	infile.open( file );
 	if ( infile.fail() )
 	{		
-		FileOpenError( gLocationsFile );
+		FileOpenError( file );
 		return false;
 	}
+	ok = ReadLocations( infile, &gLocations, &gNumLocs );
+	
+// close and return
+	infile.close();
+	return ok;
+}
 
-// read the number of patterns
-	SkipComments( &infile );
-	infile >> gNumLocs;
 
-// create the storage matrix
-	gLocations = CreateMatrix( (int)0, gNumLocs, 2 );
+// answer one service request: apply its options on top of the startup settings,
+// load the fiducials and the image, and filter it
+float* RequestHandler::Serve( GaborRequest* request, int* len, int* status )
+{
+	GaborConfig	config = gConfig;
+	char*		argv[64];
+	char		file[256];
+	int			argc, need;
+	int**		locations = gLocations;
+	int			numLocs = gNumLocs;
+
+	argc = SplitOptions( request->options, argv, 64 );
+	if ( config.ParseOptions( argc, argv, 0, NULL, false ) != argc )
+	{
+		*status = kStatusBadOptions;
+		return NULL;
+	}
+	config.saveFilter = false;
+	config.track = 0;		// requests are filtered on their own
+	mContext.SetConfig( config );
 
-// read in the pattern values
-	for ( int i = 0; i < gNumLocs; i++ )
+// fiducials sent with the request replace those of the -F file for this request only
+	if ( request->fiducials[0] != '\0' )
 	{
-		for ( int j = 0; j < 2; j++ )
+		istringstream	stream( request->fiducials );
+		if ( ! ReadLocations( stream, &locations, &numLocs ) )
 		{
-			SkipComments( &infile );
-			infile >> gLocations[i][j];
-			cerr << gLocations[i][j] << " ";
+			*status = kStatusBadFiducials;
+			return NULL;
 		}
 	}
-	
-// close and return
-	infile.close();
-	return true;
+	mContext.SetLocations( locations, numLocs );
+	mContext.PrepareImage( &mImage );
+
+	if ( numLocs == 0 ) 
+		*status = kStatusBadFiducials;
+	else if ( ! LoadRequestImage( request, &mImage ) || ! mContext.Accepts( &mImage ) )
+		*status = kStatusBadImage;
+	else
+	{
+		need = mContext.GetResponseLength();
+		if ( need > mCapacity )
+		{
+			delete[] mResponse;
+			mResponse = new float[need];
+			mCapacity = need;
+		}
+		strcpy( file, "request.ppm" );	// only used to name saved files, which are off here
+		mContext.ProcessImage( file, &mImage, mResponse, len );
+		*status = kStatusOK;
+	}
+
+	mContext.SetLocations( NULL, 0 );
+	if ( locations != gLocations ) DisposeMatrix( locations, numLocs );
+	return ( *status == kStatusOK ) ? mResponse : NULL;
 }
 
 
 void Usage( void )
 {
     cerr << "Usage: gabor (-OPTIONS) -F <file> <image files>" << endl;
+    cerr << "       gabor (-OPTIONS) -m <manifest>" << endl;
     cerr << "    -h = display this help and exit" << endl;
     cerr << "    -r = radius of filter" << endl;
     cerr << "    -s = sigma modulator" << endl;
@@ -423,7 +497,39 @@ void Usage( void )
     cerr << "    -l = minimum frequency value" << endl;
     cerr << "    -u = maximum frequency value" << endl;
 	cerr << "    -F = text file with coordinates of fiducials" << endl;
+	cerr << "    -m = text file listing images, each followed by its fiducials, a file with them" << endl;
+	cerr << "         or nothing for the file next to it, e.g. face-fiducials.txt for face.ppm;" << endl;
+	cerr << "         not with -M" << endl;
     cerr << "    -v = turn on/off verbosity" << endl;
     cerr << "    -S = save intermediate files" << endl;    
+    cerr << "    -t = number of worker threads" << endl;
+    cerr << "    -E = convolution engine: auto (specialized kernels where they fit), generic" << endl;
+    cerr << "         or int16 (16 bit fixed point, faster but less precise)" << endl;
+    cerr << "    -B = pixels outside the image: skip, zero, clamp or reflect (default zero)" << endl;
+    cerr << "    -T = keep the filter taps holding this fraction of the energy, e.g. 0.999" << endl;
+    cerr << "         (default 0: all taps); -v 1 reports the savings and errors per filter" << endl;
+    cerr << "    -k = use only these filters, as angle/frequency index pairs, e.g. 0/0,3/1; each" << endl;
+    cerr << "         fiducial then outputs their responses only" << endl;
+    cerr << "    -c = stages to run, from decode,gray|luma,contrast,gabor" << endl;
+    cerr << "         (default decode,gray,contrast,gabor)" << endl;
+    cerr << "    -C = read options from a file, # starts a comment line" << endl;
+    cerr << "    -D = serve requests on a unix socket, or on stdin/stdout if \"-\"" << endl;
+    cerr << "    -V = filter back-to-back PGM/PPM frames from a FIFO, or from stdin if \"-\", as they" << endl;
+    cerr << "         come, at the fiducials of -F; a binary record per frame goes to stdout" << endl;
+    cerr << "    -Q = frames waiting to be filtered with -V before the oldest is dropped (default 2)" << endl;
+    cerr << "    -W = filter every image with each parameter set of a file: a line of options per" << endl;
+    cerr << "         set, e.g. -s 2 -l 0.5, where a value may list alternatives as 2|3|4; every" << endl;
+    cerr << "         image is decoded and preprocessed once for all sets" << endl;
+    cerr << "    -M = track the fiducials from image to image, or frame to frame with -V, starting" << endl;
+    cerr << "         at those of -F; a fiducial that is lost is searched for within this many" << endl;
+    cerr << "         pixels. Their positions follow the responses of each image. Not with -m," << endl;
+    cerr << "         whose images each have fiducials of their own." << endl;
+    cerr << "    -H = keep the responses in a directory, shared with other processes, and take" << endl;
+    cerr << "         those of images filtered before with the same settings from it; not with -M" << endl;
+    cerr << "    -N = megabytes the -H directory may hold before the least used are removed" << endl;
+    cerr << "         (default 256)" << endl;
+    cerr << "    -p = print time and counters per stage on exit" << endl;
+    cerr << "    -P = write a Chrome trace of the stages to a file on exit" << endl;
+    cerr << "    --perf-counters = also sample hardware counters (Linux) around decode, contrast and jet" << endl;
 	exit(0);
 }
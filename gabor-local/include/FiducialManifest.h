@@ -0,0 +1,71 @@
+/*
+	Description:	A manifest of images, each with fiducials of its own, so that a whole
+					dataset is filtered by one process. Every line names an image, followed
+					by either the x and y of each of its fiducials, the name of a file in
+					the format of -F, or nothing, in which case the fiducials are read from
+					the sidecar file next to the image, e.g. face-fiducials.txt for face.ppm.
+					# starts a comment, up to the end of the line. Names are relative to the
+					directory of the manifest and cannot hold blanks.
+					The manifest is read in one go and parsed in place. All fiducials end up
+					in one array, so a manifest of any size takes a handful of allocations.
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+/*
+	Example:
+
+		# image			fiducials
+		face.ppm		111 83  132 74  153 84
+		lena.ppm		lena-eyes.txt
+		other.ppm		# from other-fiducials.txt
+*/
+
+#ifndef __FIDUCIALMANIFEST__
+#define __FIDUCIALMANIFEST__
+
+#include "GaborGlobal.h"
+
+// suffix that replaces the extension of an image to name its sidecar file
+#define kSidecarSuffix	"-fiducials.txt"
+
+class FiducialManifest
+{
+public:
+
+	FiducialManifest();
+	~FiducialManifest();
+
+	// read the manifest at path, and the fiducial files it names; false, with a message,
+	// if any of them cannot be read or does not parse
+	bool	Read( char* path );
+
+	inline int		GetNumImages( void ) { return mNumImages; }
+	inline char**	GetImages( void ) { return mImages; }
+	// the fiducials of image i, as (x,y) pairs; they stay valid as long as the manifest
+	inline int**	GetLocations( int i ) { return mLocations + mFirst[i]; }
+	inline int		GetNumLocations( int i ) { return mFirst[i+1] - mFirst[i]; }
+
+protected:
+
+	void	Dispose( void );
+	bool	ReadFiducials( char* path );
+	void	AddLocation( int x, int y );
+	char*	ResolvePath( char* name, int len, char* out );
+
+	char*	mText;			// the manifest, parsed in place
+	char*	mNames;			// the image names, each after the directory of the manifest
+	char*	mNamesEnd;		// end of the names written so far
+	char*	mDir;			// directory of the manifest, with its slash; empty for the working one
+	char*	mFile;			// contents of the last fiducial file read
+	int		mFileCapacity;	// allocated bytes of mFile
+	char**	mImages;		// name of each image, in mNames
+	int*	mFirst;			// first fiducial of each image in mLocations, and one past the last
+	int*	mCoords;		// x and y of every fiducial of every image
+	int**	mLocations;		// a row of mCoords per fiducial
+	int		mNumImages;
+	int		mNumCoords;		// fiducials in mCoords
+	int		mCapacity;		// fiducials mCoords has room for
+};
+
+#endif
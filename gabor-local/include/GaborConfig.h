@@ -0,0 +1,55 @@
+/*
+	Description:	Settings for the fiducial Gabor jets and the processing around them
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#ifndef __GABORCONFIG__
+#define __GABORCONFIG__
+
+#include "GaborGlobal.h"
+using namespace std;
+
+class GaborConfig
+{
+public:
+
+	GaborConfig();
+
+	// parse options starting at argv[arg], echoing them to echo if not NULL.
+	// Returns the index of the first file argument, or -1 to show the usage.
+	// Options are read from a -C file only if files is set.
+	int		ParseOptions( int argc, char *argv[], int arg, ostream* echo, bool files = true );
+	// write every setting the responses depend on, to key the result cache (see ResultCache.h)
+	void	Describe( ostream& out );
+
+	int		radius;			//	-r	: radius of filter
+	float	sigma;			//	-s	: sigma modulator
+	int		angles;			//	-a	: number of angles
+	int		freqs;			//	-f	: number of frequencies
+	float	minFreq;		//	-l	: lower bound of frequency
+	float	maxFreq;		//	-u	: upper bound of frequency
+	char	pipeline[256];	//	-c	: stages to run, e.g. "decode,gray,contrast,gabor" (see Pipeline.h)
+	bool	verbosity;		//	-v	: whether to output any messages or not
+	bool	saveFilter;		//	-S	: save filters and intermediate images
+	int		threads;		//	-t	: number of worker threads
+	int		engine;			//	-E	: convolution engine, by name (see GaborKernels.h)
+	int		border;			//	-B	: pixels outside the image, by name (see GaborKernels.h)
+	float	trim;			//	-T	: keep the filter taps that hold this fraction of the energy, 0 for all
+	char	subset[256];	//	-k	: angle/frequency pairs of the filters to use, e.g. "0/0,3/1"; all if empty
+	char	locationsFile[256];	//	-F	: text file with coordinates of fiducials
+	char	manifestFile[256];	//	-m	: text file of images with fiducials of their own (see FiducialManifest.h)
+	char	servicePath[256];	//	-D	: socket to serve requests on, "-" for stdin/stdout
+	char	streamPath[256];	//	-V	: FIFO of back-to-back frames to filter as they come, "-" for stdin
+	int		streamQueue;	//	-Q	: decoded frames waiting to be filtered before the oldest is dropped
+	char	sweepFile[256];	//	-W	: file of parameter sets to filter every image with (see Sweep.h)
+	char	cacheDir[256];	//	-H	: directory of a result cache shared with other processes, empty for none
+	int		cacheMegabytes;	//	-N	: size cap of the result cache
+	int		track;			//	-M	: track the fiducials from image to image, searching this many pixels
+							//		  around one that is lost; 0 to filter at the -F locations
+	bool	profile;		//	-p	: print time and counters per stage on exit
+	char	traceFile[256];	//	-P	: write a Chrome trace of the stages on exit
+	bool	perfCounters;	//	--perf-counters	: sample hardware counters around the hot stages
+};
+
+#endif
@@ -0,0 +1,129 @@
+/*
+	Description:	Reentrant processing context. A context owns its settings, fiducials, 
+					filter bank and scratch buffers, so separate contexts can filter 
+					images in parallel.
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#ifndef __GABORCONTEXT__
+#define __GABORCONTEXT__
+
+#include "GaborGlobal.h"
+#include "GaborConfig.h"
+#include "GaborJet.h"
+#include "Arena.h"
+#include "Pipeline.h"
+#include "PGMImage.h"
+
+// With -M, a fiducial whose jet matches its jet on the previous image less than this,
+// once corrected for its displacement, is lost and searched for
+#define kTrackSimilarity	0.8
+// and it is filtered at most this many times to follow its displacement
+#define kTrackSteps			3
+
+class GaborContext
+{
+public:
+
+	GaborContext( GaborConfig& config );
+	~GaborContext();
+
+	// change settings; the filter bank is rebuilt only if it no longer fits
+	void				SetConfig( GaborConfig& config );
+	inline GaborConfig*	GetConfig( void ) { return &mConfig; }
+	// With -S only the first image a context filters saves its maps and filters. Mark
+	// them as saved already, e.g. by another worker of a batch.
+	inline void			SetFiltersSaved( void ) { mFiltersSaved = true; }
+
+	// fiducials to filter at, as numLocs (x,y) pairs. They are not copied and must 
+	// stay valid while the context uses them.
+	inline void		SetLocations( int** locations, int numLocs ) { mLocations = locations; mNumLocs = numLocs; }
+	inline int		GetNumLocations( void ) { return mNumLocs; }
+
+	// With -M the fiducials are tracked from image to image, starting from the locations
+	// given: see TrackFiducials(). Their positions on the last image, as numLocs (x,y) 
+	// pairs, or the locations given without -M.
+	inline int**	GetTrackedLocations( void ) { return ( mTracked != NULL ) ? mTracked : mLocations; }
+	// fiducials whose jets were filtered again on the last image because they moved, and
+	// those of them that were searched for because they were lost
+	inline int		GetNumMoved( void ) { return mNumMoved; }
+	inline int		GetNumSearched( void ) { return mNumSearched; }
+	// start tracking again from the locations given with the next image
+	void			ResetTracking( void );
+
+	// length of the response vector: one value per angle and frequency at each fiducial
+	inline int		GetResponseLength( void ) { return mNumSubset * mNumLocs; }
+
+	// Filter an image given as interleaved RGB values. If response is NULL, it is allocated 
+	// here and MUST be disposed of by the caller. Otherwise it must hold at least 
+	// GetResponseLength() floats and no allocation takes place for it.
+	float*	ProcessImageData( int* rgb, int h, int w, float* response, int* len );
+
+	// as above for rgb planes as read by PGMImage; saves intermediate files next to file
+	float*	ProcessFile( char* file, int*** rgb, int h, int w, float* response, int* len );
+
+	// as above for an image that PGMImage decoded straight to grayscale; gray is filtered
+	// in place and must stay valid until the call returns
+	float*	ProcessGray( char* file, float** gray, int h, int w, float* response, int* len );
+
+	// set image up to decode the next files the way the pipeline needs them: straight to
+	// grayscale unless the pipeline keeps color
+	void	PrepareImage( PGMImage* image );
+	// whether image, as read, has the pixels the pipeline needs
+	bool	Accepts( PGMImage* image );
+	// filter an image read by PGMImage with either of the calls above; len is 0 if the 
+	// image is not accepted
+	float*	ProcessImage( char* file, PGMImage* image, float* response, int* len );
+
+	// filter a grayscale image at each fiducial into response; returns its length
+	int		ProcessChannel( float** image, int h, int w, float* response, char* file );
+
+	// scratch memory in use, for reporting
+	inline Arena*	GetImageArena( void ) { return &mImageArena; }
+	inline Arena*	GetChannelArena( void ) { return &mChannelArena; }
+
+	// the stages in use; with a cache, the maps they make of an image are shared with
+	// the other contexts that use it (see MapCache)
+	inline Pipeline*	GetPipeline( void ) { return &mPipeline; }
+	inline void			SetMapCache( MapCache* cache ) { mPipeline.SetCache( cache ); }
+
+protected:
+
+	float*	ProcessPixels( float* response, int* len, char* dir );
+	void	AllocatePixels( int h, int w );
+	void	MakeOutputDir( char* file, char* dirStr );
+	int		TrackFiducials( float** image, int h, int w, float* response );
+	float	MatchJet( int i, float* dx, float* dy );
+	float	JetSimilarity( int i, float dx, float dy );
+	void	SearchJet( float** image, int h, int w, int i, int* x, int* y );
+	bool	AllocateTracking( int filters );
+
+	GaborConfig		mConfig;		// settings in use
+	bool			mFiltersSaved;	// the maps and filters of an image were saved with -S
+	Pipeline		mPipeline;		// stages of mConfig.pipeline, in grayscale
+	GaborJet*		mJet;			// filter bank kept warm between images
+	Arena			mImageArena;	// per-image buffers, reset for each image
+	Arena			mChannelArena;	// per-channel buffers, reset for each channel
+	int**			mLocations;		// coordinates of fiducials, not owned
+	int				mNumLocs;		// number of fiducials
+	float**			mPixels;		// grayscale matrix in mImageArena
+	int				mHeight;		// height of the grayscale matrix
+	int				mWidth;			// width of the grayscale matrix
+	int*			mSubset;		// filters of mConfig.subset, NULL for all
+	int				mNumSubset;		// filters in use
+	int**			mTracked;		// positions of the fiducials with -M, NULL before the first image
+	float**			mAmplitudes;	// their jets on the last image, a row of mNumSubset per fiducial
+	float**			mPhases;		// and the phases of those
+	float**			mWaves;			// kx, ky and frequency of each filter in use (see GaborJet.h)
+	int				mNumTracked;	// fiducials in mTracked
+	int				mTrackFilters;	// filters per row of mAmplitudes and mPhases
+	int				mNumMoved;		// fiducials filtered again on the last image
+	int				mNumSearched;	// and searched for
+};
+
+// read the number of fiducials and their coordinates, in the format of the -F file.
+// The matrix is allocated here and must be disposed of with DisposeMatrix().
+bool	ReadLocations( istream& infile, int*** locations, int* numLocs );
+
+#endif
@@ -10,6 +10,7 @@
 
 #include "GaborGlobal.h"
 #include "PGMImage.h"
+#include "GaborKernels.h"
 
 class GaborFilter
 {
@@ -23,9 +24,20 @@ public:
 
 	inline float 	GetReal( int x, int y ) { return mReal[x][y]; }
 	inline float 	GetImaginary( int x, int y ) { return mImaginary[x][y]; }
+	inline float**	GetRealPart( void ) { return mReal; }
+	inline float**	GetImaginaryPart( void ) { return mImaginary; }
+	inline float	GetAngle( void ) { return mAngle; }
+	inline float	GetFrequency( void ) { return mFrequency; }	// in radians per pixel
+
+	// keep only the taps that hold fraction of the energy, see FilterSupport
+	void			Trim( float fraction );
+	// the taps kept, NULL if the filter was not trimmed
+	inline FilterSupport*	GetSupport( void ) { return mSupport; }
 	
 protected:
 
+	void		Dispose( void );
+
 	int			mXYO;			// origin
 	int			mRadius;		// radius of filter
 	float		mSigma;			// curve of gaussian (sually set to PI)
@@ -34,6 +46,7 @@ protected:
 	float		mFrequency;		// wavelengths of filter (omega)
 	float**		mReal;			// real part of filter
 	float**		mImaginary;		// imaginary part of filter
+	FilterSupport*	mSupport;	// taps kept by Trim(), or NULL
 };
 
 #endif
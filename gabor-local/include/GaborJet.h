@@ -11,6 +11,7 @@ Change History (most recent first):
 
 #include "GaborGlobal.h"
 #include "GaborFilter.h"
+#include "GaborKernels.h"
 
 
 class GaborJet
@@ -22,13 +23,54 @@ public:
 	
 	void	Initialize( int y, int x, int x0, int y0, int r, float s = 2.0, int f = 2, 
 						float maxF = 2, float minF = 1, int a = 8, bool save = false );
+	bool	Matches( int y, int x, int r, float s, int f, float maxF, float minF, int a );
 	void	Filter( float** image, int* len );
 	float	GetResponse( int idx ) { return mFiducials[idx]; }
 
 	inline void		SetFileName( char* file ) { strcpy( mFile, file ); }
+	inline void		SetLocation( int x0, int y0 ) { mX = x0; mY = y0; }
+	inline void		SetEngine( int engine ) { mEngine = engine; }
+	// pixels outside the image for fiducials near its edge; kBorderSkip gives such a 
+	// fiducial 0 responses
+	inline void		SetBorder( int border ) { mBorder = border; }
+	// keep only the taps of each filter that hold fraction of its energy, or all of them
+	// if 0; takes effect with the next Initialize(). The int16 engine uses all taps.
+	inline void		SetTrim( float fraction ) { mTrim = fraction; }
+	inline float	GetTrim( void ) { return mTrim; }
+	// print the taps each trimmed filter keeps, and how far its responses at the numLocs
+	// (x,y) fiducials of image are from those of the whole filter
+	void			ReportTrim( float** image, int** locations, int numLocs, ostream& out );
+	// build and run only the numFilters filters of the bank at the indices a * freqs + f
+	// of filters, in increasing order as given by ParseSubset(), or all of them if filters
+	// is NULL; takes effect with the next Initialize(). The responses are then those of 
+	// these filters, in this order.
+	void			SetSubset( int* filters, int numFilters );
+	// whether the filters in use are those SetSubset() would give
+	bool			MatchesSubset( int* filters, int numFilters );
+	inline int		GetNumFilters( void ) { return mNumFilters; }
+	// keep the phase of each response as well, atan2 of its real and imaginary sums, 
+	// from the next Filter() on
+	void			SetPhases( bool phases );
+	inline float	GetPhase( int idx ) { return mPhases[idx]; }
+	// the wave vector of the idx-th filter in use, in radians per pixel along the columns
+	// (x) and the rows (y) of the image. A pattern that moves by (dx, dy) changes the 
+	// phase of the response at a fixed point by about kx * dx + ky * dy.
+	void			GetWaveVector( int idx, float* kx, float* ky );
 	
 protected:
 
+	void	Dispose( void );
+	template <int S>
+	void	FilterFixed( float** image, int y, int x );
+	void	QuantizeFilters( int bits );
+	void	FilterInt16( float** image, int y, int x );
+	void	FilterTrimmed( float** image, int y, int x );
+	inline void	SetResponse( int k, float sumR, float sumI )
+		{ 
+			mFiducials[k] = sqrt( sumR*sumR + sumI*sumI );
+			if ( mPhases != NULL ) mPhases[k] = atan2( sumR, sumI );
+		}
+
 	bool			mShowFilter;// indicates whether to save images of used filters
 	int				mHeight;	// vertical size of image
 	int				mWidth;		// horizontal size of image
@@ -40,9 +82,24 @@ protected:
 	int				mRadius;	// radius of filter
 	float			mMinFreq;	// minimum frequency
 	float			mMaxFreq;	// maximum frequency
-	GaborFilter**	mFilters;	// set of filters in use
+	GaborFilter**	mFilters;	// the bank, [angle][freq]; only the filters in use are built
+	int*			mSubset;	// indices of the filters to build, NULL for all of them
+	int				mNumSubset;
+	GaborFilter**	mBank;		// the filters in use, in the order of their responses
+	int*			mBankIndex;	// index a * freqs + f of each filter in use
+	int				mNumFilters;	// filters in use
 	float*			mFiducials;	// vector with Gabor responses at center
+	float*			mPhases;	// phases of those responses, NULL unless SetPhases()
 	char			mFile[256];	// filename
+	int				mEngine;	// convolution engine
+	FixedMatrix		mFixedImage;	// quantized pixels, for the int16 engine
+	FixedMatrix*	mFixedReal;	// quantized filters, NULL until the int16 engine runs
+	FixedMatrix*	mFixedImag;
+	float*			mFixedScale;	// per filter, fixed = float * scale
+	int				mFixedLen;	// padded row length of the quantized filters
+	int				mBorder;	// border policy
+	float			mTrim;		// energy fraction of the trimmed filters, 0 if they are whole
+	float**			mWindow;	// the window of a fiducial near the edge, NULL until needed
 };
 
 #endif
@@ -0,0 +1,277 @@
+/*
+	Description:	A manifest of images with fiducials of their own
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "FiducialManifest.h"
+#include "Utilities.h"
+
+
+inline bool IsBlank( char c )
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+
+// Read the file at path into buffer, which is grown to hold it and a terminating 0 if
+// it holds capacity bytes. Returns its length, or -1 if it cannot be read.
+static long ReadText( char* path, char** buffer, int* capacity )
+{
+	FILE*	file = fopen( path, "rb" );
+	long	len;
+
+	if ( file == NULL ) return -1;
+	fseek( file, 0, SEEK_END );
+	len = ftell( file );
+	fseek( file, 0, SEEK_SET );
+	if ( len < 0 || len + 1 > *capacity )
+	{
+		delete[] *buffer;
+		*capacity = ( len < 0 ) ? 0 : len + 1;
+		*buffer = new char[*capacity];
+	}
+	if ( len < 0 || fread( *buffer, 1, len, file ) != (size_t)len ) len = -1;
+	else (*buffer)[len] = '\0';
+	fclose( file );
+	return len;
+}
+
+
+// the next int in text, skipping blanks and comments from # to the end of the line
+static bool NextInt( char** text, int* value )
+{
+	char*	end;
+
+	for ( ;; )
+	{
+		while ( IsBlank( **text ) ) (*text)++;
+		if ( **text != '#' ) break;
+		while ( **text != '\0' && **text != '\n' ) (*text)++;
+	}
+	*value = (int)strtol( *text, &end, 10 );
+	if ( end == *text ) return false;
+	*text = end;
+	return true;
+}
+
+
+FiducialManifest::FiducialManifest()
+{
+	mText = NULL;
+	mNames = NULL;
+	mNamesEnd = NULL;
+	mDir = NULL;
+	mFile = NULL;
+	mFileCapacity = 0;
+	mImages = NULL;
+	mFirst = NULL;
+	mCoords = NULL;
+	mLocations = NULL;
+	mNumImages = 0;
+	mNumCoords = 0;
+	mCapacity = 0;
+}
+
+
+FiducialManifest::~FiducialManifest()
+{
+	Dispose();
+}
+
+
+void FiducialManifest::Dispose( void )
+{
+	delete[] mText;
+	delete[] mNames;
+	delete[] mDir;
+	delete[] mFile;
+	delete[] mImages;
+	delete[] mFirst;
+	delete[] mCoords;
+	delete[] mLocations;
+	mText = NULL;
+	mNames = NULL;
+	mNamesEnd = NULL;
+	mDir = NULL;
+	mFile = NULL;
+	mFileCapacity = 0;
+	mImages = NULL;
+	mFirst = NULL;
+	mCoords = NULL;
+	mLocations = NULL;
+	mNumImages = 0;
+	mNumCoords = 0;
+	mCapacity = 0;
+}
+
+
+// append a fiducial, doubling the room for them when it runs out
+void FiducialManifest::AddLocation( int x, int y )
+{
+	int*	coords;
+
+	if ( mNumCoords == mCapacity )
+	{
+		mCapacity = ( mCapacity == 0 ) ? 256 : 2 * mCapacity;
+		coords = new int[2*mCapacity];
+		if ( mNumCoords > 0 ) memcpy( coords, mCoords, 2 * mNumCoords * sizeof(int) );
+		delete[] mCoords;
+		mCoords = coords;
+	}
+	mCoords[2*mNumCoords] = x;
+	mCoords[2*mNumCoords+1] = y;
+	mNumCoords++;
+}
+
+
+// write the len characters of name to out, after the directory of the manifest unless
+// name is absolute; returns out
+char* FiducialManifest::ResolvePath( char* name, int len, char* out )
+{
+	int		dirLen = ( name[0] == '/' ) ? 0 : strlen( mDir );
+
+	memcpy( out, mDir, dirLen );
+	memcpy( out + dirLen, name, len );
+	out[dirLen+len] = '\0';
+	return out;
+}
+
+
+// add the fiducials of a file in the format of -F: their number, then x and y of each
+bool FiducialManifest::ReadFiducials( char* path )
+{
+	char*	p;
+	int		n, x, y;
+
+	if ( ReadText( path, &mFile, &mFileCapacity ) < 0 )
+	{
+		FileOpenError( path );
+		return false;
+	}
+	p = mFile;
+	if ( !NextInt( &p, &n ) || n <= 0 )
+	{
+		cerr << "no fiducials in \"" << path << "\"" << endl;
+		return false;
+	}
+	for ( int i = 0; i < n; i++ )
+	{
+		if ( !NextInt( &p, &x ) || !NextInt( &p, &y ) )
+		{
+			cerr << "\"" << path << "\" holds fewer than " << n << " fiducials" << endl;
+			return false;
+		}
+		AddLocation( x, y );
+	}
+	return true;
+}
+
+
+// see FiducialManifest.h
+bool FiducialManifest::Read( char* path )
+{
+	char	other[FILENAME_MAX];
+	char*	p;
+	char*	end;
+	char*	name;
+	char*	slash;
+	char*	dot;
+	long	len;
+	int		capacity = 0, lines = 1, line, nameLen, x, y;
+	bool	paired;
+
+	Dispose();
+	len = ReadText( path, &mText, &capacity );
+	if ( len < 0 )
+	{
+		FileOpenError( path );
+		return false;
+	}
+
+// the directory of the manifest, which names are relative to
+	slash = strrchr( path, '/' );
+	nameLen = ( slash == NULL ) ? 0 : slash - path + 1;
+	mDir = new char[nameLen+1];
+	memcpy( mDir, path, nameLen );
+	mDir[nameLen] = '\0';
+
+// room for an image on every line
+	for ( p = mText; *p != '\0'; p++ ) if ( *p == '\n' ) lines++;
+	mImages = new char*[lines];
+	mFirst = new int[lines+1];
+	mNames = new char[len+lines*(nameLen+1)+1];
+	mNamesEnd = mNames;
+
+	p = mText;
+	for ( line = 1; p != NULL; line++ )
+	{
+	// cut the line, and its comment, off the rest
+		end = strchr( p, '\n' );
+		if ( end != NULL ) *end++ = '\0';
+		if ( ( name = strchr( p, '#' ) ) != NULL ) *name = '\0';
+		while ( IsBlank( *p ) ) p++;
+		if ( *p == '\0' )
+		{
+			p = end;
+			continue;
+		}
+
+	// the image
+		for ( name = p; *p != '\0' && !IsBlank( *p ); p++ ) ;
+		if ( nameLen + ( p - name ) + strlen( kSidecarSuffix ) >= FILENAME_MAX )
+		{
+			cerr << path << ", line " << line << ": name too long" << endl;
+			return false;
+		}
+		mImages[mNumImages] = ResolvePath( name, p - name, mNamesEnd );
+		mNamesEnd += strlen( mNamesEnd ) + 1;
+		mFirst[mNumImages] = mNumCoords;
+		while ( IsBlank( *p ) ) p++;
+
+	// and its fiducials, from the sidecar file, the file named or the line itself
+		if ( *p == '\0' )
+		{
+			strcpy( other, mImages[mNumImages] );
+			slash = strrchr( other, '/' );
+			dot = strrchr( other, '.' );
+			if ( dot != NULL && ( slash == NULL || dot > slash ) ) *dot = '\0';
+			strcat( other, kSidecarSuffix );
+			if ( !ReadFiducials( other ) ) return false;
+		}
+		else if ( ( *p >= '0' && *p <= '9' ) || *p == '-' || *p == '+' )
+		{
+			paired = true;
+			while ( paired && NextInt( &p, &x ) )
+			{
+				paired = NextInt( &p, &y );
+				if ( paired ) AddLocation( x, y );
+			}
+			if ( !paired || *p != '\0' )
+			{
+				cerr << path << ", line " << line << ": expected x and y of each fiducial" << endl;
+				return false;
+			}
+		}
+		else
+		{
+			for ( name = p; *p != '\0' && !IsBlank( *p ); p++ ) ;
+			if ( nameLen + ( p - name ) >= FILENAME_MAX )
+			{
+				cerr << path << ", line " << line << ": name too long" << endl;
+				return false;
+			}
+			if ( !ReadFiducials( ResolvePath( name, p - name, other ) ) ) return false;
+		}
+		mNumImages++;
+		p = end;
+	}
+	mFirst[mNumImages] = mNumCoords;
+
+// a row per fiducial
+	mLocations = new int*[mNumCoords+1];
+	for ( int i = 0; i < mNumCoords; i++ ) mLocations[i] = mCoords + 2 * i;
+	return true;
+}
@@ -0,0 +1,304 @@
+/*
+	Description:	Settings for the fiducial Gabor jets and the processing around them
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include <stdlib.h>
+#include <sstream>
+#include "GaborConfig.h"
+#include "GaborKernels.h"
+#include "FrameStream.h"
+#include "Pipeline.h"
+#include "ResultCache.h"
+#include "Utilities.h"
+
+// default settings for the Gabor filter jet
+GaborConfig::GaborConfig()
+{
+	radius		= 32;
+	sigma		= 10.0;
+	angles		= 4;
+	freqs		= 2;
+	minFreq		= 0.2;
+	maxFreq		= 1.0;
+	verbosity	= true;
+	saveFilter	= true;
+	threads		= 1;
+	engine		= kEngineAuto;
+	border		= kBorderZero;
+	trim		= 0.0;
+	subset[0]	= '\0';
+	strcpy( pipeline, "decode,gray,contrast,gabor" );
+	locationsFile[0] = '\0';
+	manifestFile[0] = '\0';
+	servicePath[0] = '\0';
+	streamPath[0] = '\0';
+	streamQueue	= kStreamQueue;
+	sweepFile[0] = '\0';
+	cacheDir[0] = '\0';
+	cacheMegabytes = kCacheMegabytes;
+	track		= 0;
+	profile		= false;
+	traceFile[0] = '\0';
+	perfCounters = false;
+}
+
+
+// process command line arguments
+int GaborConfig::ParseOptions( int argc, char *argv[], int arg, ostream* echo, bool files )
+{
+	ostringstream	ignore;
+	ostream&		out = ( echo != NULL ) ? *echo : ignore;
+
+// run down each argument
+	while( arg < argc )
+	{
+	// check if -h is called
+		if( strcmp( argv[arg], "-h") == 0 ) return -1;
+		if( strcmp( argv[arg], "-r") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			radius = atoi( argv[arg] );
+			if ( radius < 1 ) return -1;
+			out << "gRadius" << " " << radius << endl;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-s") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			sigma = atof( argv[arg] );
+			out << "gS" << " " << sigma << endl;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-a") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			angles = atoi( argv[arg] );
+			if ( angles < 1 ) return -1;
+			out << "gA" << " " << angles << endl;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-f") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			freqs = atoi( argv[arg] );
+			if ( freqs < 1 ) return -1;
+			out << "gF" << " " << freqs << endl;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-l") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			minFreq = atof( argv[arg] );
+			out << "gL" << " " << minFreq << endl;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-u") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			maxFreq = atof( argv[arg] );
+			out << "gU" << " " << maxFreq << endl;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-F") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			if ( !CopyOption( locationsFile, sizeof(locationsFile), argv[arg-1], argv[arg] ) ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-m") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			if ( !CopyOption( manifestFile, sizeof(manifestFile), argv[arg-1], argv[arg] ) ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-v") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			out << argv[arg] << " ";
+			verbosity = (bool)atoi( argv[arg] );
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-S") == 0 )
+		{
+			out << argv[arg] << " ";
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			out << argv[arg] << " ";
+			saveFilter = (bool)atoi( argv[arg] );
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-t") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			threads = Max( atoi( argv[arg] ), 1 );
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-E") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			engine = FindEngine( argv[arg] );
+			if ( engine < 0 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-B") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			border = FindBorder( argv[arg] );
+			if ( border < 0 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-T") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			trim = atof( argv[arg] );
+			if ( trim < 0.0 || trim > 1.0 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-k") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			if ( !CopyOption( subset, sizeof(subset), argv[arg-1], argv[arg] ) ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-c") == 0 )
+		{
+			Pipeline	test;
+			arg++;
+			if ( argv[arg] == NULL || !test.Parse( argv[arg] ) ) return -1;
+		// fiducials are given in image coordinates, which only a grayscale map keeps
+			if ( test.IsColor() || test.Has( kPipeLogPolar ) ) return -1;
+			if ( !CopyOption( pipeline, sizeof(pipeline), argv[arg-1], argv[arg] ) ) return -1;
+			out << "gPipeline" << " " << pipeline << endl;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-C") == 0 )
+		{
+			char	text[4096];
+			char*	options[256];
+			int		num;
+			arg++;
+			if ( argv[arg] == NULL || !files ) return -1;
+		// the options of the file, which may not name files themselves
+			num = ReadOptionFile( argv[arg], text, sizeof(text), options, 256 );
+			if ( num < 0 || ParseOptions( num, options, 0, echo, false ) != num ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-D") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			if ( !CopyOption( servicePath, sizeof(servicePath), argv[arg-1], argv[arg] ) ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-V") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			if ( !CopyOption( streamPath, sizeof(streamPath), argv[arg-1], argv[arg] ) ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-Q") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			streamQueue = atoi( argv[arg] );
+			if ( streamQueue < 1 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-M") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			track = atoi( argv[arg] );
+			if ( track < 0 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-W") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			if ( !CopyOption( sweepFile, sizeof(sweepFile), argv[arg-1], argv[arg] ) ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-H") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			if ( !CopyOption( cacheDir, sizeof(cacheDir), argv[arg-1], argv[arg] ) ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-N") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			cacheMegabytes = atoi( argv[arg] );
+			if ( cacheMegabytes < 1 ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-p") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			profile = (bool)atoi( argv[arg] );
+			goto loop;
+		}
+		if( strcmp( argv[arg], "-P") == 0 )
+		{
+			arg++;
+			if ( argv[arg] == NULL ) return -1;
+			if ( !CopyOption( traceFile, sizeof(traceFile), argv[arg-1], argv[arg] ) ) return -1;
+			goto loop;
+		}
+		if( strcmp( argv[arg], "--perf-counters") == 0 )
+		{
+			perfCounters = true;
+			goto loop;
+		}
+		if( argv[arg][0] != '-' ) break;
+loop:
+		arg++;
+	}
+// the filters of -k must be in the bank of -a and -f
+	if ( ParseSubset( subset, angles, freqs, NULL ) < 0 ) return -1;
+// the result cache knows nothing of the fiducials tracked from image to image
+	if ( cacheDir[0] != '\0' && track > 0 ) return -1;
+// tracking starts from one set of fiducials, not one per image as in a manifest
+	if ( manifestFile[0] != '\0' && track > 0 ) return -1;
+	return arg;
+}
+
+
+// the settings as text, with enough digits that different values never read the same;
+// verbosity, threads and the like leave the responses as they are
+void GaborConfig::Describe( ostream& out )
+{
+	streamsize	precision = out.precision( 9 );
+
+	out << "local " << radius << " " << sigma << " " << angles << " " << freqs << " "
+		<< minFreq << " " << maxFreq << " " << pipeline << " " << engine << " " << border << " "
+		<< trim << " " << subset;
+	out.precision( precision );
+}
@@ -0,0 +1,537 @@
+/*
+	Description:	Reentrant processing context
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <math.h>
+#include "GaborContext.h"
+#include "Utilities.h"
+
+GaborContext::GaborContext( GaborConfig& config )
+{
+	mSubset = NULL;
+	SetConfig( config );
+	mJet = NULL;
+	mLocations = NULL;
+	mNumLocs = 0;
+	mPixels = NULL;
+	mHeight = 0;
+	mWidth = 0;
+	mTracked = NULL;
+	mAmplitudes = NULL;
+	mPhases = NULL;
+	mWaves = NULL;
+	mNumTracked = 0;
+	mTrackFilters = 0;
+	mNumMoved = 0;
+	mNumSearched = 0;
+}
+
+
+GaborContext::~GaborContext()
+{
+	delete mJet;
+	if ( mSubset != NULL ) delete[] mSubset;
+	ResetTracking();
+}
+
+
+// take new settings, setting up the pipeline stages if they changed
+void GaborContext::SetConfig( GaborConfig& config )
+{
+	mConfig = config;
+	mFiltersSaved = false;
+	mPipeline.Parse( mConfig.pipeline );
+
+// the filters of -k, or all of them if it names none of the bank
+	if ( mSubset != NULL ) delete[] mSubset;
+	mSubset = NULL;
+	mNumSubset = mConfig.angles * mConfig.freqs;
+	if ( mConfig.subset[0] != '\0' && mNumSubset > 0 )
+	{
+		mSubset = new int[mNumSubset];
+		mNumSubset = ParseSubset( mConfig.subset, mConfig.angles, mConfig.freqs, mSubset );
+		if ( mNumSubset < 0 )
+		{
+			delete[] mSubset;
+			mSubset = NULL;
+			mNumSubset = mConfig.angles * mConfig.freqs;
+		}
+	}
+}
+
+
+// take the grayscale matrix for an image of h x w pixels from the image arena. 
+// Everything the previous image used is released, so after the first image of a 
+// given size no memory is allocated.
+void GaborContext::AllocatePixels( int h, int w )
+{
+	mImageArena.Reset();
+	mHeight = h;
+	mWidth = w;
+	mPixels = mImageArena.NewMatrix( h, w );
+}
+
+
+// filter interleaved rgb values, as e.g. piped from a camera capture
+float* GaborContext::ProcessImageData( int* rgb, int h, int w, float* response, int* len )
+{
+	AllocatePixels( h, w );
+	ConvertToGray( rgb, mPixels, h, w, mPipeline.GetGrayConversion() );
+
+	return ProcessPixels( response, len, NULL );
+}
+
+
+// directory for the intermediate files of file, created if they are saved; dirStr
+// then ends in a slash
+void GaborContext::MakeOutputDir( char* file, char* dirStr )
+{
+	char 	basename[256];
+	char*	fileStr;
+	int		i;
+
+// extract directory path from filename
+	strcpy( dirStr, file );
+	fileStr = strrchr( dirStr, '/' );
+	if ( fileStr != NULL )
+	{
+		strcpy( basename, fileStr );				// save part after last slash
+		dirStr[fileStr-dirStr+1] = '\0';				// save directory string
+		strcat( dirStr, basename );
+		strcat( dirStr, "-localGF" );
+		basename[strlen(basename)-4] = '\0';			// remove extension
+		for ( i = 0; i < (int)strlen( basename ); i++ )	// remove intial slash
+			basename[i] = basename[i+1];
+		basename[i] = '\0';
+	}
+	else	// we are in working directory
+	{
+		strcpy( basename, file );
+		basename[strlen(basename)-4] = '\0';			// remove extension
+		strcpy( dirStr, basename );
+		strcat( dirStr, "-localGF" );
+	}
+
+// create img directory in extracted path
+	if ( mConfig.saveFilter && !mFiltersSaved )
+	{
+		mkdir( dirStr, S_IRWXU | S_IRWXG );
+		if ( mConfig.verbosity ) cerr << "Created directory: \"" << dirStr << "\"" << endl;
+		strcat( dirStr, "/" );
+	}
+}
+
+
+/* 
+pass the rgb pixel vector for filtering; the response is returned in the response vector. 
+If NULL, this vector will be initialized by the Gabor API, but MUST disposed of it by the user.
+len is the address of an int holding the length of the response vector. 
+*/
+float* GaborContext::ProcessFile( char* file, int*** rgb, int h, int w, float* response, int* len )
+{
+	char	dirStr[256];
+
+	MakeOutputDir( file, dirStr );
+
+//  convert rgb info to grayscale
+	AllocatePixels( h, w );
+	ConvertToGray( rgb, mPixels, h, w, mPipeline.GetGrayConversion() );
+
+	return ProcessPixels( response, len, ( mConfig.saveFilter && !mFiltersSaved ) ? dirStr : NULL );
+}
+
+
+// as ProcessFile for an image that was decoded straight to grayscale, which is filtered 
+// in place rather than copied
+float* GaborContext::ProcessGray( char* file, float** gray, int h, int w, float* response, int* len )
+{
+	char	dirStr[256];
+
+	MakeOutputDir( file, dirStr );
+
+	mImageArena.Reset();
+	mHeight = h;
+	mWidth = w;
+	mPixels = gray;
+
+	return ProcessPixels( response, len, ( mConfig.saveFilter && !mFiltersSaved ) ? dirStr : NULL );
+}
+
+
+// the pipeline is always grayscale, so the decoder can convert straight to gray
+void GaborContext::PrepareImage( PGMImage* image )
+{
+	image->SetGrayDecode( true, mPipeline.GetGrayConversion() );
+}
+
+
+// whether image has pixels to filter
+bool GaborContext::Accepts( PGMImage* image )
+{
+	return image->GetGrayPixels() != NULL || image->GetRGBPixels() != NULL;
+}
+
+
+// filter an image read by PGMImage, from its grayscale pixels or its rgb planes
+float* GaborContext::ProcessImage( char* file, PGMImage* image, float* response, int* len )
+{
+	*len = 0;
+	if ( !Accepts( image ) ) return response;
+	if ( image->GetGrayPixels() != NULL )
+		return ProcessGray( file, image->GetGrayPixels(), image->GetHeight(), image->GetWidth(),
+							response, len );
+	return ProcessFile( file, image->GetRGBPixels(), image->GetHeight(), image->GetWidth(),
+						response, len );
+}
+
+
+// filter the grayscale scratch matrix and scale the response to [0,1]
+float* GaborContext::ProcessPixels( float* response, int* len, char* dir )
+{
+	float	norm, max, min;
+	int		i;
+
+	*len = GetResponseLength();
+	if ( *len == 0 ) return response;
+
+// response vector is initialized here, but needs to be disposed by user
+	if ( response == NULL ) response = new float[*len];
+	ProcessChannel( mPixels, mHeight, mWidth, response, dir );
+
+// original float values scaled to [0,1]
+	if ( mConfig.verbosity ) cerr << "scaling..." << endl;
+	max = min = response[0];
+	for ( i = 0; i < *len; i++ )
+	{
+		if( response[i] > max ) max = response[i];
+		if( response[i] < min ) min = response[i];
+	}
+	norm = max - min;
+	for ( i = 0; i < *len; i++ ) response[i] = 1.0 * ( ( response[i] - min ) / norm );
+
+	return response;
+}
+
+
+// filter a grayscale image at each of the fiducials
+int GaborContext::ProcessChannel( float** image, int h, int w, float* response, char* file )
+{
+	bool			save = mConfig.saveFilter && !mFiltersSaved && file != NULL;
+	int				height, width;
+	float** 		pixels;
+	StageBuffer		buffer = { image, h, w };
+	int				gflen;
+	int				i, j, offset = 0;
+	char			filename[256], suffix[5];
+	bool			built;
+
+	if ( mNumLocs == 0 ) return 0;
+
+// run the map stages of the pipeline, their output lives in the channel arena
+	mChannelArena.Reset();
+	mPipeline.Process( &buffer, &mChannelArena, save ? file : NULL );
+	pixels = buffer.pixels;
+	height = buffer.height;
+	width  = buffer.width;
+
+// initialize the filter bank, unless the one of the previous image still fits
+	built = ( mJet == NULL || save || mJet->GetTrim() != mConfig.trim ||
+			  !mJet->MatchesSubset( mSubset, mNumSubset ) ||
+			  !mJet->Matches( height, width, mConfig.radius, mConfig.sigma, mConfig.freqs, 
+						 mConfig.maxFreq, mConfig.minFreq, mConfig.angles ) );
+	if ( built )
+	{
+		delete mJet;
+		mJet = new GaborJet;
+		if ( save )
+		{
+			strcpy( filename, file );
+			sprintf( suffix, "%d-", 0 );
+			strcat( filename, suffix );
+			mJet->SetFileName( filename );
+		}
+		mJet->SetTrim( mConfig.trim );
+		mJet->SetSubset( mSubset, mNumSubset );
+		mJet->Initialize( height, width, mLocations[0][0], mLocations[0][1],
+						  mConfig.radius, mConfig.sigma, mConfig.freqs, mConfig.maxFreq, 
+						  mConfig.minFreq, mConfig.angles, save );
+	}
+	mJet->SetEngine( mConfig.engine );
+	mJet->SetBorder( mConfig.border );
+	
+// we already saved the filters for the first image, so leave them for the others
+	if ( save ) mFiltersSaved = true;
+	
+// move the jet over each of the fiducial points, or follow them from the previous image
+	if ( mConfig.track > 0 )
+		offset = TrackFiducials( pixels, height, width, response );
+	else for ( i = 0; i < mNumLocs; i++ )
+	{
+		mJet->SetLocation( mLocations[i][0], mLocations[i][1] );
+		mJet->Filter( pixels, &gflen );
+		for ( j = 0; j < gflen; j++ ) response[j+offset] = mJet->GetResponse(j);
+		offset = offset + gflen;
+	}	
+	if ( built && mConfig.trim > 0.0 && mConfig.verbosity )
+		mJet->ReportTrim( pixels, mLocations, mNumLocs, cerr );
+
+	return offset;
+}
+
+
+// forget the tracked fiducials and their jets
+void GaborContext::ResetTracking( void )
+{
+	if ( mTracked != NULL ) DisposeMatrix( mTracked, mNumTracked );
+	if ( mAmplitudes != NULL ) DisposeMatrix( mAmplitudes, mNumTracked );
+	if ( mPhases != NULL ) DisposeMatrix( mPhases, mNumTracked );
+	if ( mWaves != NULL ) DisposeMatrix( mWaves, mTrackFilters );
+	mTracked = NULL;
+	mAmplitudes = NULL;
+	mPhases = NULL;
+	mWaves = NULL;
+	mNumTracked = 0;
+	mTrackFilters = 0;
+}
+
+
+// start tracking from the locations given, unless the fiducials tracked so far are as
+// many and have jets of as many filters; true if tracking starts over
+bool GaborContext::AllocateTracking( int filters )
+{
+	if ( mTracked != NULL && mNumTracked == mNumLocs && mTrackFilters == filters ) return false;
+
+	ResetTracking();
+	mNumTracked = mNumLocs;
+	mTrackFilters = filters;
+	mTracked = CreateMatrix( (int)0, mNumTracked, 2 );
+	mAmplitudes = CreateMatrix( (float)0.0, mNumTracked, filters );
+	mPhases = CreateMatrix( (float)0.0, mNumTracked, filters );
+	mWaves = CreateMatrix( (float)0.0, filters, 3 );
+	for ( int i = 0; i < mNumTracked; i++ )
+	{
+		mTracked[i][0] = mLocations[i][0];
+		mTracked[i][1] = mLocations[i][1];
+	}
+	return true;
+}
+
+
+// phase p brought into [-pi, pi)
+inline float WrapPhase( float p )
+{
+	return p - 2.0 * M_PI * floor( ( p + M_PI ) / ( 2.0 * M_PI ) );
+}
+
+
+// Similarity of the jet just filtered with the last jet of fiducial i, with the phases
+// of the first corrected for a displacement (dx, dy): the sum of the products of their 
+// amplitudes times the cosine of their phase differences, over the norms of both.
+float GaborContext::JetSimilarity( int i, float dx, float dy )
+{
+	float	sum = 0.0, norm0 = 0.0, norm1 = 0.0;
+	float	a0, a1, d;
+
+	for ( int k = 0; k < mTrackFilters; k++ )
+	{
+		a0 = mAmplitudes[i][k];
+		a1 = mJet->GetResponse( k );
+		d = mJet->GetPhase( k ) - mPhases[i][k] - mWaves[k][0] * dx - mWaves[k][1] * dy;
+		sum += a0 * a1 * cos( d );
+		norm0 += a0 * a0;
+		norm1 += a1 * a1;
+	}
+	if ( norm0 == 0.0 || norm1 == 0.0 ) return 0.0;
+	return sum / sqrt( norm0 * norm1 );
+}
+
+
+// Displacement (dx, dy) of fiducial i that best explains the phases of the jet just 
+// filtered: a least squares fit of their differences with its last jet, weighted by 
+// the products of the amplitudes. The phases of a filter only tell displacements of 
+// less than half its wavelength apart, so the fit starts with the lowest frequency and 
+// adds the higher ones in turn, each unwrapped around the displacement found so far.
+// Filters of a single angle leave the displacement across them open; it stays 0 until 
+// a second angle joins. Returns the similarity of the jets at that displacement.
+float GaborContext::MatchJet( int i, float* dx, float* dy )
+{
+	float	level = 0.0, next;
+	float	gxx, gxy, gyy, bx, by, det, w, d;
+	int		k;
+
+	*dx = *dy = 0.0;
+	for ( ;; )
+	{
+	// the next frequency up
+		next = -1.0;
+		for ( k = 0; k < mTrackFilters; k++ )
+			if ( mWaves[k][2] > level * 1.0001 && ( next < 0.0 || mWaves[k][2] < next ) ) 
+				next = mWaves[k][2];
+		if ( next < 0.0 ) break;
+		level = next;
+
+	// fit what the filters up to it leave of their phase differences
+		gxx = gxy = gyy = bx = by = 0.0;
+		for ( k = 0; k < mTrackFilters; k++ )
+		{
+			if ( mWaves[k][2] > level * 1.0001 ) continue;
+			w = mAmplitudes[i][k] * mJet->GetResponse( k );
+			d = WrapPhase( mJet->GetPhase( k ) - mPhases[i][k] - 
+						   mWaves[k][0] * *dx - mWaves[k][1] * *dy );
+			gxx += w * mWaves[k][0] * mWaves[k][0];
+			gxy += w * mWaves[k][0] * mWaves[k][1];
+			gyy += w * mWaves[k][1] * mWaves[k][1];
+			bx += w * mWaves[k][0] * d;
+			by += w * mWaves[k][1] * d;
+		}
+		det = gxx * gyy - gxy * gxy;
+		if ( det <= 1e-4 * ( gxx + gyy ) * ( gxx + gyy ) ) continue;
+		*dx += ( gyy * bx - gxy * by ) / det;
+		*dy += ( gxx * by - gxy * bx ) / det;
+	}
+
+	return JetSimilarity( i, *dx, *dy );
+}
+
+
+// filter fiducial i at every position within mConfig.track pixels of (x, y) inside 
+// the h x w image, and move it to the one whose jet matches its last one best as it
+// is; the jet is left filtered there
+void GaborContext::SearchJet( float** image, int h, int w, int i, int* x, int* y )
+{
+	int		bx = *x, by = *y, sx, sy, len;
+	float	best = -2.0, similarity;
+
+	for ( sy = Max( *y - mConfig.track, 0 ); sy <= Min( *y + mConfig.track, h - 1 ); sy++ )
+	{
+		for ( sx = Max( *x - mConfig.track, 0 ); sx <= Min( *x + mConfig.track, w - 1 ); sx++ )
+		{
+			mJet->SetLocation( sx, sy );
+			mJet->Filter( image, &len );
+			similarity = JetSimilarity( i, 0.0, 0.0 );
+			if ( similarity > best )
+			{
+				best = similarity;
+				bx = sx;
+				by = sy;
+			}
+		}
+	}
+	*x = bx;
+	*y = by;
+	mJet->SetLocation( bx, by );
+	mJet->Filter( image, &len );
+}
+
+
+// Follow the fiducials from the previous image, filtering the h x w image into response.
+// Each fiducial is filtered at its last position, and the phases of its jet tell how far
+// it moved (MatchJet()). Only if that is a pixel or more is it filtered again where it 
+// moved to, up to kTrackSteps times as the estimate gets better. If its jet then no
+// longer matches the last one, it is lost and searched for around its last position
+// (SearchJet()). Its jet where it ends up is the one to match on the next image. The 
+// first image sets up the fiducials at the locations given.
+int GaborContext::TrackFiducials( float** image, int h, int w, float* response )
+{
+	int		filters = mJet->GetNumFilters();
+	bool	first = AllocateTracking( filters );
+	int		i, k, x, y, mx, my, step, len, offset = 0;
+	float	dx, dy, similarity;
+
+	mJet->SetPhases( true );
+	for ( k = 0; k < filters; k++ )
+	{
+		mJet->GetWaveVector( k, &mWaves[k][0], &mWaves[k][1] );
+		mWaves[k][2] = sqrt( mWaves[k][0] * mWaves[k][0] + mWaves[k][1] * mWaves[k][1] );
+	}
+
+	mNumMoved = 0;
+	mNumSearched = 0;
+	for ( i = 0; i < mNumTracked; i++ )
+	{
+		x = mTracked[i][0];
+		y = mTracked[i][1];
+		mJet->SetLocation( x, y );
+		mJet->Filter( image, &len );
+		if ( !first )
+		{
+		// follow the displacement, which is closer to the truth the nearer the jet gets
+			similarity = MatchJet( i, &dx, &dy );
+			for ( step = 0; step < kTrackSteps; step++ )
+			{
+				mx = Min( Max( x + (int)floor( dx + 0.5 ), 0 ), w - 1 );
+				my = Min( Max( y + (int)floor( dy + 0.5 ), 0 ), h - 1 );
+				if ( mx == x && my == y ) break;
+				if ( abs( mx - mTracked[i][0] ) > mConfig.track || abs( my - mTracked[i][1] ) > mConfig.track ) break;
+				x = mx;
+				y = my;
+				mJet->SetLocation( x, y );
+				mJet->Filter( image, &len );
+				similarity = MatchJet( i, &dx, &dy );
+			}
+			if ( x != mTracked[i][0] || y != mTracked[i][1] ) mNumMoved++;
+			if ( similarity < kTrackSimilarity )
+			{
+				x = mTracked[i][0];
+				y = mTracked[i][1];
+				SearchJet( image, h, w, i, &x, &y );
+				mNumSearched++;
+			}
+		}
+		mTracked[i][0] = x;
+		mTracked[i][1] = y;
+		for ( k = 0; k < len; k++ )
+		{
+			mAmplitudes[i][k] = mJet->GetResponse( k );
+			mPhases[i][k] = mJet->GetPhase( k );
+			response[offset+k] = mAmplitudes[i][k];
+		}
+		offset += len;
+	}
+	if ( mConfig.verbosity && !first )
+		cerr << "tracked " << mNumTracked << " fiducials: " << mNumMoved << " moved, " 
+			 << mNumSearched << " searched for" << endl;
+
+	return offset;
+}
+
+
+// read the number of fiducials and their coordinates from a stream
+bool ReadLocations( istream& infile, int*** locations, int* numLocs ) 
+{
+// read the number of patterns
+	SkipComments( &infile );
+	infile >> *numLocs;
+	if ( infile.fail() || *numLocs <= 0 )
+	{
+		*numLocs = 0;
+		*locations = NULL;
+		return false;
+	}
+
+// create the storage matrix
+	*locations = CreateMatrix( (int)0, *numLocs, 2 );
+
+// read in the pattern values
+	for ( int i = 0; i < *numLocs; i++ )
+	{
+		for ( int j = 0; j < 2; j++ )
+		{
+			SkipComments( &infile );
+			infile >> (*locations)[i][j];
+		}
+	}
+	if ( infile.fail() )
+	{
+		DisposeMatrix( *locations, *numLocs );
+		*numLocs = 0;
+		*locations = NULL;
+		return false;
+	}
+	return true;
+}
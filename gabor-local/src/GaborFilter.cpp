@@ -18,10 +18,18 @@ GaborFilter::GaborFilter()
 	mFrequency = 1.0;
 	mReal = NULL;
 	mImaginary = NULL;
+	mSupport = NULL;
 }
 
 // destructor: free up memory
 GaborFilter::~GaborFilter()
+{
+	Dispose();
+}
+
+
+// free the filter values so the filter can be initialized again
+void GaborFilter::Dispose( void )
 {
 	int i;
 	
@@ -35,6 +43,10 @@ GaborFilter::~GaborFilter()
 		for ( i = 0; i < mRadius; i++ ) delete[] mImaginary[i];
 		delete[] mImaginary;
 	}
+	delete mSupport;
+	mReal = NULL;
+	mImaginary = NULL;
+	mSupport = NULL;
 }
 
 
@@ -43,6 +55,9 @@ void GaborFilter::Initialize( int radius, float a, float f, float s, float p )
 {
 	float x, y, exponential, sincos;
 	
+// release a previous setup
+	Dispose();
+
 // set internal variables
 	mRadius = 2 * radius;
 	mXYO = radius;	// origin of filter
@@ -79,6 +94,14 @@ void GaborFilter::Initialize( int radius, float a, float f, float s, float p )
 }
 
 
+// find the taps that hold fraction of the energy of the filter
+void GaborFilter::Trim( float fraction )
+{
+	if ( mSupport == NULL ) mSupport = new FilterSupport;
+	mSupport->Compute( mReal, mImaginary, mRadius, mRadius, mXYO, mXYO, fraction );
+}
+
+
 // save the filter image
 void GaborFilter::Save( char* file, int angle, int freq )
 {
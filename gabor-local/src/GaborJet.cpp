@@ -5,6 +5,7 @@
 */
 
 #include "GaborJet.h"
+#include "Profiler.h"
 
 // default constructor just sets everything to default
 GaborJet::GaborJet()
@@ -15,18 +16,99 @@ GaborJet::GaborJet()
 	mY			= 128;
 	mShowFilter = false;
 	mFilters 	= NULL;
+	mSubset		= NULL;
+	mNumSubset	= 0;
+	mBank		= NULL;
+	mBankIndex	= NULL;
+	mNumFilters	= 0;
 	mFiducials	= NULL;
+	mPhases		= NULL;
+	mEngine		= kEngineAuto;
+	mFixedReal	= NULL;
+	mFixedImag	= NULL;
+	mFixedScale	= NULL;
+	mBorder		= kBorderZero;
+	mTrim		= 0.0;
+	mWindow		= NULL;
 }
 
 // destructor: free up memory
 GaborJet::~GaborJet()
+{
+	Dispose();
+	if ( mSubset != NULL ) delete[] mSubset;
+}
+
+
+// free filters and responses so the jet can be initialized again
+void GaborJet::Dispose( void )
 {
 	if ( mFilters != NULL )
 	{
 		for ( int i = 0; i < mAngles; i++ ) delete[] mFilters[i];
 		delete[] mFilters;
+		delete[] mBank;
+		delete[] mBankIndex;
 	}
 	if ( mFiducials != NULL ) delete[] mFiducials;	
+	if ( mPhases != NULL ) delete[] mPhases;
+	if ( mFixedReal != NULL )
+	{
+		delete[] mFixedReal;
+		delete[] mFixedImag;
+		delete[] mFixedScale;
+	}
+	if ( mWindow != NULL )
+	{
+		delete[] mWindow[0];
+		delete[] mWindow;
+	}
+
+	mFilters 	= NULL;
+	mBank		= NULL;
+	mBankIndex	= NULL;
+	mNumFilters	= 0;
+	mFiducials	= NULL;
+	mPhases		= NULL;
+	mFixedReal	= NULL;
+	mFixedImag	= NULL;
+	mFixedScale	= NULL;
+	mWindow		= NULL;
+}
+
+
+// whether the filter bank was built with these settings and can be reused,
+// possibly at another location
+bool GaborJet::Matches( int y, int x, int r, float s, int f, float maxF, float minF, int a )
+{
+	return mFilters != NULL && mHeight == y && mWidth == x && mRadius == r &&
+		   mSigma == (float)( s * M_PI * M_PI ) && mFreqs == f && 
+		   mMaxFreq == maxF && mMinFreq == minF && mAngles == a;
+}
+
+
+// see GaborJet.h
+void GaborJet::SetSubset( int* filters, int numFilters )
+{
+	if ( mSubset != NULL ) delete[] mSubset;
+	mSubset = NULL;
+	mNumSubset = 0;
+	if ( filters == NULL ) return;
+	mSubset = new int[Max( numFilters, 1 )];
+	for ( int k = 0; k < numFilters; k++ ) mSubset[k] = filters[k];
+	mNumSubset = numFilters;
+}
+
+
+// see GaborJet.h
+bool GaborJet::MatchesSubset( int* filters, int numFilters )
+{
+	if ( mFilters == NULL ) return false;
+	if ( filters == NULL ) return mNumFilters == mAngles * mFreqs;
+	if ( numFilters != mNumFilters ) return false;
+	for ( int k = 0; k < numFilters; k++ )
+		if ( filters[k] != mBankIndex[k] ) return false;
+	return true;
 }
 
 
@@ -34,9 +116,15 @@ GaborJet::~GaborJet()
 void GaborJet::Initialize( int y, int x, int x0, int y0, int r, 
 						   float s, int f, float maxF, float minF, int a, bool save )
 {
-	int		i, j;
+	int		i, j, k;
 	float	angle, freq;
+	bool*	used;
 	
+	PROFILE_SCOPE( profile, kStageFilterBank );
+
+// release a previous setup
+	Dispose();
+
 // set internal variables
 	mHeight 	= y;
 	mWidth 		= x;
@@ -49,7 +137,21 @@ void GaborJet::Initialize( int y, int x, int x0, int y0, int r,
 	mMinFreq 	= minF;
 	mMaxFreq 	= maxF;
 	mShowFilter = save;
-	mFiducials = new float[mAngles * mFreqs];
+
+// the filters in use, all of them unless SetSubset() chose some
+	used = new bool[mAngles*mFreqs];
+	for ( k = 0; k < mAngles * mFreqs; k++ ) used[k] = ( mSubset == NULL );
+	for ( k = 0; mSubset != NULL && k < mNumSubset; k++ )
+		if ( mSubset[k] >= 0 && mSubset[k] < mAngles * mFreqs ) used[mSubset[k]] = true;
+	mBank = new GaborFilter*[mAngles*mFreqs];
+	mBankIndex = new int[mAngles*mFreqs];
+	mNumFilters = 0;
+	for ( k = 0; k < mAngles * mFreqs; k++ ) if ( used[k] ) mNumFilters++;
+
+	mFiducials = new float[mNumFilters];
+	PROFILE_COUNT( profile, 4 * mNumFilters * mRadius * mRadius, 0 );
+	PROFILE_BYTES( mNumFilters * ( 4 * mRadius * ( sizeof(float*) + 2 * mRadius * sizeof(float) ) + sizeof(float) ) );
+	mNumFilters = 0;
 	
 // allocate memory for filters (angles * freqs = total filters)
 	mFilters = new GaborFilter * [mAngles];
@@ -64,14 +166,199 @@ void GaborJet::Initialize( int y, int x, int x0, int y0, int r,
 	// initialize each one	
 		for ( j = 0; j < mFreqs; j++ )
 		{
+			if ( !used[i*mFreqs+j] ) continue;
 		// calculate frequency
 			freq = minF + ( j * ( maxF - minF ) ) / (float)mFreqs;
 			
 		// initialize filter
 			mFilters[i][j].Initialize( mRadius, angle, freq, mSigma );
+			if ( mTrim > 0.0 ) mFilters[i][j].Trim( mTrim );
 			if ( mShowFilter ) mFilters[i][j].Save( mFile, i, j );
+			mBank[mNumFilters] = &mFilters[i][j];
+			mBankIndex[mNumFilters++] = i * mFreqs + j;
 		}
 	}	
+	delete[] used;
+}
+
+
+// see GaborJet.h; takes effect with the next Filter()
+void GaborJet::SetPhases( bool phases )
+{
+	if ( phases && mPhases == NULL && mNumFilters > 0 )
+	{
+		PROFILE_BYTES( mNumFilters * sizeof(float) );
+		mPhases = new float[mNumFilters];
+		for ( int k = 0; k < mNumFilters; k++ ) mPhases[k] = 0.0;
+	}
+	if ( !phases && mPhases != NULL )
+	{
+		delete[] mPhases;
+		mPhases = NULL;
+	}
+}
+
+
+// see GaborJet.h. The phase of a filter at angle a grows by its frequency per pixel 
+// along ( -sin a, cos a ), so a pattern that moved by d lines up with the filter at
+// a phase that much further along.
+void GaborJet::GetWaveVector( int idx, float* kx, float* ky )
+{
+	float	angle = mBank[idx]->GetAngle();
+	float	freq = mBank[idx]->GetFrequency();
+
+	*kx = -freq * sin( angle );
+	*ky = freq * cos( angle );
+}
+
+
+// responses of all filters in use, S x S pixels each, over the window at (y, x), two
+// filters at a time
+template <int S>
+void GaborJet::FilterFixed( float** image, int y, int x )
+{
+	int		k;
+	float	sumR0, sumI0, sumR1, sumI1;
+
+	for ( k = 0; k + 1 < mNumFilters; k += 2 )
+	{
+		sumR0 = sumI0 = sumR1 = sumI1 = 0.0;
+		CorrelateFilterPair<S,S>( image, y, x, mBank[k]->GetRealPart(), mBank[k]->GetImaginaryPart(),
+								  mBank[k+1]->GetRealPart(), mBank[k+1]->GetImaginaryPart(),
+								  sumR0, sumI0, sumR1, sumI1 );
+		SetResponse( k, sumR0, sumI0 );
+		SetResponse( k + 1, sumR1, sumI1 );
+	}
+	if ( k < mNumFilters )
+	{
+		sumR0 = sumI0 = 0.0;
+		CorrelateWindow<S,S>( image, y, x, mBank[k]->GetRealPart(), mBank[k]->GetImaginaryPart(), 
+							  sumR0, sumI0 );
+		SetResponse( k, sumR0, sumI0 );
+	}
+}
+
+
+// responses of all filters in use over the window at (y, x), each over the taps it kept
+void GaborJet::FilterTrimmed( float** image, int y, int x )
+{
+	int		k;
+	float	sumR, sumI;
+
+	for ( k = 0; k < mNumFilters; k++ )
+	{
+		sumR = sumI = 0.0;
+		CorrelateSupport( image, y, x, mBank[k]->GetRealPart(), mBank[k]->GetImaginaryPart(),
+						  mBank[k]->GetSupport(), sumR, sumI );
+		SetResponse( k, sumR, sumI );
+	}
+}
+
+
+// see GaborJet.h; the error of a filter is the largest difference of its responses
+// over the fiducials, relative to the largest whole response
+void GaborJet::ReportTrim( float** image, int** locations, int numLocs, ostream& out )
+{
+	int		a, f, h, i, len;
+	int		size = 2 * mRadius;
+	int		filters = mNumFilters;
+	float	trim = mTrim;
+	float*	trimmed;
+	float*	error;
+	float*	peak;
+	double	kept = 0.0;
+	FilterSupport*	support;
+
+	if ( mBank[0]->GetSupport() == NULL ) return;
+	trimmed = new float[numLocs*filters];
+	error = new float[filters];
+	peak = new float[filters];
+
+// the responses of each fiducial, trimmed and then whole
+	for ( h = 0; h < filters; h++ ) error[h] = peak[h] = 0.0;
+	for ( i = 0; i < numLocs; i++ )
+	{
+		SetLocation( locations[i][0], locations[i][1] );
+		Filter( image, &len );
+		for ( h = 0; h < filters; h++ ) trimmed[i*filters+h] = mFiducials[h];
+		mTrim = 0.0;
+		Filter( image, &len );
+		mTrim = trim;
+		for ( h = 0; h < filters; h++ )
+		{
+			peak[h] = Max( peak[h], mFiducials[h] );
+			error[h] = Max( error[h], (float)fabs( mFiducials[h] - trimmed[i*filters+h] ) );
+		}
+	}
+
+	for ( h = 0; h < filters; h++ )
+	{
+		a = mBankIndex[h] / mFreqs;
+		f = mBankIndex[h] % mFreqs;
+		support = mBank[h]->GetSupport();
+		kept += support->GetTaps();
+		out << "filter " << a << "," << f << ": " << support->GetTaps() << " of " << size * size;
+		out << " taps, " << 100.0 * support->GetEnergy() << "% of the energy, response error ";
+		out << ( ( peak[h] > 0.0 ) ? error[h] / peak[h] : 0.0 ) << endl;
+	}
+	out << "trimmed filters: " << 100.0 * ( 1.0 - kept / ( (double)size * size * filters ) );
+	out << "% fewer flops" << endl;
+
+	delete[] trimmed;
+	delete[] error;
+	delete[] peak;
+}
+
+
+// int16 copies of the filters, each scaled so that its largest coefficient uses all bits
+void GaborJet::QuantizeFilters( int bits )
+{
+	int		k;
+	int		size = 2 * mRadius;
+	float	maxR, maxI;
+
+	mFixedReal = new FixedMatrix[mNumFilters];
+	mFixedImag = new FixedMatrix[mNumFilters];
+	mFixedScale = new float[mNumFilters];
+	for ( k = 0; k < mNumFilters; k++ )
+	{
+		float**	real = mBank[k]->GetRealPart();
+		float**	imag = mBank[k]->GetImaginaryPart();
+		maxR = MaxMagnitude( real, 0, 0, size, size );
+		maxI = MaxMagnitude( imag, 0, 0, size, size );
+		mFixedScale[k] = ( Max( maxR, maxI ) > 0.0 ) ? ( ( 1 << bits ) - 1 ) / Max( maxR, maxI ) : 1.0;
+		mFixedReal[k].Quantize( real, 0, 0, size, size, mFixedScale[k], mFixedLen );
+		mFixedImag[k].Quantize( imag, 0, 0, size, size, mFixedScale[k], mFixedLen );
+	}
+}
+
+
+// responses of all filters over the window at (y, x) in 16 bit fixed point. The window
+// is quantized on its own, each filter is a run of pmaddwd over its rows.
+void GaborJet::FilterInt16( float** image, int y, int x )
+{
+	int		k;
+	int		size = 2 * mRadius;
+	int		pixelBits, coefBits;
+	long long	fixedR, fixedI;
+	float	sumR, sumI, pixelScale, max;
+
+	mFixedLen = ( size + kFixedLanes - 1 ) / kFixedLanes * kFixedLanes;
+	FixedPointBits( size * mFixedLen, &pixelBits, &coefBits );
+	if ( mFixedReal == NULL ) QuantizeFilters( coefBits );
+
+	max = MaxMagnitude( image, y, x, size, size );
+	pixelScale = ( max > 0.0 ) ? ( ( 1 << pixelBits ) - 1 ) / max : 1.0;
+	mFixedImage.Quantize( image, y, x, size, size, pixelScale, mFixedLen );
+
+	for ( k = 0; k < mNumFilters; k++ )
+	{
+		DotFixed( mFixedImage.GetRow( 0 ), mFixedLen, mFixedReal[k].GetRow( 0 ), 
+				  mFixedImag[k].GetRow( 0 ), size, mFixedLen, &fixedR, &fixedI );
+		sumR = fixedR / ( pixelScale * mFixedScale[k] );
+		sumI = fixedI / ( pixelScale * mFixedScale[k] );
+		SetResponse( k, sumR, sumI );
+	}
 }
 
 
@@ -80,52 +367,80 @@ void GaborJet::Filter( float** image, int* len )
 {	
 	int			x, y;		// iterating over location
 	int			gx, gy;		// iterating over filters
-	int			a, f;		// iterating over angles and frequencies
-	int			h, i, j;	// iterating over filter field
+	int			h, i, j;	// iterating over the filters in use and the filter field
+	int			size = 2 * mRadius;
 	float		sumI, sumR;	// sum of imaginary and of real parts
-	
-	cerr << "convoluting..." << endl;
+
+	PROFILE_SCOPE( profile, kStageJet );
+	PROFILE_COUNT( profile, size * size, mNumFilters * size * size );
+
+	*len = mNumFilters;
+	y = mY - mRadius;
+	x = mX - mRadius;
+
+// a filter that reaches past the edge runs over a copy of its window, whose pixels 
+// outside the image are given by the border policy; the loops below never check bounds
+	if ( y < 0 || x < 0 || y + size > mHeight || x + size > mWidth )
+	{
+		if ( mBorder == kBorderSkip )
+		{
+			for ( h = 0; h < *len; h++ ) SetResponse( h, 0.0, 0.0 );
+			return;
+		}
+		if ( mWindow == NULL )
+		{
+			mWindow = new float*[size];
+			mWindow[0] = new float[size*size];
+			PROFILE_BYTES( size * ( sizeof(float*) + size * sizeof(float) ) );
+			for ( i = 1; i < size; i++ ) mWindow[i] = mWindow[0] + i * size;
+		}
+		GatherBorder( image, mHeight, mWidth, y, x, size, size, mBorder, mWindow );
+		image = mWindow;
+		y = x = 0;
+	}
+
+// a kernel specialized for the radius or for fixed point, if there is one
+	if ( mEngine == kEngineInt16 )
+	{
+		FilterInt16( image, y, x );
+		return;
+	}
+	if ( mTrim > 0.0 )
+	{
+		FilterTrimmed( image, y, x );
+		return;
+	}
+	if ( mEngine == kEngineAuto )
+	{
+		switch ( mRadius )
+		{
+			case 10: FilterFixed<20>( image, y, x ); return;
+			case 16: FilterFixed<32>( image, y, x ); return;
+			case 32: FilterFixed<64>( image, y, x ); return;
+		}
+	}
 
 // convolve at center of filter location
 	// collect responses over angles and frequencies
-	h = 0;
-	for ( a = 0; a < mAngles; a++ )
+	for ( h = 0; h < mNumFilters; h++ )
 	{
-		for ( f = 0; f < mFreqs; f++ )
-		{
-			sumR = 0.0;
-			sumI = 0.0;
+		sumR = 0.0;
+		sumI = 0.0;
 
-		// start from bottom-left corner of filter location
-			y = mY - mRadius;
-			for ( gy = y; gy < y + 2 * mRadius; gy++ )
+	// start from bottom-left corner of filter location
+		for ( gy = y; gy < y + size; gy++ )
+		{
+		// offset to local coordinates of filter
+			i = gy - y;
+			for ( gx = x; gx < x + size; gx++ )
 			{
-			// make sure we are not out of bounds
-				if ( gy < 0 || gy >= mHeight ) break;
-				
 			// offset to local coordinates of filter
-				i = gy - y;
-				
-				x = mX - mRadius;
-				for ( gx = x; gx < x + 2 * mRadius; gx++ )
-				{
-				// make sure we are not out of bounds
-					if ( gx < 0 || gx >= mWidth ) break;
-
-				// offset to local coordinates of filter
-					j = gx - x;
-
-					sumR += image[gy][gx] * mFilters[a][f].GetReal(i,j);
-					sumI += image[gy][gx] * mFilters[a][f].GetImaginary(i,j);
-				}
-			}
-			mFiducials[h] = sqrt( sumR*sumR + sumI*sumI );
-			h++;
-		} // f
-	} // a
+				j = gx - x;
 
-	*len = mAngles * mFreqs;
+				sumR += image[gy][gx] * mBank[h]->GetReal(i,j);
+				sumI += image[gy][gx] * mBank[h]->GetImaginary(i,j);
+			}
+		}
+		SetResponse( h, sumR, sumI );
+	} // h
 }
-
-
-
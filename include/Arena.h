@@ -0,0 +1,66 @@
+/*
+	Description:	Scratch arena for per-image buffers. Memory is handed out by bumping 
+					a pointer and released all at once by Reset(). After Reset() the arena 
+					merges its blocks into one, so once an image of a given size has been 
+					processed, the next ones are served without touching the heap.
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#ifndef __ARENA__
+#define __ARENA__
+
+#include <stddef.h>
+
+// back large blocks with transparent huge pages where the system offers them
+#define kUseHugePages		1
+#define kHugePageSize		( 2 * 1024 * 1024 )
+
+// alignment of every allocation, a cache line
+#define kArenaAlignment		64
+
+class Arena
+{
+public:
+
+	Arena( size_t initial = 0 );
+	~Arena();
+
+	// uninitialized memory, valid until the next Reset()
+	void*		Allocate( size_t bytes );
+
+	// matrices with all rows in one piece, valid until the next Reset()
+	float**		NewMatrix( int row, int col );
+	float**		NewMatrix( float val, int row, int col );
+	int**		NewMatrix( int val, int row, int col );
+
+	// release everything allocated so far, keeping the memory for reuse
+	void		Reset( void );
+
+	inline size_t	GetReserved( void ) { return mReserved; }	// bytes held by the arena
+	inline size_t	GetUsed( void ) { return mUsed; }			// bytes handed out since Reset()
+	inline size_t	GetPeak( void ) { return mPeak; }			// most bytes ever in use at once
+	inline int		GetGrowths( void ) { return mGrowths; }		// blocks taken from the system
+
+protected:
+
+	struct Block
+	{
+		char*	base;		// start of the memory
+		size_t	size;		// bytes in the block
+		size_t	used;		// bytes handed out
+		bool	mapped;		// from mmap() rather than the heap
+		Block*	next;		// older block
+	};
+
+	Block*		NewBlock( size_t bytes );
+	void		DisposeBlock( Block* block );
+
+	Block*		mBlocks;	// most recent block first
+	size_t		mReserved;
+	size_t		mUsed;
+	size_t		mPeak;
+	int			mGrowths;
+};
+
+#endif
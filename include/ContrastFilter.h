@@ -8,13 +8,22 @@
 #define __CONTRAST_FILTER_CLASS__
 
 #include "PGMImage.h"
+#include "Arena.h"
+
+// the contrast map is this many pixels smaller than the image each way: pixel (i, j)
+// of the map is that of the 9 x 9 block at (i, j) of the image
+#define kContrastHalo	8
+
+// the contrast of the pixels in rows [top, bottom) and columns [left, right) of the map
+// of img only, into contrast
+void	ApplyContrast( float** img, float** contrast, int top, int left, int bottom, int right );
 
 class ContrastFilter
 {
 public:
 
-    ContrastFilter(){ mContrast = NULL; }
-    ContrastFilter( float**, int, int );
+    ContrastFilter(){ mContrast = NULL; mArena = NULL; }
+    ContrastFilter( float**, int, int, Arena* arena = NULL );
     ~ContrastFilter();
 
 	void 		ApplyFilter( float** img, int height, int width );
@@ -28,6 +37,7 @@ public:
 protected:
 
     float	**mContrast;	// applied contrast
+    Arena	*mArena;		// holds mContrast if not NULL
     char	mFile[256];		// file name
     int		mHeight;		// height of filter
     int		mWidth;			// width of filter
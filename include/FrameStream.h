@@ -0,0 +1,94 @@
+/*
+	Description:	Stream mode. Back-to-back PGM/PPM frames, e.g. from a capture process,
+					are read from stdin or a FIFO by a thread of their own, into a small
+					pool of images whose storage is reused for every frame. Decoded frames
+					wait in a bounded queue. When filtering falls behind, the oldest frame
+					waiting is dropped for the newest, so that latency stays bounded by the
+					length of the queue. Every filtered frame goes out as a binary record.
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+/*
+	Wire format (native byte order, like that of the service):
+
+	record:		GaborFrameHeader, followed by len floats
+				(for gaborlocal -M, the responses and then the x and y of each fiducial)
+*/
+
+#ifndef __FRAME_STREAM__
+#define __FRAME_STREAM__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <fstream>
+#include "PGMImage.h"
+#include "WorkQueue.h"
+
+#define kFrameMagic		"GBFR"
+
+// frames waiting to be filtered, by default, before the oldest is dropped
+#define kStreamQueue	2
+
+struct GaborFrameHeader
+{
+	char		magic[4];
+	int32_t		frame;		// index of the frame in the stream, dropped frames included
+	int32_t		len;		// number of floats that follow
+	int32_t		micros;		// from the end of its decoding to its record being written
+	int64_t		timestamp;	// GetMicroseconds() at the end of its decoding
+};
+
+// write the record of a frame
+bool	WriteFrame( int fd, int frame, long long timestamp, const float* response, int len );
+
+
+class FrameStream
+{
+public:
+
+	FrameStream( int capacity = kStreamQueue );
+	~FrameStream();
+
+	// The images frames are decoded into, to be set up (e.g. by GaborContext::PrepareImage())
+	// before Start(). They are not verbose.
+	inline int			GetNumImages( void ) { return mNumImages; }
+	inline PGMImage*	GetImage( int slot ) { return &mImages[slot]; }
+
+	// start reading frames from the FIFO or file at path, or from stdin if path is "-";
+	// false if it cannot be opened
+	bool		Start( char* path );
+	// wait for the oldest frame in the queue and hand out its slot; false once the
+	// stream ended and every frame was handed out. The stream must not be destroyed before.
+	bool		Next( int* slot );
+	// give the slot of a frame back once it is filtered
+	inline void	Release( int slot ) { mFree.Push( slot ); }
+
+	inline int			GetFrame( int slot ) { return mFrames[slot]; }
+	inline long long	GetTimestamp( int slot ) { return mStamps[slot]; }
+	// frames read and dropped so far
+	inline int			GetNumFrames( void ) { return mNumFrames; }
+	inline int			GetNumDropped( void ) { return mNumDropped; }
+
+	// body of the reader thread
+	static void*	Reader( void* stream );
+
+protected:
+
+	void		Read( void );
+
+	PGMImage*		mImages;	// a slot per frame in flight
+	int*			mFrames;	// index in the stream of the frame in each slot
+	long long*		mStamps;	// when the frame in each slot was decoded
+	int				mNumImages;	// the queue, plus one being decoded and one being filtered
+	WorkQueue		mQueue;		// slots of decoded frames, oldest first
+	WorkQueue		mFree;		// slots to decode into
+	istream*		mIn;		// stdin or mFile
+	ifstream		mFile;
+	pthread_t		mThread;
+	bool			mRunning;	// the reader thread was started
+	volatile int	mNumFrames;
+	volatile int	mNumDropped;
+};
+
+#endif
@@ -0,0 +1,280 @@
+/*
+	Description:	Convolution kernels of the Gabor jets, specialized at compile time
+					for the filter sizes in common use. Rows are fully unrolled and two
+					windows (or two filters) are done at once, so that each coefficient
+					(or pixel) is loaded once for both. The channels of a color image are
+					interleaved and filtered four lanes at a time. Every sum still adds its
+					taps in the same order as the generic loops, so the responses are 
+					identical.
+					The int16 engine quantizes the filters and the image to 16 bit fixed
+					point and multiplies them with pmaddwd (SSE2), or a scalar loop.
+					None of the kernels checks bounds: windows that reach past the image
+					are first filled in by a border policy, as a padded copy of the image
+					or as a window of their own.
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#ifndef __GABORKERNELS__
+#define __GABORKERNELS__
+
+// use SSE2 for the fixed-point products where the compiler targets it
+#define kUseSSE2		1
+
+// fixed-point rows are padded to a multiple of this many values
+#define kFixedLanes		8
+
+// convolution engines, selected with -E
+enum
+{
+	kEngineAuto = 0,	// a specialized kernel where one fits, the generic loops otherwise
+	kEngineGeneric,		// always the generic loops
+	kEngineInt16,		// 16 bit fixed point, for throughput at a small loss of precision
+	kNumEngines
+};
+
+// -E names, indexed by engine
+extern const char*	gEngineNames[kNumEngines];
+
+// engine of the given name, or -1
+int		FindEngine( const char* name );
+
+// pixels a filter window finds outside the image, selected with -B
+enum
+{
+	kBorderSkip = 0,	// windows must lie inside the image
+	kBorderZero,		// pixels outside are 0
+	kBorderClamp,		// pixels outside repeat the nearest edge pixel
+	kBorderReflect,		// the image is mirrored at its edges, the edge pixel included
+	kNumBorders
+};
+
+// -B names, indexed by policy
+extern const char*	gBorderNames[kNumBorders];
+
+// border policy of the given name, or -1
+int		FindBorder( const char* name );
+
+// The filters of an angles x freqs bank named by a -k list of angle/frequency index
+// pairs, e.g. "0/0,3/1,5/2". Their indices a * freqs + f are written to filters in
+// increasing order without repeats, unless it is NULL. Returns how many there are,
+// angles * freqs for an empty list, or -1 if list does not parse or names a filter
+// outside the bank.
+int		ParseSubset( const char* list, int angles, int freqs, int* filters );
+
+// index in [0, n) of pixel i of a row or column of n pixels, or -1 for a 0 pixel
+inline int BorderIndex( int i, int n, int border )
+{
+	if ( i >= 0 && i < n ) return i;
+	switch ( border )
+	{
+		case kBorderClamp:
+			return ( i < 0 ) ? 0 : n - 1;
+		case kBorderReflect:
+			i = i % ( 2 * n );
+			if ( i < 0 ) i += 2 * n;
+			return ( i < n ) ? i : 2 * n - 1 - i;
+	}
+	return -1;
+}
+
+// fill the sy x sx matrix out with the block at (y, x) of the h x w image, which may reach
+// past its edges. The rows and columns inside are copied as they are, only the band 
+// outside goes through BorderIndex().
+void	GatherBorder( float** image, int h, int w, int y, int x, int sy, int sx, int border,
+					  float** out );
+
+
+// an int16 copy of (part of) a float matrix, with rows padded with zeros
+class FixedMatrix
+{
+public:
+
+	FixedMatrix();
+	~FixedMatrix();
+
+	// round the h x w block at (y, x) of m times scale into rows of stride values
+	void	Quantize( float** m, int y, int x, int h, int w, float scale, int stride );
+
+	inline short*	GetRow( int i ) { return mData + i * mStride; }
+	inline int		GetStride( void ) { return mStride; }
+
+protected:
+
+	short*	mData;
+	int		mStride;	// values per row
+	int		mCapacity;	// allocated values
+};
+
+// the taps of a filter that hold a given fraction of its energy (the squares of its
+// real and imaginary parts). With a Gaussian envelope these are the taps nearest the
+// origin: a disc, kept as a range of columns per row.
+class FilterSupport
+{
+public:
+
+	FilterSupport();
+	~FilterSupport();
+
+	// the smallest disc around (oy, ox) that holds fraction of the energy of the sy x sx 
+	// filter; all taps if fraction is not below 1
+	void	Compute( float** real, float** imag, int sy, int sx, int oy, int ox, float fraction );
+
+	inline int		GetFirstRow( void ) { return mFirstRow; }	// rows [first, last) hold taps
+	inline int		GetLastRow( void ) { return mLastRow; }
+	inline int		GetStart( int i ) { return mStart[i]; }		// columns [start, end) of row i
+	inline int		GetEnd( int i ) { return mEnd[i]; }
+	inline int		GetTaps( void ) { return mTaps; }			// taps kept
+	inline float	GetEnergy( void ) { return mEnergy; }		// fraction of the energy they hold
+
+protected:
+
+	int*	mStart;
+	int*	mEnd;
+	int		mFirstRow;
+	int		mLastRow;
+	int		mTaps;
+	float	mEnergy;
+};
+
+// largest absolute value in the h x w block at (y, x) of m
+float	MaxMagnitude( float** m, int y, int x, int h, int w );
+
+// bits, besides the sign, for pixels and coefficients so that the products of a filter
+// with taps coefficients, spread over four 32 bit lanes, cannot overflow
+void	FixedPointBits( int taps, int* pixelBits, int* coefBits );
+
+// sums of p*r and p*m over rows of n values, n a multiple of kFixedLanes; successive
+// rows of p are pStride apart, those of r and m n apart
+void	DotFixed( const short* p, int pStride, const short* r, const short* m, int rows, 
+				  int n, long long* sumR, long long* sumI );
+
+// add the products of the sy x sx window at (y, x) of four channels, interleaved in the
+// rows of packed, with one filter to the four sums in sumR and sumI. Every channel adds 
+// its taps in the order of CorrelateWindow, so it gets the sums it would get alone.
+void	CorrelatePacked( float** packed, int y, int x, float** real, float** imag, int sy, 
+						 int sx, float* sumR, float* sumI );
+
+
+// add the products of the SY x SX window at (y, x) with one filter to sumR and sumI
+template <int SY, int SX>
+inline void CorrelateWindow( float** pixels, int y, int x, float** real, float** imag,
+							 float& sumR, float& sumI )
+{
+	for ( int i = 0; i < SY; i++ )
+	{
+		const float*	p = pixels[y+i] + x;
+		const float*	r = real[i];
+		const float*	m = imag[i];
+		for ( int j = 0; j < SX; j++ )
+		{
+			sumR += p[j] * r[j];
+			sumI += p[j] * m[j];
+		}
+	}
+}
+
+
+// as CorrelateWindow for the taps of a trimmed filter only
+inline void CorrelateSupport( float** pixels, int y, int x, float** real, float** imag,
+							  FilterSupport* support, float& sumR, float& sumI )
+{
+	for ( int i = support->GetFirstRow(); i < support->GetLastRow(); i++ )
+	{
+		const float*	p = pixels[y+i] + x;
+		const float*	r = real[i];
+		const float*	m = imag[i];
+		for ( int j = support->GetStart( i ); j < support->GetEnd( i ); j++ )
+		{
+			sumR += p[j] * r[j];
+			sumI += p[j] * m[j];
+		}
+	}
+}
+
+
+// as above for the windows at (y, x) and (y, x + dx), which share the coefficient loads
+template <int SY, int SX>
+inline void CorrelateWindowPair( float** pixels, int y, int x, int dx, float** real, float** imag,
+								 float& sumR0, float& sumI0, float& sumR1, float& sumI1 )
+{
+	for ( int i = 0; i < SY; i++ )
+	{
+		const float*	p0 = pixels[y+i] + x;
+		const float*	p1 = p0 + dx;
+		const float*	r = real[i];
+		const float*	m = imag[i];
+		for ( int j = 0; j < SX; j++ )
+		{
+			float	cr = r[j];
+			float	ci = m[j];
+			sumR0 += p0[j] * cr;
+			sumI0 += p0[j] * ci;
+			sumR1 += p1[j] * cr;
+			sumI1 += p1[j] * ci;
+		}
+	}
+}
+
+
+// as above for the sy x sx windows at (y, x + k * dx), k < 4, whose sums are sumR[k] 
+// and sumI[k]. Four windows give eight independent sums to keep the adds busy, and
+// each sum is still added up in the order of CorrelateWindow.
+inline void CorrelateWindowQuad( float** pixels, int y, int x, int dx, float** real, float** imag,
+								 int sy, int sx, float* sumR, float* sumI )
+{
+	float	r0 = sumR[0], r1 = sumR[1], r2 = sumR[2], r3 = sumR[3];
+	float	i0 = sumI[0], i1 = sumI[1], i2 = sumI[2], i3 = sumI[3];
+
+	for ( int i = 0; i < sy; i++ )
+	{
+		const float*	p0 = pixels[y+i] + x;
+		const float*	p1 = p0 + dx;
+		const float*	p2 = p1 + dx;
+		const float*	p3 = p2 + dx;
+		const float*	r = real[i];
+		const float*	m = imag[i];
+		for ( int j = 0; j < sx; j++ )
+		{
+			float	cr = r[j];
+			float	ci = m[j];
+			r0 += p0[j] * cr;
+			i0 += p0[j] * ci;
+			r1 += p1[j] * cr;
+			i1 += p1[j] * ci;
+			r2 += p2[j] * cr;
+			i2 += p2[j] * ci;
+			r3 += p3[j] * cr;
+			i3 += p3[j] * ci;
+		}
+	}
+	sumR[0] = r0; sumR[1] = r1; sumR[2] = r2; sumR[3] = r3;
+	sumI[0] = i0; sumI[1] = i1; sumI[2] = i2; sumI[3] = i3;
+}
+
+
+// as CorrelateWindow for two filters over the same window, which share the pixel loads
+template <int SY, int SX>
+inline void CorrelateFilterPair( float** pixels, int y, int x, float** real0, float** imag0,
+								 float** real1, float** imag1, float& sumR0, float& sumI0,
+								 float& sumR1, float& sumI1 )
+{
+	for ( int i = 0; i < SY; i++ )
+	{
+		const float*	p = pixels[y+i] + x;
+		const float*	r0 = real0[i];
+		const float*	m0 = imag0[i];
+		const float*	r1 = real1[i];
+		const float*	m1 = imag1[i];
+		for ( int j = 0; j < SX; j++ )
+		{
+			float	v = p[j];
+			sumR0 += v * r0[j];
+			sumI0 += v * m0[j];
+			sumR1 += v * r1[j];
+			sumI1 += v * m1[j];
+		}
+	}
+}
+
+#endif
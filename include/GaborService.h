@@ -0,0 +1,168 @@
+/*
+	Description:	Long-running service mode. Requests arrive framed over a Unix
+					domain socket or over stdin/stdout, responses go back as binary
+					vectors. The filter bank stays warm between requests.
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+/*
+	Wire format (native byte order, the service is meant for the local host):
+
+	request:	GaborRequestHeader, followed by
+				optionsLen bytes of command line options, e.g. "-X 8 -Y 8 -a 6"
+				fiducialsLen bytes of fiducial text in the -F file format
+				dataLen bytes holding either an image path or the PGM/PPM bytes
+	response:	GaborResponseHeader, followed by len floats
+*/
+
+#ifndef __GABOR_SERVICE__
+#define __GABOR_SERVICE__
+
+#include <stdint.h>
+#include <pthread.h>
+#include "PGMImage.h"
+#include "WorkQueue.h"
+
+#define kRequestMagic	"GBRQ"
+#define kResponseMagic	"GBRS"
+
+// request types
+enum
+{
+	kRequestPath = 1,	// data is the path of an image file
+	kRequestImage,		// data holds the bytes of a PGM/PPM image
+	kRequestStats,		// return latency percentiles
+	kRequestQuit		// shut the service down
+};
+
+// response status
+enum
+{
+	kStatusOK = 0,
+	kStatusBadRequest,
+	kStatusBadOptions,
+	kStatusBadFiducials,
+	kStatusBadImage
+};
+
+// number of floats in a kRequestStats response: count, p50, p90, p99, max (ms)
+#define kStatsLen	5
+
+struct GaborRequestHeader
+{
+	char		magic[4];
+	int32_t		type;
+	int32_t		optionsLen;
+	int32_t		fiducialsLen;
+	int32_t		dataLen;
+};
+
+struct GaborResponseHeader
+{
+	char		magic[4];
+	int32_t		status;
+	int32_t		len;		// number of floats that follow
+	int32_t		micros;		// time spent serving the request
+};
+
+// a decoded request; strings are NUL-terminated, buffers are reused between requests
+struct GaborRequest
+{
+	int			type;
+	char*		options;
+	char*		fiducials;
+	char*		data;
+	int			dataLen;
+	int			capacity[3];
+};
+
+// implemented by each front end. Every worker thread gets its own handler, so a handler
+// can keep a processing context warm without locking.
+class ServiceHandler
+{
+public:
+
+	virtual ~ServiceHandler() {}
+
+	// returns the response vector, owned by the handler until its next request
+	virtual float*	Serve( GaborRequest* request, int* len, int* status ) = 0;
+};
+
+typedef ServiceHandler* (*HandlerFactory)( void );
+
+
+// collects latencies and reports percentiles
+class LatencyStats
+{
+public:
+
+	LatencyStats();
+	~LatencyStats();
+
+	void		Add( long long micros );
+	void		Reset( void ) { mCount = 0; }
+	float		Percentile( float p );	// in milliseconds
+	void		Report( ostream& os, const char* label );
+
+	inline int	GetCount( void ) { return mCount; }
+
+protected:
+
+	long long*		mSamples;	// latencies in microseconds
+	int				mCount;		// number of samples
+	int				mCapacity;	// allocated samples
+	pthread_mutex_t	mLock;		// samples come in from several workers
+};
+
+
+// framing helpers, shared with the client
+bool	ReadFully( int fd, void* buf, int len );
+bool	WriteFully( int fd, const void* buf, int len );
+bool	ReadRequest( int fd, GaborRequest* request );
+bool	WriteRequest( int fd, int type, const char* options, const char* fiducials,
+					  const char* data, int dataLen );
+bool	ReadResponse( int fd, GaborResponseHeader* header, float** response, int* capacity );
+bool	WriteResponse( int fd, int status, const float* response, int len, int micros );
+void	DisposeRequest( GaborRequest* request );
+
+// load the image named or carried by a request
+bool	LoadRequestImage( GaborRequest* request, PGMImage* image );
+
+// split a string of options into an argv-style vector; returns argc
+int		SplitOptions( char* options, char** argv, int maxArgs );
+
+
+class GaborService
+{
+public:
+
+	GaborService( HandlerFactory factory, int threads = 1 );
+	~GaborService();
+
+	// serve on the socket at path, or on stdin/stdout if path is "-"
+	int			Run( char* path );
+
+	inline LatencyStats*	GetLatency( void ) { return &mLatency; }
+
+	// body of a worker thread: serves the connections handed out by Run()
+	static void*	Worker( void* service );
+
+protected:
+
+	bool		Serve( ServiceHandler* handler, int in, int out );
+	bool		Answer( ServiceHandler* handler, GaborRequest* request, int out );
+	void		Attach( int conn );
+	void		Detach( int conn );
+	void		HangUp( void );
+
+	HandlerFactory	mFactory;	// creates one handler per worker
+	int				mThreads;	// number of worker threads
+	WorkQueue		mQueue;		// accepted connections waiting for a worker
+	LatencyStats	mLatency;	// per-request latency
+	volatile bool	mQuit;		// a quit request came in
+	int*			mConns;		// connection being served by each worker, -1 for none
+	pthread_mutex_t	mConnLock;	// guards mConns
+};
+
+#endif
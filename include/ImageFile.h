@@ -38,6 +38,9 @@ public:
 	inline void		SetHeight( int h ){ mHeight = h; }
 	inline int		GetHeight(){ return mHeight; }
 
+	// whether to report on reading and writing
+	inline void		SetVerbosity( bool v ) { mVerbosity = v; }
+
 	// set or get one single pixel
 	inline void 	SetPixel( int x, int y, unsigned char p ) { if ( mPixels != NULL ) mPixels[x][y] = p; }
 	unsigned char	GetPixel( int x, int y );
@@ -49,7 +52,7 @@ public:
 
 	// allocate pixelmap
 	void			Allocate( int dataset );
-	void			Deallocate();
+	void			Deallocate( int dataset = kChars | kFloats | kRGB );
 
 	// read to or write image from file
 	virtual int		Read( char* ) = 0;
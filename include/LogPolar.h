@@ -9,13 +9,15 @@
 
 #include "GaborGlobal.h"
 #include "PGMImage.h"
+#include "Arena.h"
 
 class LogPolar
 {
 public:
 
-    LogPolar(){ mCoords = NULL; mPolarized = NULL; }
-    LogPolar( float** img, int height, int width, int minS, int ry = 30, int rx = 11 );
+    LogPolar(){ mCoords = NULL; mPolarized = NULL; mArena = NULL; }
+    LogPolar( float** img, int height, int width, int minS, int ry = 30, int rx = 11, 
+    		  Arena* arena = NULL );
     ~LogPolar();
 
 	void 		ApplyFilter( float** img, int height, int width );
@@ -30,6 +32,7 @@ protected:
 
     float	**mCoords;		// logpolar coordinates img
     float	**mPolarized;	// result
+    Arena	*mArena;		// holds mCoords and mPolarized if not NULL
     char	mFile[256];		// file name
     int		mMinHW;			// shortest size of image
     int		mHeight;		// height of filter
@@ -8,17 +8,25 @@
 #define __PGM_IMAGE_CLASS__
 
 #include "ImageFile.h"
+#include "Utilities.h"
 
 class PGMImage : public ImageFile
 {
 public:
 
-	PGMImage(){};
-	PGMImage( char* file ) { Read( file ); }
-	~PGMImage(){};
+	PGMImage();
+	PGMImage( char* file );
+	~PGMImage();
 
-	// Read a PGM image from a file
+	// Read a PGM image from a file or stream
 	int	Read( char* );
+	int	Read( istream& );
+
+	// decode color images straight to grayscale with the given conversion (see Utilities.h), 
+	// without rgb planes; grayscale images are then read as floats as well
+	inline void		SetGrayDecode( bool gray, int conversion = kGrayRMS ) { mGrayDecode = gray; mGrayConversion = conversion; }
+	// the pixels of the last image if it was decoded to grayscale, NULL otherwise
+	inline float**	GetGrayPixels( void ) { return mGrayDecoded ? mFloats : NULL; }
 
 	// Write a PGM image in a file
 	void	Write( char* );
@@ -32,6 +40,11 @@ private:
 	int  	mNumPixels;		// Total number of pixels (mHeight x mWidth)
 	int		mNumLevels;
 	int		mNumBits;
+	bool	mGrayDecode;		// decode to grayscale floats
+	int		mGrayConversion;	// kGrayRMS or kGrayLuma
+	bool	mGrayDecoded;		// the last image was decoded to grayscale
+	unsigned char*	mRow;		// one row of rgb bytes while decoding to grayscale
+	int		mRowSize;
 };
 
 #endif // __PGM_IMAGE_CLASS__
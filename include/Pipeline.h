@@ -0,0 +1,157 @@
+/*
+	Description:	Processing pipeline described at runtime, as a list of stage names such
+					as "gray,contrast,gabor". The image is decoded into rgb planes, which
+					are converted to one grayscale channel, or to three color channels in
+					rgb or in an opponent space. A grayscale pipeline may have the decoder
+					convert straight to gray instead. Each channel then runs through the map 
+					stages in the given order, each taking a matrix and handing on a new
+					one from the channel arena, and ends in the Gabor jet. Stages that are
+					not listed are never called.
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#ifndef __PIPELINE__
+#define __PIPELINE__
+
+#include "GaborGlobal.h"
+#include "Arena.h"
+#include "Utilities.h"
+
+#define kMaxStages		8		// map stages in one pipeline
+#define kMaxCachedMaps	32		// channel maps a MapCache keeps for one image
+
+// the stages a pipeline is composed of
+enum
+{
+	kPipeDecode = 0,	// image file to rgb planes, always first
+	kPipeGray,			// rgb planes to one grayscale channel, as their root mean square
+	kPipeLuma,			// rgb planes to one grayscale channel, as their luma
+	kPipeColor,			// rgb planes as three channels
+	kPipeOpponent,		// rgb planes to luminance, red-green and blue-yellow channels
+	kPipeContrast,		// ContrastFilter
+	kPipeLogPolar,		// LogPolar
+	kPipeGabor,			// the Gabor jet, always last
+	kNumPipeStages
+};
+
+// names in a pipeline description, indexed by stage
+extern const char*	gPipeStageNames[kNumPipeStages];
+
+// a matrix passed from one stage to the next
+struct StageBuffer
+{
+	float**	pixels;
+	int		height;
+	int		width;
+};
+
+// a stage that turns one matrix into another
+class Stage
+{
+public:
+
+	virtual ~Stage() {}
+
+	// filter in into out, whose matrix comes from arena; in and out may be the same
+	// buffer. Intermediate images are saved with file as prefix unless it is NULL.
+	virtual void	Process( StageBuffer* in, StageBuffer* out, Arena* arena, char* file ) = 0;
+	// size of the output for an input of h x w pixels
+	virtual void	GetOutputSize( int* h, int* w ) = 0;
+};
+
+class ContrastStage : public Stage
+{
+public:
+
+	void	Process( StageBuffer* in, StageBuffer* out, Arena* arena, char* file );
+	void	GetOutputSize( int* h, int* w ) { *h = *h - 8; *w = *w - 8; }
+};
+
+class LogPolarStage : public Stage
+{
+public:
+
+	void	Process( StageBuffer* in, StageBuffer* out, Arena* arena, char* file );
+	void	GetOutputSize( int* h, int* w ) { *h = *h / 2; *w = *w / 3; }
+};
+
+// The maps the stages made of the channels of one image, kept so that the contexts of
+// a sweep, which filter the same image with many filter banks, run the stages once for
+// each pipeline among them. The maps belong to the cache and must not be written to.
+class MapCache
+{
+public:
+
+	MapCache();
+
+	// forget the maps kept, before the next image
+	void	Clear( void );
+	// the map of the channel-th channel that pipeline desc made of the current image, if kept
+	bool	Find( const char* desc, int channel, StageBuffer* map );
+	// keep a copy of such a map, unless the cache is full
+	void	Store( const char* desc, int channel, StageBuffer* map );
+
+	// changes with every Clear()
+	inline int		GetGeneration( void ) { return mGeneration; }
+	// maps stored, and maps found rather than made again, so far
+	inline int		GetNumStored( void ) { return mNumStored; }
+	inline int		GetNumFound( void ) { return mNumFound; }
+
+protected:
+
+	Arena		mArena;							// the copies, released by Clear()
+	char		mDescs[kMaxCachedMaps][256];	// pipeline of each map
+	int			mChannels[kMaxCachedMaps];		// and its channel
+	StageBuffer	mMaps[kMaxCachedMaps];
+	int			mNumMaps;
+	int			mGeneration;
+	int			mNumStored;
+	int			mNumFound;
+};
+
+class Pipeline
+{
+public:
+
+	Pipeline();
+	~Pipeline();
+
+	// set up the stages of a description, unless it is the one in use. Names are
+	// separated by commas; decode and gabor may be left out. Returns false, keeping
+	// the previous stages, if the description is not valid.
+	bool	Parse( const char* desc );
+
+	// whether the stage is part of the pipeline
+	bool	Has( int stage );
+	inline bool		IsColor( void ) { return mColorSpace == kPipeColor || mColorSpace == kPipeOpponent; }
+	inline int		GetColorSpace( void ) { return mColorSpace; }	// kPipeGray, kPipeLuma, kPipeColor or kPipeOpponent
+	// conversion of a grayscale pipeline, kGrayRMS or kGrayLuma
+	inline int		GetGrayConversion( void ) { return ( mColorSpace == kPipeLuma ) ? kGrayLuma : kGrayRMS; }
+	inline int		GetNumChannels( void ) { return IsColor() ? 3 : 1; }
+	// number of map stages between the channels and the jet
+	inline int		GetNumStages( void ) { return mNumStages; }
+
+	// run a channel through the map stages. With a cache, the channels of an image are
+	// taken to come in the same order every time it is processed, and a channel whose
+	// map is kept gets that instead; intermediate images are then not saved.
+	void	Process( StageBuffer* buffer, Arena* arena, char* file );
+	inline void		SetCache( MapCache* cache ) { mCache = cache; }
+	// size of a channel after the map stages
+	void	GetOutputSize( int* h, int* w );
+
+protected:
+
+	void	Dispose( void );
+
+	char	mDesc[256];				// description in use
+	int		mColorSpace;			// stage that makes the channels
+	int		mKinds[kMaxStages];		// kind of each map stage
+	Stage*	mStages[kMaxStages];	// the map stages, in order
+	int		mNumStages;
+	MapCache*	mCache;			// maps shared with other pipelines, or NULL
+	int		mGeneration;		// of the cache when the current image began
+	int		mChannel;			// channels of the current image processed so far
+};
+
+#endif
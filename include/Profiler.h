@@ -0,0 +1,175 @@
+/*
+	Description:	Scoped timers and counters around the stages of the processing
+					pipeline. Every thread records into a buffer of its own; the buffers
+					are merged into per-stage histograms for a summary table, or written
+					out as a Chrome trace (chrome://tracing, Perfetto). On Linux, hardware
+					counters can be sampled around the heaviest stages with perf_event_open.
+					Profiling is off until Enable() is called, and compiled out entirely
+					with kUseProfiling 0.
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#ifndef __PROFILER__
+#define __PROFILER__
+
+#include <pthread.h>
+#include "GaborGlobal.h"
+using namespace std;
+
+#ifndef kUseProfiling
+#define kUseProfiling		1
+#endif
+
+#define kMaxTraceEvents		( 1 << 18 )	// per thread, later events are counted but dropped
+#define kNumBuckets			32			// histogram buckets of doubling duration, from 1 us
+#define kCacheLine			64			// bytes moved per cache miss
+
+// the stages of the pipeline
+enum
+{
+	kStageDecode = 0,	// PGMImage::Read
+	kStageGray,			// RGB to grayscale or opponent conversion
+	kStageContrast,		// ContrastFilter
+	kStageLogPolar,		// LogPolar
+	kStageFilterBank,	// GaborJet::Initialize
+	kStageJet,			// GaborJet::Filter
+	kStageOutput,		// writing the response vector
+	kNumStages
+};
+
+// hardware counters, read as one group
+enum
+{
+	kCounterCycles = 0,
+	kCounterInstructions,
+	kCounterL1Loads,	// L1 data cache reads
+	kCounterL1Misses,
+	kCounterLLCRefs,	// last level cache references
+	kCounterLLCMisses,
+	kNumCounters
+};
+
+// what happened in one stage of one thread
+struct StageStats
+{
+	long long	calls;
+	long long	nanos;					// total time
+	long long	pixels;					// pixels processed
+	long long	taps;					// filter coefficients evaluated
+	long long	bytes;					// bytes allocated
+	long long	buckets[kNumBuckets];	// calls by duration
+	long long	counters[kNumCounters];	// hardware events, if sampled
+};
+
+// one completed scope, as it goes into the trace
+struct TraceEvent
+{
+	int			stage;
+	long long	start;					// ns since the profiler was enabled
+	long long	nanos;
+	long long	pixels;
+	long long	taps;
+	long long	bytes;
+};
+
+class ProfileScope;
+
+// everything a thread records; owned by the profiler
+struct ProfileThread
+{
+	int				id;
+	StageStats		stages[kNumStages];
+	TraceEvent*		events;
+	int				numEvents;
+	long long		dropped;
+	ProfileScope*	current;			// innermost open scope
+	int				perfFd;				// leader of the counter group, -1 if none
+	int				perfIndex[kNumCounters];	// position in a group read, -1 if not open
+	ProfileThread*	next;
+};
+
+class Profiler
+{
+public:
+
+	// start recording; with trace, completed scopes are also kept for WriteTrace(),
+	// with counters, hardware events are sampled around decode, contrast and jet
+	static void		Enable( bool trace = false, bool counters = false );
+	// enable as asked for on the command line, reporting on stderr and/or writing
+	// the trace to traceFile (if not empty) when the program exits
+	static void		Start( bool summary, char* traceFile, bool counters = false );
+	static inline bool	IsEnabled( void ) { return sEnabled; }
+
+	// attribute allocated bytes to the innermost open scope of the calling thread
+	static void		CountBytes( long long bytes );
+
+	// merge the threads, which must have finished recording
+	static void		Report( ostream& os );
+	static bool		WriteTrace( char* file );
+
+	// called by ProfileScope
+	static ProfileThread*	GetThread( void );
+	static long long		GetNanoseconds( void );
+	static bool				ReadCounters( ProfileThread* thread, int stage, long long* values );
+	static void				Record( ProfileThread* thread, int stage, long long start,
+									long long nanos, long long pixels, long long taps,
+									long long bytes, long long* counters );
+
+protected:
+
+	static void		Finish( void );
+	static void		Merge( StageStats* total );
+	static float	Percentile( StageStats* stats, float p );
+	static void		OpenCounters( ProfileThread* thread );
+	static void		ReportCounters( ostream& os, StageStats* total );
+
+	static bool				sEnabled;
+	static bool				sTrace;
+	static bool				sCounters;	// sample hardware counters
+	static char				sCounterError[128];	// why counters could not be opened
+	static bool				sSummary;	// report on exit
+	static char				sTraceFile[256];	// trace written on exit
+	static long long		sOrigin;	// time of Enable()
+	static ProfileThread*	sThreads;	// every thread that recorded something
+	static int				sNumThreads;
+	static pthread_key_t	sKey;
+	static pthread_mutex_t	sLock;
+};
+
+// times the enclosing block as one call of a stage
+class ProfileScope
+{
+public:
+
+	ProfileScope( int stage );
+	~ProfileScope();
+
+	inline void	Count( long long pixels, long long taps ) { mPixels += pixels; mTaps += taps; }
+	inline void	AddBytes( long long bytes ) { mBytes += bytes; }
+
+protected:
+
+	ProfileThread*	mThread;	// NULL while profiling is off
+	ProfileScope*	mParent;
+	int				mStage;
+	long long		mStart;
+	long long		mPixels;
+	long long		mTaps;
+	long long		mBytes;
+	long long		mCounters[kNumCounters];	// at the start of the scope
+	bool			mCounted;					// whether mCounters were read
+};
+
+// instrumentation that disappears with kUseProfiling 0
+#if kUseProfiling
+#define PROFILE_SCOPE(name,stage)		ProfileScope name( stage )
+#define PROFILE_COUNT(name,pixels,taps)	name.Count( pixels, taps )
+#define PROFILE_BYTES(bytes)			Profiler::CountBytes( bytes )
+#else
+#define PROFILE_SCOPE(name,stage)
+#define PROFILE_COUNT(name,pixels,taps)
+#define PROFILE_BYTES(bytes)
+#endif
+
+#endif
@@ -0,0 +1,124 @@
+/*
+	Description:	A cache of response vectors on disk, so that an image seen before with
+					the same settings is not filtered again. An entry is keyed by a hash of
+					the decoded pixels and a hash of everything else the responses depend on
+					(GaborConfig::Describe(), and the fiducials in gabor-local), and holds
+					the vector in a file of its own, named after the key:
+
+						<dir>/<pixels><params>.gbc	a ResultCacheEntry, then len floats
+
+					Entries are written to a temporary file and renamed into place, so that
+					readers never see half of one. The "stats" file of the directory holds
+					the counts of all processes using it (ResultCacheStats), and is locked
+					with flock() around every change, which makes the cache safe to share
+					between the processes of one host, and the threads of each. Lookups
+					take no lock: a process counts its hits and misses in memory, and adds
+					them to the stats file when it stores an entry, reads the stats or
+					closes the cache. A lookup touches the entry, and once the entries hold
+					more than the size cap the least recently used are removed, down to
+					kCacheLowWater of it.
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#ifndef __RESULTCACHE__
+#define __RESULTCACHE__
+
+#include <stdint.h>
+#include <pthread.h>
+#include "PGMImage.h"
+
+#define kCacheMagic		"GBC1"
+#define kCacheSuffix	".gbc"
+#define kCacheStats		"stats"
+#define kCacheMaxName	40			// room for the name of any file of ours in the directory
+#define kCacheMegabytes	256			// default size cap
+#define kCacheLowWater	0.9			// fraction of the cap eviction frees down to
+#define kCacheStaleTemp	3600		// seconds after which a temporary file is left over by a crash
+
+#define kHashOffset		14695981039346656037ULL
+#define kHashPrime		1099511628211ULL
+
+// FNV-1a of the bytes of data, taken 8 at a time, continuing from hash
+uint64_t	HashBytes( const void* data, size_t bytes, uint64_t hash = kHashOffset );
+// FNV-1a of a string, without its terminating 0
+uint64_t	HashString( const char* text, uint64_t hash = kHashOffset );
+
+struct ResultCacheKey
+{
+	uint64_t	pixels;		// hash of the decoded image and its size
+	uint64_t	params;		// hash of the settings the responses depend on
+};
+
+// header of an entry
+struct ResultCacheEntry
+{
+	char		magic[4];	// kCacheMagic
+	int32_t		len;		// floats that follow
+	uint64_t	pixels;		// the key, checked on lookup
+	uint64_t	params;
+};
+
+// counts of all processes, in the stats file
+struct ResultCacheStats
+{
+	char		magic[4];	// kCacheMagic
+	int32_t		unused;
+	int64_t		bytes;		// size of the entries
+	int64_t		entries;
+	int64_t		hits;
+	int64_t		misses;
+	int64_t		evicted;
+};
+
+class ResultCache
+{
+public:
+
+	ResultCache();
+	~ResultCache();
+
+	// use the cache in dir, which is made if need be, holding at most maxBytes of entries;
+	// false, with a message, if it cannot be used
+	bool	Open( const char* dir, long long maxBytes );
+	inline bool		IsOpen( void ) { return mDir[0] != '\0'; }
+
+	// the key of an image as decoded by PGMImage, gray or rgb, under the given hash of the settings
+	static void		MakeKey( PGMImage* image, uint64_t params, ResultCacheKey* key );
+
+	// the responses stored under key, allocated here and to be disposed of by the caller,
+	// or NULL if there are none
+	float*	Lookup( const ResultCacheKey& key, int* len );
+	// store the responses under key, evicting entries if the cap is exceeded
+	void	Store( const ResultCacheKey& key, const float* response, int len );
+
+	// counts of this process
+	inline int		GetNumHits( void ) { return mNumHits; }
+	inline int		GetNumMisses( void ) { return mNumMisses; }
+	inline int		GetNumStored( void ) { return mNumStored; }
+	// counts of all processes, this one's included; false if the cache is not open
+	bool	GetStats( ResultCacheStats* stats );
+	// both of the above, as text
+	void	PrintStats( ostream& out );
+
+protected:
+
+	int		Lock( ResultCacheStats* stats );
+	void	Unlock( int fd, ResultCacheStats* stats );
+	void	Count( int hits, int misses );
+	void	AddPending( ResultCacheStats* stats );
+	void	Evict( ResultCacheStats* stats );
+	bool	MakePath( const char* name, char* path );
+	bool	EntryPath( const ResultCacheKey& key, char* path );
+
+	char			mDir[FILENAME_MAX];	// directory of the entries, empty if closed
+	long long		mMaxBytes;
+	pthread_mutex_t	mMutex;				// guards the counts of this process
+	int				mNumHits;
+	int				mNumMisses;
+	int				mNumStored;
+	int				mPendingHits;		// counts not yet in the stats file
+	int				mPendingMisses;
+};
+
+#endif
@@ -0,0 +1,24 @@
+/*
+	Description:	Parameter sweeps. A sweep file lists parameter sets, one per line, as
+					options that apply on top of those of the command line, e.g. "-s 3 -l 0.5".
+					A value may list alternatives separated by '|', and the line then stands
+					for every combination of them: "-s 2|3 -l 0.25|0.5" gives four sets.
+					# starts a comment, up to the end of the line.
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#ifndef __SWEEP__
+#define __SWEEP__
+
+#define kSweepSeparator		'|'
+#define kMaxSweepSets		4096	// sets a sweep file may stand for
+#define kMaxSweepLine		1024	// characters in a line, and in a set
+
+// Read the sets of a sweep file, each as a string of options, into sets, which is
+// allocated here and must be disposed of with DisposeSweep(). Returns false, with a 
+// message, if the file cannot be read, or stands for no set or more than kMaxSweepSets.
+bool	ReadSweep( char* path, char*** sets, int* numSets );
+void	DisposeSweep( char** sets, int numSets );
+
+#endif
@@ -37,14 +37,31 @@ void		DisposeMatrix( float** matrix, int row );
 
 float 		ReturnDistance( float *pat1, float *pat2, int size );
 
+// grayscale conversions of rgb pixels
+enum
+{
+	kGrayRMS = 0,		// root mean square of the three channels
+	kGrayLuma			// Rec. 601 luma, 0.299 r + 0.587 g + 0.114 b
+};
+
+void		ConvertToGray( int*** rgb, float** gray, int h, int w, int conversion = kGrayRMS );
+void		ConvertToGray( int* rgb, float** gray, int h, int w, int conversion = kGrayRMS );
+void		ConvertRowToGray( const unsigned char* rgb, float* gray, int w, int conversion = kGrayRMS );
+void		ConvertToOpponent( int*** rgb, float** channels[3], int h, int w );
+void		ConvertToOpponent( int* rgb, float** channels[3], int h, int w );
+
 void		GetStreamDefaults( void );
 void 		AdjustStream( ostream &os, int precision, int width, int pos, bool trailers );
 void		SetStreamDefaults( ostream &os );
 
-void 		SkipComments( ifstream* infile );
+void 		SkipComments( istream* infile );
+int			ReadOptionFile( char* file, char* text, int size, char** argv, int maxArgs );
+bool		CopyOption( char* field, size_t size, const char* option, const char* value );
 void 		FileCreateError( char* filename );
 void 		FileOpenError( char* filename );
 
+long long	GetMicroseconds( void );
+
 double		SafeAbs( double val1, double val2 );
 float		SafeAbs( float val1, float val2 );
 int			SafeAbs( int val1, int val2 );
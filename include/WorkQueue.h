@@ -0,0 +1,43 @@
+/*
+	Description:	Bounded, thread-safe queue of work items shared by worker threads
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#ifndef __WORK_QUEUE__
+#define __WORK_QUEUE__
+
+#include <pthread.h>
+
+class WorkQueue
+{
+public:
+
+	WorkQueue( int capacity = 64 );
+	~WorkQueue();
+
+	// add an item, waiting while the queue is full; false once closed
+	bool		Push( int item );
+	// add an item without waiting: if the queue is full, its oldest item is taken out to
+	// make room and returned in dropped. Returns whether an item was dropped.
+	bool		PushOrDrop( int item, int* dropped );
+	// take the oldest item, waiting while the queue is empty; false once closed and drained
+	bool		Pop( int* item );
+	// wake up all waiting threads; no further items are accepted
+	void		Close( void );
+
+	inline int	GetCount( void ) { return mCount; }
+
+protected:
+
+	int*			mItems;		// circular buffer of items
+	int				mCapacity;	// maximum number of queued items
+	int				mHead;		// index of the oldest item
+	int				mCount;		// number of queued items
+	bool			mClosed;	// no more items will be pushed
+	pthread_mutex_t	mLock;
+	pthread_cond_t	mNotEmpty;
+	pthread_cond_t	mNotFull;
+};
+
+#endif
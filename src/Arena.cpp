@@ -0,0 +1,157 @@
+/*
+	Description:	Scratch arena for per-image buffers
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include <sys/mman.h>
+#include <stdlib.h>
+#include "GaborGlobal.h"
+#include "Arena.h"
+#include "Profiler.h"
+
+Arena::Arena( size_t initial )
+{
+	mBlocks = NULL;
+	mReserved = 0;
+	mUsed = 0;
+	mPeak = 0;
+	mGrowths = 0;
+	if ( initial > 0 ) mBlocks = NewBlock( initial );
+}
+
+
+Arena::~Arena()
+{
+	while ( mBlocks != NULL )
+	{
+		Block* next = mBlocks->next;
+		DisposeBlock( mBlocks );
+		mBlocks = next;
+	}
+}
+
+
+// get a block from the system. Blocks of at least a huge page are mapped on their own,
+// aligned to a huge page, so the kernel can back them with huge pages.
+Arena::Block* Arena::NewBlock( size_t bytes )
+{
+	Block*	block = new Block;
+
+	bytes = ( bytes + kArenaAlignment - 1 ) & ~(size_t)( kArenaAlignment - 1 );
+	block->base = NULL;
+	block->mapped = false;
+#if kUseHugePages
+	if ( bytes >= kHugePageSize )
+	{
+		bytes = ( bytes + kHugePageSize - 1 ) & ~(size_t)( kHugePageSize - 1 );
+		void* base = mmap( NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0 );
+		if ( base != MAP_FAILED )
+		{
+		#ifdef MADV_HUGEPAGE
+			madvise( base, bytes, MADV_HUGEPAGE );
+		#endif
+			block->base = (char*)base;
+			block->mapped = true;
+		}
+	}
+#endif
+	if ( block->base == NULL && posix_memalign( (void**)&block->base, kArenaAlignment, bytes ) != 0 )
+	{
+		delete block;
+		return NULL;
+	}
+	block->size = bytes;
+	block->used = 0;
+	block->next = NULL;
+
+	mReserved += bytes;
+	mGrowths++;
+	PROFILE_BYTES( bytes );
+	return block;
+}
+
+
+void Arena::DisposeBlock( Block* block )
+{
+	if ( block->mapped )
+		munmap( block->base, block->size );
+	else
+		free( block->base );
+	mReserved -= block->size;
+	delete block;
+}
+
+
+void* Arena::Allocate( size_t bytes )
+{
+	bytes = ( bytes + kArenaAlignment - 1 ) & ~(size_t)( kArenaAlignment - 1 );
+
+// start a new block when the current one is full, at least doubling the reserve
+	if ( mBlocks == NULL || mBlocks->used + bytes > mBlocks->size )
+	{
+		Block* block = NewBlock( Max( bytes, mReserved ) );
+		if ( block == NULL ) return NULL;
+		block->next = mBlocks;
+		mBlocks = block;
+	}
+
+	void* p = mBlocks->base + mBlocks->used;
+	mBlocks->used += bytes;
+	mUsed += bytes;
+	if ( mUsed > mPeak ) mPeak = mUsed;
+	return p;
+}
+
+
+// merge the blocks into a single one that holds everything that was needed at once
+void Arena::Reset( void )
+{
+	if ( mBlocks != NULL && mBlocks->next != NULL )
+	{
+		while ( mBlocks != NULL )
+		{
+			Block* next = mBlocks->next;
+			DisposeBlock( mBlocks );
+			mBlocks = next;
+		}
+		mBlocks = NewBlock( mPeak );
+	}
+	if ( mBlocks != NULL ) mBlocks->used = 0;
+	mUsed = 0;
+}
+
+
+float** Arena::NewMatrix( int row, int col )
+{
+	float**	matrix = (float**)Allocate( row * sizeof(float*) );
+	float*	data = (float*)Allocate( (size_t)row * col * sizeof(float) );
+
+	for ( int i = 0; i < row; i++ ) matrix[i] = data + (size_t)i * col;
+	return matrix;
+}
+
+
+float** Arena::NewMatrix( float val, int row, int col )
+{
+	float** matrix = NewMatrix( row, col );
+
+	for ( int i = 0; i < row; i++ )
+		for ( int j = 0; j < col; j++ )
+			matrix[i][j] = val;
+	return matrix;
+}
+
+
+int** Arena::NewMatrix( int val, int row, int col )
+{
+	int**	matrix = (int**)Allocate( row * sizeof(int*) );
+	int*	data = (int*)Allocate( (size_t)row * col * sizeof(int) );
+
+	for ( int i = 0; i < row; i++ )
+	{
+		matrix[i] = data + (size_t)i * col;
+		for ( int j = 0; j < col; j++ ) matrix[i][j] = val;
+	}
+	return matrix;
+}
@@ -5,6 +5,7 @@
 */
 
 #include "ContrastFilter.h"
+#include "Profiler.h"
 
 float CONTRAST[9][9] = {
   {
@@ -115,18 +116,28 @@ float CONTRAST[9][9] = {
     -0.00601522
   }};
 
-// construct class and apply filter
-ContrastFilter::ContrastFilter( float **img, int height, int width )
+// construct class and apply filter; the contrast map comes from arena if given
+ContrastFilter::ContrastFilter( float **img, int height, int width, Arena* arena )
 {
 	mHeight = height-8;
 	mWidth = width-8;
+	mArena = arena;
 
-	mContrast = new float*[mHeight];
-	for ( int i = 0; i < mHeight; i++ )
+	PROFILE_SCOPE( profile, kStageContrast );
+	PROFILE_COUNT( profile, mHeight * mWidth, 81 * mHeight * mWidth );
+
+	if ( mArena != NULL )
+		mContrast = mArena->NewMatrix( mHeight, mWidth );	// every value is set below
+	else
 	{
-		mContrast[i] = new float[mWidth];
-		for ( int j = 0; j < mWidth; j++ )
-			mContrast[i][j] = 0.0;
+		mContrast = new float*[mHeight];
+		PROFILE_BYTES( mHeight * ( sizeof(float*) + mWidth * sizeof(float) ) );
+		for ( int i = 0; i < mHeight; i++ )
+		{
+			mContrast[i] = new float[mWidth];
+			for ( int j = 0; j < mWidth; j++ )
+				mContrast[i][j] = 0.0;
+		}
 	}
 
 	ApplyFilter( img, height, width );
@@ -136,7 +147,7 @@ ContrastFilter::ContrastFilter( float **img, int height, int width )
 // free memory
 ContrastFilter::~ContrastFilter()
 {
-	if( mContrast != NULL )
+	if( mContrast != NULL && mArena == NULL )
 	{
 		for( int y = 0; y < mHeight; y++ )
 			delete[] mContrast[y];
@@ -147,18 +158,25 @@ ContrastFilter::~ContrastFilter()
 
 // apply filter to image
 void ContrastFilter::ApplyFilter( float** img, int height, int width )
+{
+	ApplyContrast( img, mContrast, 0, 0, height-8, width-8 );
+}
+
+
+// see ContrastFilter.h
+void ApplyContrast( float** img, float** contrast, int top, int left, int bottom, int right )
 {
 	int 	x, y, i, j;//, k, l;
 	float 	tmp;
 
-	for( i = 0; i < height-8; i++ ) 
-		for( j = 0; j < width-8; j++ )
+	for( i = top; i < bottom; i++ ) 
+		for( j = left; j < right; j++ )
 		{
 			tmp = 0.0;
 			for( x = 0; x < 9; x++ )
 				for( y = 0; y < 9; y++)
 					tmp += CONTRAST[x][y] * img[i+x][j+y];
-			mContrast[i][j] = tmp;
+			contrast[i][j] = tmp;
 		}
 }
 
@@ -0,0 +1,126 @@
+/*
+	Description:	Stream mode: filtering back-to-back frames from stdin or a FIFO
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include <string.h>
+#include "FrameStream.h"
+#include "GaborService.h"
+#include "Utilities.h"
+
+
+bool WriteFrame( int fd, int frame, long long timestamp, const float* response, int len )
+{
+	GaborFrameHeader	header;
+
+	if ( response == NULL ) len = 0;
+	memcpy( header.magic, kFrameMagic, 4 );
+	header.frame = frame;
+	header.len = len;
+	header.micros = (int32_t)( GetMicroseconds() - timestamp );
+	header.timestamp = timestamp;
+
+	return WriteFully( fd, &header, sizeof(header) ) &&
+		   WriteFully( fd, response, len * sizeof(float) );
+}
+
+
+// Every slot is free to begin with. There are two more slots than the queue holds, so
+// that the reader always finds one to decode into, even with the queue full and a frame
+// being filtered.
+FrameStream::FrameStream( int capacity ) : mQueue( capacity ), mFree( capacity + 2 )
+{
+	mNumImages = capacity + 2;
+	mImages = new PGMImage[mNumImages];
+	mFrames = new int[mNumImages];
+	mStamps = new long long[mNumImages];
+	for ( int i = 0; i < mNumImages; i++ )
+	{
+		mImages[i].SetVerbosity( false );
+		mFrames[i] = -1;
+		mStamps[i] = 0;
+		mFree.Push( i );
+	}
+	mIn = NULL;
+	mRunning = false;
+	mNumFrames = 0;
+	mNumDropped = 0;
+}
+
+
+FrameStream::~FrameStream()
+{
+	if ( mRunning )
+	{
+		mFree.Close();
+		pthread_join( mThread, NULL );
+	}
+	delete[] mImages;
+	delete[] mFrames;
+	delete[] mStamps;
+}
+
+
+bool FrameStream::Start( char* path )
+{
+	if ( strcmp( path, "-" ) == 0 )
+	{
+		mIn = &cin;
+	}
+	else
+	{
+		mFile.open( path, ios::in | ios::binary );
+		if ( !mFile )
+		{
+			cerr << "cannot open frame stream \"" << path << "\"" << endl;
+			return false;
+		}
+		mIn = &mFile;
+	}
+
+	if ( pthread_create( &mThread, NULL, Reader, this ) != 0 )
+	{
+		cerr << "cannot start the frame reader" << endl;
+		return false;
+	}
+	mRunning = true;
+	return true;
+}
+
+
+void* FrameStream::Reader( void* stream )
+{
+	((FrameStream*)stream)->Read();
+	return NULL;
+}
+
+
+// decode frames until the stream ends or no longer holds an image
+void FrameStream::Read( void )
+{
+	int		slot, dropped;
+
+	while ( mFree.Pop( &slot ) )
+	{
+		if ( !mImages[slot].Read( *mIn ) )
+		{
+			mFree.Push( slot );
+			break;
+		}
+		mStamps[slot] = GetMicroseconds();
+		mFrames[slot] = mNumFrames++;
+		if ( mQueue.PushOrDrop( slot, &dropped ) )
+		{
+			mNumDropped++;
+			mFree.Push( dropped );
+		}
+	}
+	mQueue.Close();
+}
+
+
+bool FrameStream::Next( int* slot )
+{
+	return mQueue.Pop( slot );
+}
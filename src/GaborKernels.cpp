@@ -0,0 +1,328 @@
+/*
+	Description:	Convolution engines of the Gabor jets
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "GaborGlobal.h"
+#include "GaborKernels.h"
+#if kUseSSE2 && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+const char*	gEngineNames[kNumEngines] = { "auto", "generic", "int16" };
+
+
+int FindEngine( const char* name )
+{
+	for ( int e = 0; e < kNumEngines; e++ )
+		if ( strcmp( name, gEngineNames[e] ) == 0 ) return e;
+	return -1;
+}
+
+
+const char*	gBorderNames[kNumBorders] = { "skip", "zero", "clamp", "reflect" };
+
+
+int FindBorder( const char* name )
+{
+	for ( int b = 0; b < kNumBorders; b++ )
+		if ( strcmp( name, gBorderNames[b] ) == 0 ) return b;
+	return -1;
+}
+
+
+// see GaborKernels.h
+int ParseSubset( const char* list, int angles, int freqs, int* filters )
+{
+	bool*		chosen;
+	const char*	s = list;
+	char*		end;
+	int			a, f, k, n = 0;
+
+	if ( angles <= 0 || freqs <= 0 ) return -1;
+	chosen = new bool[angles*freqs];
+	for ( k = 0; k < angles * freqs; k++ ) chosen[k] = ( *list == '\0' );
+
+	while ( *s != '\0' )
+	{
+		a = (int)strtol( s, &end, 10 );
+		if ( end == s || *end != '/' ) break;
+		s = end + 1;
+		f = (int)strtol( s, &end, 10 );
+		if ( end == s || a < 0 || a >= angles || f < 0 || f >= freqs ) break;
+		chosen[a*freqs+f] = true;
+		s = end;
+		if ( *s == ',' && s[1] != '\0' ) s++;
+		else if ( *s != '\0' ) break;
+	}
+
+	if ( *s == '\0' )
+		for ( k = 0; k < angles * freqs; k++ )
+			if ( chosen[k] )
+			{
+				if ( filters != NULL ) filters[n] = k;
+				n++;
+			}
+	delete[] chosen;
+	return ( n > 0 ) ? n : -1;
+}
+
+
+// see GaborKernels.h
+void GatherBorder( float** image, int h, int w, int y, int x, int sy, int sx, int border,
+				   float** out )
+{
+	int		i, j, row, col;
+	int		left = Min( Max( -x, 0 ), sx );				// columns left of the image
+	int		right = Min( Max( x + sx - w, 0 ), sx - left );	// columns right of it
+	int		inside = sx - left - right;
+
+	for ( i = 0; i < sy; i++ )
+	{
+		row = BorderIndex( y + i, h, border );
+		if ( row < 0 )
+		{
+			for ( j = 0; j < sx; j++ ) out[i][j] = 0.0;
+			continue;
+		}
+		for ( j = 0; j < left; j++ )
+		{
+			col = BorderIndex( x + j, w, border );
+			out[i][j] = ( col < 0 ) ? 0.0 : image[row][col];
+		}
+		if ( inside > 0 ) memcpy( out[i] + left, image[row] + x + left, inside * sizeof(float) );
+		for ( j = sx - right; j < sx; j++ )
+		{
+			col = BorderIndex( x + j, w, border );
+			out[i][j] = ( col < 0 ) ? 0.0 : image[row][col];
+		}
+	}
+}
+
+
+FilterSupport::FilterSupport()
+{
+	mStart = NULL;
+	mEnd = NULL;
+	mFirstRow = mLastRow = 0;
+	mTaps = 0;
+	mEnergy = 1.0;
+}
+
+
+FilterSupport::~FilterSupport()
+{
+	delete[] mStart;
+	delete[] mEnd;
+}
+
+
+// see GaborKernels.h. The energy is summed per squared distance from the origin, and 
+// distances are added from the nearest out until the fraction is reached.
+void FilterSupport::Compute( float** real, float** imag, int sy, int sx, int oy, int ox, float fraction )
+{
+	int		i, j, dy, half, maxDist, radius2;
+	int		farY = Max( oy, sy - 1 - oy );
+	int		farX = Max( ox, sx - 1 - ox );
+	double	total = 0.0, kept = 0.0, sum;
+	double*	rings;
+
+	delete[] mStart;
+	delete[] mEnd;
+	mStart = new int[sy];
+	mEnd = new int[sy];
+
+// energy at each squared distance
+	maxDist = farY * farY + farX * farX;
+	rings = new double[maxDist+1];
+	for ( i = 0; i <= maxDist; i++ ) rings[i] = 0.0;
+	for ( i = 0; i < sy; i++ )
+		for ( j = 0; j < sx; j++ )
+			rings[(i-oy)*(i-oy)+(j-ox)*(j-ox)] += real[i][j] * real[i][j] + imag[i][j] * imag[i][j];
+	for ( i = 0; i <= maxDist; i++ ) total += rings[i];
+
+// smallest disc that holds the fraction
+	radius2 = maxDist;
+	if ( fraction < 1.0 )
+	{
+		sum = 0.0;
+		for ( radius2 = 0; radius2 < maxDist; radius2++ )
+		{
+			sum += rings[radius2];
+			if ( sum >= fraction * total ) break;
+		}
+	}
+	delete[] rings;
+
+// its columns in each row
+	mFirstRow = sy;
+	mLastRow = 0;
+	mTaps = 0;
+	for ( i = 0; i < sy; i++ )
+	{
+		dy = i - oy;
+		mStart[i] = mEnd[i] = 0;
+		if ( dy * dy > radius2 ) continue;
+		half = (int)sqrt( (double)( radius2 - dy * dy ) );
+		while ( half * half > radius2 - dy * dy ) half--;
+		while ( ( half + 1 ) * ( half + 1 ) <= radius2 - dy * dy ) half++;
+		mStart[i] = Max( ox - half, 0 );
+		mEnd[i] = Min( ox + half + 1, sx );
+		if ( mEnd[i] <= mStart[i] ) continue;
+		mFirstRow = Min( mFirstRow, i );
+		mLastRow = i + 1;
+		mTaps += mEnd[i] - mStart[i];
+		for ( j = mStart[i]; j < mEnd[i]; j++ )
+			kept += real[i][j] * real[i][j] + imag[i][j] * imag[i][j];
+	}
+	if ( mLastRow == 0 ) mFirstRow = 0;
+	mEnergy = ( total > 0.0 ) ? kept / total : 1.0;
+}
+
+
+FixedMatrix::FixedMatrix()
+{
+	mData = NULL;
+	mStride = 0;
+	mCapacity = 0;
+}
+
+
+FixedMatrix::~FixedMatrix()
+{
+	delete[] mData;
+}
+
+
+// the storage is kept for the next call, and only grows
+void FixedMatrix::Quantize( float** m, int y, int x, int h, int w, float scale, int stride )
+{
+	if ( h * stride > mCapacity )
+	{
+		delete[] mData;
+		mCapacity = h * stride;
+		mData = new short[mCapacity];
+	}
+	mStride = stride;
+
+	for ( int i = 0; i < h; i++ )
+	{
+		short* row = GetRow( i );
+		for ( int j = 0; j < w; j++ ) row[j] = (short)lrintf( m[y+i][x+j] * scale );
+		for ( int j = w; j < stride; j++ ) row[j] = 0;
+	}
+}
+
+
+float MaxMagnitude( float** m, int y, int x, int h, int w )
+{
+	float	max = 0.0;
+
+	for ( int i = y; i < y + h; i++ )
+		for ( int j = x; j < x + w; j++ )
+			if ( fabs( m[i][j] ) > max ) max = fabs( m[i][j] );
+	return max;
+}
+
+
+// taps / 4 products of p and c bits sum to less than 2^(p + c + log2( taps / 4 )) in 
+// each lane, which has to stay below 2^31. The budget is split evenly, at most 15 bits each.
+void FixedPointBits( int taps, int* pixelBits, int* coefBits )
+{
+	int		logN = 0;
+
+	while ( ( 1 << logN ) < ( taps + 3 ) / 4 ) logN++;
+	int budget = 31 - logN;
+	*pixelBits = Min( budget / 2, 15 );
+	*coefBits = Min( budget - *pixelBits, 15 );
+}
+
+
+// a lane per channel, with one coefficient broadcast to all of them
+void CorrelatePacked( float** packed, int y, int x, float** real, float** imag, int sy, 
+					  int sx, float* sumR, float* sumI )
+{
+#if kUseSSE2 && defined(__SSE2__)
+	__m128	accR = _mm_loadu_ps( sumR );
+	__m128	accI = _mm_loadu_ps( sumI );
+
+	for ( int i = 0; i < sy; i++ )
+	{
+		const float*	p = packed[y+i] + 4 * x;
+		const float*	r = real[i];
+		const float*	m = imag[i];
+		for ( int j = 0; j < sx; j++ )
+		{
+			__m128	v = _mm_loadu_ps( p + 4 * j );
+			accR = _mm_add_ps( accR, _mm_mul_ps( v, _mm_set1_ps( r[j] ) ) );
+			accI = _mm_add_ps( accI, _mm_mul_ps( v, _mm_set1_ps( m[j] ) ) );
+		}
+	}
+	_mm_storeu_ps( sumR, accR );
+	_mm_storeu_ps( sumI, accI );
+#else
+	for ( int i = 0; i < sy; i++ )
+	{
+		const float*	p = packed[y+i] + 4 * x;
+		const float*	r = real[i];
+		const float*	m = imag[i];
+		for ( int j = 0; j < sx; j++ )
+			for ( int c = 0; c < 4; c++ )
+			{
+				sumR[c] += p[4*j+c] * r[j];
+				sumI[c] += p[4*j+c] * m[j];
+			}
+	}
+#endif
+}
+
+
+void DotFixed( const short* p, int pStride, const short* r, const short* m, int rows, 
+			   int n, long long* sumR, long long* sumI )
+{
+#if kUseSSE2 && defined(__SSE2__)
+	__m128i	accR = _mm_setzero_si128();
+	__m128i	accI = _mm_setzero_si128();
+	int		lanes[4];
+
+// pmaddwd: eight 16 bit products, added pairwise into four 32 bit lanes
+	for ( int i = 0; i < rows; i++ )
+	{
+		for ( int j = 0; j < n; j += kFixedLanes )
+		{
+			__m128i	v = _mm_loadu_si128( (const __m128i*)( p + j ) );
+			accR = _mm_add_epi32( accR, _mm_madd_epi16( v, _mm_loadu_si128( (const __m128i*)( r + j ) ) ) );
+			accI = _mm_add_epi32( accI, _mm_madd_epi16( v, _mm_loadu_si128( (const __m128i*)( m + j ) ) ) );
+		}
+		p += pStride;
+		r += n;
+		m += n;
+	}
+
+// the lanes are added in 64 bits, where they cannot overflow
+	_mm_storeu_si128( (__m128i*)lanes, accR );
+	*sumR = (long long)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	_mm_storeu_si128( (__m128i*)lanes, accI );
+	*sumI = (long long)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#else
+	long long	sr = 0, si = 0;
+
+	for ( int i = 0; i < rows; i++ )
+	{
+		for ( int j = 0; j < n; j++ )
+		{
+			sr += p[j] * r[j];
+			si += p[j] * m[j];
+		}
+		p += pStride;
+		r += n;
+		m += n;
+	}
+	*sumR = sr;
+	*sumI = si;
+#endif
+}
@@ -0,0 +1,471 @@
+/*
+	Description:	Long-running service mode: framed requests over a local socket
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <errno.h>
+#include "GaborGlobal.h"
+#include "GaborService.h"
+#include "Utilities.h"
+#include "Profiler.h"
+
+// largest option, fiducial or image block we accept in a request
+#define kMaxRequestBytes	(256 * 1024 * 1024)
+
+static volatile sig_atomic_t	gStopService = 0;
+
+static void StopService( int /*sig*/ )
+{
+	gStopService = 1;
+}
+
+
+// lets PGMImage::Read parse image bytes without copying them
+class MemoryBuffer : public streambuf
+{
+public:
+	MemoryBuffer( char* data, int len ) { setg( data, data, data + len ); }
+};
+
+
+// for qsort() on latency samples
+static int CompareSamples( const void* s1, const void* s2 )
+{
+	long long a1 = *(const long long*)s1;
+	long long a2 = *(const long long*)s2;
+
+	return ( a1 < a2 ) ? -1 : ( a1 > a2 );
+}
+
+
+LatencyStats::LatencyStats()
+{
+	mCapacity = 1024;
+	mCount = 0;
+	mSamples = new long long[mCapacity];
+	pthread_mutex_init( &mLock, NULL );
+}
+
+
+LatencyStats::~LatencyStats()
+{
+	pthread_mutex_destroy( &mLock );
+	delete[] mSamples;
+}
+
+
+// record one latency, growing the sample buffer when needed
+void LatencyStats::Add( long long micros )
+{
+	pthread_mutex_lock( &mLock );
+	if ( mCount == mCapacity )
+	{
+		long long* samples = new long long[2 * mCapacity];
+		memcpy( samples, mSamples, mCount * sizeof(long long) );
+		delete[] mSamples;
+		mSamples = samples;
+		mCapacity = 2 * mCapacity;
+	}
+	mSamples[mCount++] = micros;
+	pthread_mutex_unlock( &mLock );
+}
+
+
+// nearest-rank percentile in milliseconds
+float LatencyStats::Percentile( float p )
+{
+	pthread_mutex_lock( &mLock );
+	int count = mCount;
+	if ( count == 0 )
+	{
+		pthread_mutex_unlock( &mLock );
+		return 0.0;
+	}
+	long long* sorted = new long long[count];
+	memcpy( sorted, mSamples, count * sizeof(long long) );
+	pthread_mutex_unlock( &mLock );
+
+	qsort( sorted, count, sizeof(long long), CompareSamples );
+	int rank = (int)ceil( p / 100.0 * count ) - 1;
+	if ( rank < 0 ) rank = 0;
+	if ( rank >= count ) rank = count - 1;
+	float ms = sorted[rank] / 1000.0;
+
+	delete[] sorted;
+	return ms;
+}
+
+
+void LatencyStats::Report( ostream& os, const char* label )
+{
+	os << label << ": " << mCount << " requests";
+	if ( mCount > 0 )
+	{
+		os << ", latency p50 " << Percentile( 50 ) << " ms";
+		os << ", p90 " << Percentile( 90 ) << " ms";
+		os << ", p99 " << Percentile( 99 ) << " ms";
+		os << ", max " << Percentile( 100 ) << " ms";
+	}
+	os << endl;
+}
+
+
+// read exactly len bytes, false on EOF or error, or when a signal stops the service
+bool ReadFully( int fd, void* buf, int len )
+{
+	char* p = (char*)buf;
+
+	while ( len > 0 )
+	{
+		ssize_t n = read( fd, p, len );
+		if ( n < 0 && errno == EINTR && !gStopService ) continue;
+		if ( n <= 0 ) return false;
+		p += n;
+		len -= n;
+	}
+	return true;
+}
+
+
+// write exactly len bytes
+bool WriteFully( int fd, const void* buf, int len )
+{
+	const char* p = (const char*)buf;
+
+	while ( len > 0 )
+	{
+		ssize_t n = write( fd, p, len );
+		if ( n < 0 && errno == EINTR ) continue;
+		if ( n <= 0 ) return false;
+		p += n;
+		len -= n;
+	}
+	return true;
+}
+
+
+// make sure a request buffer holds len bytes plus a terminating NUL
+static bool ReadBlock( int fd, char** buf, int* capacity, int len )
+{
+	if ( len < 0 || len > kMaxRequestBytes ) return false;
+	if ( *buf == NULL || *capacity < len + 1 )
+	{
+		delete[] *buf;
+		*capacity = len + 1;
+		*buf = new char[*capacity];
+	}
+	(*buf)[len] = '\0';
+	return ReadFully( fd, *buf, len );
+}
+
+
+bool ReadRequest( int fd, GaborRequest* request )
+{
+	GaborRequestHeader	header;
+
+	if ( !ReadFully( fd, &header, sizeof(header) ) ) return false;
+	if ( memcmp( header.magic, kRequestMagic, 4 ) != 0 ) return false;
+
+	request->type = header.type;
+	request->dataLen = header.dataLen;
+	if ( !ReadBlock( fd, &request->options, &request->capacity[0], header.optionsLen ) ) return false;
+	if ( !ReadBlock( fd, &request->fiducials, &request->capacity[1], header.fiducialsLen ) ) return false;
+	if ( !ReadBlock( fd, &request->data, &request->capacity[2], header.dataLen ) ) return false;
+
+	return true;
+}
+
+
+bool WriteRequest( int fd, int type, const char* options, const char* fiducials,
+				   const char* data, int dataLen )
+{
+	GaborRequestHeader	header;
+
+	memcpy( header.magic, kRequestMagic, 4 );
+	header.type = type;
+	header.optionsLen = ( options != NULL ) ? strlen( options ) : 0;
+	header.fiducialsLen = ( fiducials != NULL ) ? strlen( fiducials ) : 0;
+	header.dataLen = ( data != NULL ) ? dataLen : 0;
+
+	return WriteFully( fd, &header, sizeof(header) ) &&
+		   WriteFully( fd, options, header.optionsLen ) &&
+		   WriteFully( fd, fiducials, header.fiducialsLen ) &&
+		   WriteFully( fd, data, header.dataLen );
+}
+
+
+// read a response, growing the caller's float buffer when needed
+bool ReadResponse( int fd, GaborResponseHeader* header, float** response, int* capacity )
+{
+	if ( !ReadFully( fd, header, sizeof(GaborResponseHeader) ) ) return false;
+	if ( memcmp( header->magic, kResponseMagic, 4 ) != 0 ) return false;
+	if ( header->len < 0 || header->len > kMaxRequestBytes / (int)sizeof(float) ) return false;
+
+	if ( *response == NULL || *capacity < header->len )
+	{
+		delete[] *response;
+		*capacity = Max( header->len, 1 );
+		*response = new float[*capacity];
+	}
+	return ReadFully( fd, *response, header->len * sizeof(float) );
+}
+
+
+bool WriteResponse( int fd, int status, const float* response, int len, int micros )
+{
+	GaborResponseHeader	header;
+
+	if ( response == NULL ) len = 0;
+	memcpy( header.magic, kResponseMagic, 4 );
+	header.status = status;
+	header.len = len;
+	header.micros = micros;
+
+	return WriteFully( fd, &header, sizeof(header) ) &&
+		   WriteFully( fd, response, len * sizeof(float) );
+}
+
+
+void DisposeRequest( GaborRequest* request )
+{
+	delete[] request->options;
+	delete[] request->fiducials;
+	delete[] request->data;
+	request->options = request->fiducials = request->data = NULL;
+}
+
+
+// read the image from its path or straight from the request bytes
+bool LoadRequestImage( GaborRequest* request, PGMImage* image )
+{
+	if ( request->type == kRequestImage )
+	{
+		MemoryBuffer	buffer( request->data, request->dataLen );
+		istream			stream( &buffer );
+		return image->Read( stream ) != 0;
+	}
+
+	ifstream	imgFile( request->data );
+	if ( !imgFile ) return false;
+	return image->Read( imgFile ) != 0;
+}
+
+
+// split options in place on white space
+int SplitOptions( char* options, char** argv, int maxArgs )
+{
+	int		argc = 0;
+	char*	last = NULL;
+	char*	token = strtok_r( options, " \t\n", &last );
+
+	while ( token != NULL && argc < maxArgs - 1 )
+	{
+		argv[argc++] = token;
+		token = strtok_r( NULL, " \t\n", &last );
+	}
+	argv[argc] = NULL;
+	return argc;
+}
+
+
+GaborService::GaborService( HandlerFactory factory, int threads )
+{
+	mFactory = factory;
+	mThreads = Max( threads, 1 );
+	mQuit = false;
+	mConns = new int[mThreads];
+	for ( int i = 0; i < mThreads; i++ ) mConns[i] = -1;
+	pthread_mutex_init( &mConnLock, NULL );
+}
+
+
+GaborService::~GaborService()
+{
+	pthread_mutex_destroy( &mConnLock );
+	delete[] mConns;
+}
+
+
+// Note a connection a worker is about to serve, so that HangUp() can wake the worker
+// while it waits for a request. A connection attached after HangUp() sees the stop
+// flags set and is not read from.
+void GaborService::Attach( int conn )
+{
+	pthread_mutex_lock( &mConnLock );
+	for ( int i = 0; i < mThreads; i++ )
+	{
+		if ( mConns[i] != -1 ) continue;
+		mConns[i] = conn;
+		break;
+	}
+	pthread_mutex_unlock( &mConnLock );
+}
+
+
+void GaborService::Detach( int conn )
+{
+	pthread_mutex_lock( &mConnLock );
+	for ( int i = 0; i < mThreads; i++ )
+		if ( mConns[i] == conn ) mConns[i] = -1;
+	pthread_mutex_unlock( &mConnLock );
+}
+
+
+// shut down every connection being served, which ends the reads workers block in
+void GaborService::HangUp( void )
+{
+	pthread_mutex_lock( &mConnLock );
+	for ( int i = 0; i < mThreads; i++ )
+		if ( mConns[i] != -1 ) shutdown( mConns[i], SHUT_RDWR );
+	pthread_mutex_unlock( &mConnLock );
+}
+
+
+// answer the request that was just read
+bool GaborService::Answer( ServiceHandler* handler, GaborRequest* request, int out )
+{
+	long long	start = GetMicroseconds();
+	float		stats[kStatsLen];
+	float*		response = NULL;
+	int			len = 0;
+	int			status = kStatusOK;
+
+	switch ( request->type )
+	{
+		case kRequestPath:
+		case kRequestImage:
+		{
+			response = handler->Serve( request, &len, &status );
+			if ( status == kStatusOK ) mLatency.Add( GetMicroseconds() - start );
+
+			PROFILE_SCOPE( profile, kStageOutput );
+			PROFILE_COUNT( profile, len, 0 );
+			return WriteResponse( out, status, response, len, (int)( GetMicroseconds() - start ) );
+		}
+
+		case kRequestStats:
+			stats[0] = mLatency.GetCount();
+			stats[1] = mLatency.Percentile( 50 );
+			stats[2] = mLatency.Percentile( 90 );
+			stats[3] = mLatency.Percentile( 99 );
+			stats[4] = mLatency.Percentile( 100 );
+			return WriteResponse( out, kStatusOK, stats, kStatsLen, 0 );
+
+		case kRequestQuit:
+			mQuit = true;
+			return WriteResponse( out, kStatusOK, NULL, 0, 0 );
+	}
+	return WriteResponse( out, kStatusBadRequest, NULL, 0, 0 );
+}
+
+
+// handle requests on one connection until it closes
+bool GaborService::Serve( ServiceHandler* handler, int in, int out )
+{
+	GaborRequest	request;
+	bool			ok = true;
+
+	memset( &request, 0, sizeof(request) );
+	while ( ok && !mQuit && !gStopService && ReadRequest( in, &request ) )
+		ok = Answer( handler, &request, out );
+	DisposeRequest( &request );
+	return ok;
+}
+
+
+// each worker owns a handler, and with it a warm processing context
+void* GaborService::Worker( void* service )
+{
+	GaborService*	self = (GaborService*)service;
+	ServiceHandler*	handler = self->mFactory();
+	int				conn;
+
+	while ( self->mQueue.Pop( &conn ) )
+	{
+		self->Attach( conn );
+		self->Serve( handler, conn, conn );
+		self->Detach( conn );
+		close( conn );
+	}
+	delete handler;
+	return NULL;
+}
+
+
+int GaborService::Run( char* path )
+{
+	struct sigaction	action;
+
+// stop cleanly on SIGINT/SIGTERM, and survive clients that hang up
+	memset( &action, 0, sizeof(action) );
+	action.sa_handler = StopService;
+	sigaction( SIGINT, &action, NULL );
+	sigaction( SIGTERM, &action, NULL );
+	signal( SIGPIPE, SIG_IGN );
+
+	if ( strcmp( path, "-" ) == 0 )
+	{
+	// a single stream is answered in order by a single handler; keep stdout 
+	// for responses and route stray console output to stderr
+		ServiceHandler*	handler = mFactory();
+		int				out = dup( 1 );
+		dup2( 2, 1 );
+		cerr << "serving on stdin/stdout" << endl;
+		Serve( handler, 0, out );
+		close( out );
+		delete handler;
+	}
+	else
+	{
+		struct sockaddr_un	addr;
+		pthread_t*			workers;
+		int					sock;
+
+		if ( strlen( path ) >= sizeof(addr.sun_path) )
+		{
+			cerr << "Error: socket path too long: " << path << endl;
+			return 1;
+		}
+		memset( &addr, 0, sizeof(addr) );
+		addr.sun_family = AF_UNIX;
+		strcpy( addr.sun_path, path );
+
+		sock = socket( AF_UNIX, SOCK_STREAM, 0 );
+		unlink( path );
+		if ( sock < 0 || bind( sock, (struct sockaddr*)&addr, sizeof(addr) ) < 0 || listen( sock, 8 ) < 0 )
+		{
+			FileCreateError( path );
+			return 1;
+		}
+		cerr << "serving on socket \"" << path << "\" with " << mThreads << " worker(s)" << endl;
+
+	// connections are handed to the workers; poll so that a quit request is noticed
+		workers = new pthread_t[mThreads];
+		for ( int i = 0; i < mThreads; i++ ) pthread_create( &workers[i], NULL, Worker, this );
+		while ( !mQuit && !gStopService )
+		{
+			struct pollfd	listener = { sock, POLLIN, 0 };
+			if ( poll( &listener, 1, 250 ) <= 0 ) continue;
+			int conn = accept( sock, NULL, NULL );
+			if ( conn >= 0 && !mQueue.Push( conn ) ) close( conn );
+		}
+	// workers waiting on idle clients would never notice the stop
+		mQueue.Close();
+		HangUp();
+		for ( int i = 0; i < mThreads; i++ ) pthread_join( workers[i], NULL );
+		delete[] workers;
+
+		close( sock );
+		unlink( path );
+	}
+
+	mLatency.Report( cerr, "service" );
+	return 0;
+}
@@ -6,6 +6,7 @@
 
 
 #include "ImageFile.h"
+#include "Profiler.h"
 
 ImageFile::ImageFile()
 {
@@ -23,40 +24,48 @@ ImageFile::~ImageFile()
 }
 
 
-// allocate pixel storage
+// allocate pixel storage for the current dimensions. Rows are kept in one piece, and 
+// sets that are already allocated are reused, so reading a series of images of the 
+// same size does not touch the heap.
 void ImageFile::Allocate( int dataset )
 {
 	int i, j;
 
-	if ( dataset & kChars )
+	if ( ( dataset & kChars ) && mPixels == NULL )
 	{	
 		mPixels = new unsigned char*[mHeight];
+		mPixels[0] = new unsigned char[mHeight*mWidth];
+		PROFILE_BYTES( mHeight * ( sizeof(unsigned char*) + mWidth ) );
 		for ( i = 0; i < mHeight; i++ )
 		{
-			mPixels[i] = new unsigned char[mWidth];
+			mPixels[i] = mPixels[0] + i * mWidth;
 			for ( j = 0; j < mWidth; j++ )
 				mPixels[i][j] = 0;
 		}
 	}
-	if ( dataset & kFloats )
+	if ( ( dataset & kFloats ) && mFloats == NULL )
 	{
 		mFloats = new float*[mHeight];
+		mFloats[0] = new float[mHeight*mWidth];
+		PROFILE_BYTES( mHeight * ( sizeof(float*) + mWidth * sizeof(float) ) );
 		for ( i = 0; i < mHeight; i++ )
 		{
-			mFloats[i] = new float[mWidth];
+			mFloats[i] = mFloats[0] + i * mWidth;
 			for ( j = 0; j < mWidth; j++ )
 				mFloats[i][j] = 0.0;
 		}
 	}
-	if ( dataset & kRGB )
+	if ( ( dataset & kRGB ) && mRGB == NULL )
 	{
 		mRGB = new int**[3];
+		PROFILE_BYTES( 3 * mHeight * ( sizeof(int*) + mWidth * sizeof(int) ) );
 		for ( i = 0; i < 3; i++ )
 		{
 			mRGB[i] = new int*[mHeight];
+			mRGB[i][0] = new int[mHeight*mWidth];
 			for ( j = 0; j < mHeight; j++ )
 			{
-				mRGB[i][j] = new int[mWidth];
+				mRGB[i][j] = mRGB[i][0] + j * mWidth;
 				for ( int k = 0; k < mWidth; k++ )
 					mRGB[i][j][k] = 255;
 			}			
@@ -65,31 +74,31 @@ void ImageFile::Allocate( int dataset )
 }
 
 
-// allocate pixel storage
-void ImageFile::Deallocate()
+// free pixel storage
+void ImageFile::Deallocate( int dataset )
 {
-	int i;
-	
-	if ( mPixels != NULL )
+	if ( ( dataset & kChars ) && mPixels != NULL )
 	{
-    	for ( i = 0; i < mHeight; i++ )
-    		delete[] mPixels[i];
-		 delete[] mPixels; 
+		delete[] mPixels[0];
+		delete[] mPixels; 
+		mPixels = NULL;
 	}
-	if ( mFloats != NULL )
+	if ( ( dataset & kFloats ) && mFloats != NULL )
 	{
-    	for ( i = 0; i < mHeight; i++ )
-    		delete[] mFloats[i];
-		 delete[] mFloats; 
+		delete[] mFloats[0];
+		delete[] mFloats; 
+		mFloats = NULL;
 	}
-	if ( mRGB == NULL ) return;
-	for ( i = 0; i < 3; i++ )
+	if ( ( dataset & kRGB ) && mRGB != NULL )
 	{
-		for ( int j = 0; j < mHeight; j++ )
-			delete[] mRGB[i][j];
-		delete[] mRGB[i];
-	}	
-	delete[] mRGB;
+		for ( int i = 0; i < 3; i++ )
+		{
+			delete[] mRGB[i][0];
+			delete[] mRGB[i];
+		}	
+		delete[] mRGB;
+		mRGB = NULL;
+	}
 }
 
 
@@ -5,17 +5,32 @@
 */
 
 #include "LogPolar.h"
+#include "Profiler.h"
 
-// construct class and apply filter
-LogPolar::LogPolar( float** img, int height, int width, int minS, int ry, int rx )
+// construct class and apply filter; the output images come from arena if given
+LogPolar::LogPolar( float** img, int height, int width, int minS, int ry, int rx, Arena* arena )
 {
 	mImgHeight = height;
 	mImgWidth = width;
 	mHeight = ry;
 	mWidth = rx;
 	mMinHW = minS;
+	mArena = arena;
+
+	PROFILE_SCOPE( profile, kStageLogPolar );
+	PROFILE_COUNT( profile, mHeight * mWidth, 9 * mHeight * mWidth );
 	
+	if ( mArena != NULL )
+	{
+		mPolarized = mArena->NewMatrix( (float)0.0, mHeight, mWidth );
+		mCoords = mArena->NewMatrix( (float)0.0, mImgHeight, mImgWidth );
+		ApplyFilter( img, height, width );
+		return;
+	}
+
 	// allocate output image
+	PROFILE_BYTES( mHeight * ( sizeof(float*) + mWidth * sizeof(float) ) + 
+				   mImgHeight * ( sizeof(float*) + mImgWidth * sizeof(float) ) );
 	mPolarized = new float*[mHeight];
 	for ( int i = 0; i < mHeight; i++ )
 	{
@@ -39,6 +54,7 @@ LogPolar::LogPolar( float** img, int height, int width, int minS, int ry, int rx
 // free memory
 LogPolar::~LogPolar()
 {
+	if ( mArena != NULL ) return;
 	if( mCoords != NULL )
 	{
 		for( int y = 0; y < mImgHeight; y++ )
@@ -79,6 +95,10 @@ void LogPolar::ApplyFilter( float** img, int height, int width )
 			f = (int)(y) + (int)height/2;  
 			g = (int)(x) + (int)width/2;
 
+		// the outer ring can round to the image border, keep the 3 x 3 sum inside
+			f = Max( 1, Min( f, height - 2 ) );
+			g = Max( 1, Min( g, width - 2 ) );
+
 			sum = 0.0;
 			for( i = f-1; i <= f+1; i++ )
 				for( j = g-1; j <= g+1; j++ )
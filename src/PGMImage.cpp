@@ -5,12 +5,38 @@
 */
 
 #include "PGMImage.h"
+#include "Profiler.h"
+
+PGMImage::PGMImage()
+{
+	mGrayDecode = false;
+	mGrayConversion = kGrayRMS;
+	mGrayDecoded = false;
+	mRow = NULL;
+	mRowSize = 0;
+}
+
+
+PGMImage::PGMImage( char* file )
+{
+	mGrayDecode = false;
+	mGrayConversion = kGrayRMS;
+	mGrayDecoded = false;
+	mRow = NULL;
+	mRowSize = 0;
+	Read( file );
+}
+
+
+PGMImage::~PGMImage()
+{
+	delete[] mRow;
+}
+
 
 // read PGM image from file
 int PGMImage::Read( char* file )
 {
-	int			i,j;
-	char		buf[256];
 	ifstream	imgFile( file );
 
 	if ( !imgFile ) // Invalid FileName
@@ -21,17 +47,50 @@ int PGMImage::Read( char* file )
 	}
 	if ( mVerbosity ) cerr << "reading image from file \"" << file << "\"" << endl;
 
+	int ok = Read( imgFile );
+	imgFile.close();
+
+	return ok;
+}
+
+
+// read PGM image from an open stream, e.g. a memory buffer or a pipe
+int PGMImage::Read( istream& imgFile )
+{
+	int			i,j;
+	int			width, height;
+	char		buf[256];
+
+	PROFILE_SCOPE( profile, kStageDecode );
+
+	mGrayDecoded = false;
+
 // get file type
-	imgFile.getline( mMagicNumber, 256 );
+	imgFile.getline( buf, 256 );
+	if ( !imgFile || buf[0] != 'P' || buf[1] < '1' || buf[1] > '6' )
+	{
+		Deallocate();
+		return 0;
+	}
+	mMagicNumber[0] = buf[0];
+	mMagicNumber[1] = buf[1];
 
 // ignore comments
 	imgFile.getline( buf, 256 );
 	while ( buf[0] == '#' ) imgFile.getline( buf, 256 );
 	
 // get dimensions of image
-	mWidth = atoi( buf );
-	mHeight = atoi( strpbrk( buf, " \t" ) );
+	char* sep = strpbrk( buf, " \t" );
+	width = ( sep != NULL ) ? atoi( buf ) : 0;
+	height = ( sep != NULL ) ? atoi( sep ) : 0;
+
+// keep the storage of a previous image of the same size, drop it otherwise
+	if ( width != mWidth || height != mHeight || width <= 0 || height <= 0 ) Deallocate();
+	mWidth = width;
+	mHeight = height;
+	if ( mWidth <= 0 || mHeight <= 0 ) return 0;
 	mNumPixels = mWidth * mHeight;
+	PROFILE_COUNT( profile, mNumPixels, 0 );
 
 // get color levels
 	if ( mMagicNumber[1] == '1' || mMagicNumber[1] == '4' )
@@ -52,6 +111,7 @@ int PGMImage::Read( char* file )
 	if ( mMagicNumber[1] == '5' || mMagicNumber[1] == '2' )	  // GrayScale
 	{
 	// allocate pixel storage
+		Deallocate( kRGB );
 		Allocate( kChars );
 
 		if ( mMagicNumber[1] == '5' )		// RAWBITs
@@ -74,10 +134,48 @@ int PGMImage::Read( char* file )
 			}
 		}
 	}
+	else if ( ( mMagicNumber[1] == '6' || mMagicNumber[1] == '3' ) && mGrayDecode ) // RGB to gray
+	{
+	// rows are converted as they are read, straight into the float pixels
+		Deallocate( kChars | kRGB );
+		Allocate( kFloats );
+		if ( mRowSize < 3 * mWidth )
+		{
+			delete[] mRow;
+			mRowSize = 3 * mWidth;
+			mRow = new unsigned char[mRowSize];
+		}
+
+		if ( mMagicNumber[1] == '6' )	// RAWBITs
+		{
+			if ( mVerbosity ) cerr << "RGB RAWBITs PPM format to gray]";
+			for ( i = 0; i < mHeight; i++ )
+			{
+				imgFile.read( (char *)mRow, 3 * mWidth );
+				ConvertRowToGray( mRow, mFloats[i], mWidth, mGrayConversion );
+			}
+		}
+		else							// ASCII
+		{
+			if ( mVerbosity ) cerr << "RGB ASCII PPM format to gray]";
+			for ( i = 0; i < mHeight; i++ )
+			{
+				for ( j = 0; j < 3 * mWidth; j++ )
+				{
+					int pix;
+					imgFile >> pix;
+					mRow[j] = (unsigned char)( pix / pow( 2, mNumBits-8 ) );
+				}
+				ConvertRowToGray( mRow, mFloats[i], mWidth, mGrayConversion );
+			}
+		}
+		mGrayDecoded = true;
+	}
 	else if ( mMagicNumber[1] == '6' || mMagicNumber[1] == '3' ) // RGB
 	{
 		unsigned char rgb[3];
 	// allocate rgb pixel storage
+		Deallocate( kChars | kFloats );
 		Allocate( kRGB );
 		
 		if ( mMagicNumber[1] == '6' )	// RAWBITs
@@ -107,6 +205,7 @@ int PGMImage::Read( char* file )
 	else if ( mMagicNumber[1] == '4' || mMagicNumber[1] == '1' ) // Binary
 	{
 	// allocate pixel storage
+		Deallocate( kRGB );
 		Allocate( kChars );
 
 		if ( mMagicNumber[1] == '4' )		// RAWBITs
@@ -145,7 +244,15 @@ int PGMImage::Read( char* file )
 		}
 	}
 
-	imgFile.close();
+// grayscale pixels are handed on as floats when decoding to gray
+	if ( mGrayDecode && !mGrayDecoded )
+	{
+		Allocate( kFloats );
+		for ( i = 0; i < mHeight; i++ )
+			for ( j = 0; j < mWidth; j++ )
+				mFloats[i][j] = (float)mPixels[i][j];
+		mGrayDecoded = true;
+	}
 
 	if ( mVerbosity )
 	{
@@ -0,0 +1,228 @@
+/*
+	Description:	Processing pipeline described at runtime
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include "Pipeline.h"
+#include "ContrastFilter.h"
+#include "LogPolar.h"
+
+const char*	gPipeStageNames[kNumPipeStages] = { "decode", "gray", "luma", "rgb", "opponent", 
+														  "contrast", "logpolar", "gabor" };
+
+
+// apply the contrast filter, its contrast map lives in the arena
+void ContrastStage::Process( StageBuffer* in, StageBuffer* out, Arena* arena, char* file )
+{
+	ContrastFilter	contrastFilter( in->pixels, in->height, in->width, arena );
+	if ( file != NULL )
+	{
+		contrastFilter.SetFileName( file );
+		contrastFilter.Save();					// save contrast image
+	}
+	out->pixels = contrastFilter.GetContrast();	// get contrast map
+	out->width  = contrastFilter.GetWidth();	// obtain contrast dimensions
+	out->height = contrastFilter.GetHeight();
+}
+
+
+// apply the log-polar transform, its output lives in the arena
+void LogPolarStage::Process( StageBuffer* in, StageBuffer* out, Arena* arena, char* file )
+{
+	int	minHW = Min( in->height, in->width );
+	LogPolar	logPolar( in->pixels, in->height, in->width, minHW, in->height/2, in->width/3, arena );
+	if ( file != NULL )
+	{
+		logPolar.SetFileName( file );
+		logPolar.Save( true );				// save log-polar image
+	}
+	out->pixels = logPolar.GetPolars();		// get log-polar map
+	out->width  = logPolar.GetWidth();		// obtain polar dimensions
+	out->height = logPolar.GetHeight();
+}
+
+
+Pipeline::Pipeline()
+{
+	mDesc[0] = '\0';
+	mColorSpace = kPipeGray;
+	mNumStages = 0;
+	mCache = NULL;
+	mGeneration = -1;
+	mChannel = 0;
+}
+
+
+Pipeline::~Pipeline()
+{
+	Dispose();
+}
+
+
+void Pipeline::Dispose( void )
+{
+	for ( int i = 0; i < mNumStages; i++ ) delete mStages[i];
+	mNumStages = 0;
+}
+
+
+// set up the stages of a description such as "decode,gray,contrast,gabor"
+bool Pipeline::Parse( const char* desc )
+{
+	char	copy[256];
+	char*	name;
+	char*	last;
+	int		kinds[kMaxStages];
+	int		numStages = 0;
+	int		converted = -1;		// color space once given
+	bool	ended = false;		// gabor was given
+	bool	first = true;
+	int		kind, i;
+
+	if ( strcmp( desc, mDesc ) == 0 && desc[0] != '\0' ) return true;
+	if ( strlen( desc ) >= sizeof(copy) ) return false;
+	strcpy( copy, desc );
+
+	for ( name = strtok_r( copy, ",", &last ); name != NULL; name = strtok_r( NULL, ",", &last ) )
+	{
+		for ( kind = 0; kind < kNumPipeStages; kind++ )
+			if ( strcmp( name, gPipeStageNames[kind] ) == 0 ) break;
+		if ( kind == kNumPipeStages || ended ) return false;
+
+		switch ( kind )
+		{
+			case kPipeDecode:
+				if ( !first ) return false;
+				break;
+			case kPipeGray:
+			case kPipeLuma:
+			case kPipeColor:
+			case kPipeOpponent:
+				if ( converted >= 0 || numStages > 0 ) return false;
+				converted = kind;
+				break;
+			case kPipeGabor:
+				ended = true;
+				break;
+			default:
+				if ( numStages == kMaxStages ) return false;
+				kinds[numStages++] = kind;
+		}
+		first = false;
+	}
+
+// replace the stages in use
+	Dispose();
+	strcpy( mDesc, desc );
+	mColorSpace = ( converted >= 0 ) ? converted : kPipeGray;
+	for ( i = 0; i < numStages; i++ )
+	{
+		mKinds[i] = kinds[i];
+		if ( kinds[i] == kPipeContrast )
+			mStages[i] = new ContrastStage;
+		else
+			mStages[i] = new LogPolarStage;
+	}
+	mNumStages = numStages;
+	return true;
+}
+
+
+bool Pipeline::Has( int stage )
+{
+	switch ( stage )
+	{
+		case kPipeDecode:
+		case kPipeGabor:
+			return true;
+		case kPipeGray:
+		case kPipeLuma:
+		case kPipeColor:
+		case kPipeOpponent:
+			return mColorSpace == stage;
+	}
+	for ( int i = 0; i < mNumStages; i++ )
+		if ( mKinds[i] == stage ) return true;
+	return false;
+}
+
+
+// run a channel through the map stages, each of which hands on a matrix of its own
+void Pipeline::Process( StageBuffer* buffer, Arena* arena, char* file )
+{
+	bool	cached = ( mCache != NULL && file == NULL && mNumStages > 0 );
+
+	if ( cached )
+	{
+		if ( mGeneration != mCache->GetGeneration() )
+		{
+			mGeneration = mCache->GetGeneration();
+			mChannel = 0;
+		}
+		if ( mCache->Find( mDesc, mChannel, buffer ) )
+		{
+			mChannel++;
+			return;
+		}
+	}
+	for ( int i = 0; i < mNumStages; i++ ) mStages[i]->Process( buffer, buffer, arena, file );
+	if ( cached ) mCache->Store( mDesc, mChannel++, buffer );
+}
+
+
+// follow the image dimensions through the map stages
+void Pipeline::GetOutputSize( int* h, int* w )
+{
+	for ( int i = 0; i < mNumStages; i++ ) mStages[i]->GetOutputSize( h, w );
+}
+
+
+MapCache::MapCache()
+{
+	mNumMaps = 0;
+	mGeneration = 0;
+	mNumStored = 0;
+	mNumFound = 0;
+}
+
+
+void MapCache::Clear( void )
+{
+	mArena.Reset();
+	mNumMaps = 0;
+	mGeneration++;
+}
+
+
+bool MapCache::Find( const char* desc, int channel, StageBuffer* map )
+{
+	for ( int i = 0; i < mNumMaps; i++ )
+	{
+		if ( mChannels[i] == channel && strcmp( mDescs[i], desc ) == 0 )
+		{
+			*map = mMaps[i];
+			mNumFound++;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void MapCache::Store( const char* desc, int channel, StageBuffer* map )
+{
+	StageBuffer*	copy;
+
+	if ( mNumMaps == kMaxCachedMaps ) return;
+	copy = &mMaps[mNumMaps];
+	copy->height = map->height;
+	copy->width = map->width;
+	copy->pixels = mArena.NewMatrix( map->height, map->width );
+	for ( int i = 0; i < map->height; i++ )
+		memcpy( copy->pixels[i], map->pixels[i], map->width * sizeof(float) );
+	strcpy( mDescs[mNumMaps], desc );
+	mChannels[mNumMaps] = channel;
+	mNumMaps++;
+	mNumStored++;
+}
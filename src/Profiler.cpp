@@ -0,0 +1,391 @@
+/*
+	Description:	Scoped timers and counters around the stages of the processing pipeline
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "Profiler.h"
+#include "Utilities.h"
+
+const char*		gStageNames[kNumStages] = { "decode", "gray", "contrast", "logpolar",
+											"filterbank", "jet", "output" };
+
+// floating point operations per filter tap: a multiply-add, for the real and 
+// imaginary part in the jet
+const int		gFlopsPerTap[kNumStages] = { 0, 0, 2, 1, 0, 4, 0 };
+
+// stages that hardware counters are sampled around
+const bool		gCountedStages[kNumStages] = { true, false, true, false, false, true, false };
+
+bool			Profiler::sEnabled = false;
+bool			Profiler::sTrace = false;
+bool			Profiler::sCounters = false;
+char			Profiler::sCounterError[128] = "";
+bool			Profiler::sSummary = false;
+char			Profiler::sTraceFile[256] = "";
+long long		Profiler::sOrigin = 0;
+ProfileThread*	Profiler::sThreads = NULL;
+int				Profiler::sNumThreads = 0;
+pthread_key_t	Profiler::sKey;
+pthread_mutex_t	Profiler::sLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+// call once, before the threads that are to be profiled start
+void Profiler::Enable( bool trace, bool counters )
+{
+	if ( sEnabled ) return;
+	pthread_key_create( &sKey, NULL );
+	sTrace = trace;
+	sCounters = counters;
+	sOrigin = GetNanoseconds();
+	sEnabled = true;
+}
+
+
+void Profiler::Start( bool summary, char* traceFile, bool counters )
+{
+	if ( !summary && !counters && traceFile[0] == '\0' ) return;
+	sSummary = summary || counters;
+	strcpy( sTraceFile, traceFile );
+	Enable( traceFile[0] != '\0', counters );
+	atexit( Finish );
+}
+
+
+// runs on exit, once every worker has been joined
+void Profiler::Finish( void )
+{
+	if ( sSummary ) Report( cerr );
+	if ( sTraceFile[0] != '\0' ) WriteTrace( sTraceFile );
+}
+
+
+long long Profiler::GetNanoseconds( void )
+{
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// the recording buffer of the calling thread, created on first use. Buffers stay
+// around after their thread ends, so that Report() can still merge them.
+ProfileThread* Profiler::GetThread( void )
+{
+	ProfileThread*	thread = (ProfileThread*)pthread_getspecific( sKey );
+
+	if ( thread != NULL ) return thread;
+
+	thread = new ProfileThread;
+	memset( thread, 0, sizeof(ProfileThread) );
+	if ( sTrace ) thread->events = new TraceEvent[kMaxTraceEvents];
+	OpenCounters( thread );
+	pthread_setspecific( sKey, thread );
+
+	pthread_mutex_lock( &sLock );
+	thread->id = ++sNumThreads;
+	thread->next = sThreads;
+	sThreads = thread;
+	pthread_mutex_unlock( &sLock );
+	return thread;
+}
+
+
+// open a group of hardware counters for the calling thread, user space only. Events
+// the processor lacks are left out; without cycles there is no group at all, which is 
+// the usual case in containers and virtual machines.
+void Profiler::OpenCounters( ProfileThread* thread )
+{
+	thread->perfFd = -1;
+	for ( int c = 0; c < kNumCounters; c++ ) thread->perfIndex[c] = -1;
+	if ( !sCounters ) return;
+
+#ifdef __linux__
+	struct perf_event_attr	attr;
+	const unsigned long long	l1d = PERF_COUNT_HW_CACHE_L1D | ( PERF_COUNT_HW_CACHE_OP_READ << 8 );
+	const unsigned long long	configs[kNumCounters][2] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HW_CACHE, l1d | ( PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16 ) },
+		{ PERF_TYPE_HW_CACHE, l1d | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 ) },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES } };
+	int		opened = 0;
+
+	for ( int c = 0; c < kNumCounters; c++ )
+	{
+		memset( &attr, 0, sizeof(attr) );
+		attr.size = sizeof(attr);
+		attr.type = configs[c][0];
+		attr.config = configs[c][1];
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | 
+						   PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		int fd = syscall( __NR_perf_event_open, &attr, 0, -1, thread->perfFd, 0 );
+		if ( fd < 0 )
+		{
+			if ( c > 0 ) continue;
+			pthread_mutex_lock( &sLock );
+			if ( sCounterError[0] == '\0' ) strcpy( sCounterError, strerror( errno ) );
+			pthread_mutex_unlock( &sLock );
+			return;
+		}
+		if ( c == 0 ) thread->perfFd = fd;
+		thread->perfIndex[c] = opened++;
+	}
+#else
+	strcpy( sCounterError, "not supported on this system" );
+#endif
+}
+
+
+// current counts of the group, scaled up if the kernel had to multiplex it. Returns 
+// false if nothing is sampled for this stage.
+bool Profiler::ReadCounters( ProfileThread* thread, int stage, long long* values )
+{
+	unsigned long long	buf[3 + kNumCounters];
+
+	if ( thread->perfFd < 0 || !gCountedStages[stage] ) return false;
+	if ( read( thread->perfFd, buf, sizeof(buf) ) < (int)( 3 * sizeof(long long) ) ) return false;
+
+// buf holds the number of events, time enabled, time running and the values
+	double scale = ( buf[2] > 0 && buf[2] < buf[1] ) ? (double)buf[1] / buf[2] : 1.0;
+	for ( int c = 0; c < kNumCounters; c++ )
+		values[c] = ( thread->perfIndex[c] < 0 ) ? 0 : (long long)( buf[3 + thread->perfIndex[c]] * scale );
+	return true;
+}
+
+
+void Profiler::CountBytes( long long bytes )
+{
+	if ( !sEnabled ) return;
+
+	ProfileThread* thread = (ProfileThread*)pthread_getspecific( sKey );
+	if ( thread != NULL && thread->current != NULL ) thread->current->AddBytes( bytes );
+}
+
+
+void Profiler::Record( ProfileThread* thread, int stage, long long start, long long nanos,
+					   long long pixels, long long taps, long long bytes, long long* counters )
+{
+	StageStats*	stats = &thread->stages[stage];
+	long long	micros = nanos / 1000;
+	int			b = 0;
+
+	stats->calls++;
+	stats->nanos += nanos;
+	stats->pixels += pixels;
+	stats->taps += taps;
+	stats->bytes += bytes;
+	while ( micros > 1 && b < kNumBuckets - 1 )
+	{
+		micros >>= 1;
+		b++;
+	}
+	stats->buckets[b]++;
+	if ( counters != NULL )
+		for ( int c = 0; c < kNumCounters; c++ ) stats->counters[c] += counters[c];
+
+	if ( !sTrace ) return;
+	if ( thread->numEvents == kMaxTraceEvents )
+	{
+		thread->dropped++;
+		return;
+	}
+	TraceEvent*	event = &thread->events[thread->numEvents++];
+	event->stage = stage;
+	event->start = start - sOrigin;
+	event->nanos = nanos;
+	event->pixels = pixels;
+	event->taps = taps;
+	event->bytes = bytes;
+}
+
+
+// sum the stages over all threads
+void Profiler::Merge( StageStats* total )
+{
+	memset( total, 0, kNumStages * sizeof(StageStats) );
+	for ( ProfileThread* thread = sThreads; thread != NULL; thread = thread->next )
+	{
+		for ( int s = 0; s < kNumStages; s++ )
+		{
+			StageStats* stats = &thread->stages[s];
+			total[s].calls += stats->calls;
+			total[s].nanos += stats->nanos;
+			total[s].pixels += stats->pixels;
+			total[s].taps += stats->taps;
+			total[s].bytes += stats->bytes;
+			for ( int b = 0; b < kNumBuckets; b++ ) total[s].buckets[b] += stats->buckets[b];
+			for ( int c = 0; c < kNumCounters; c++ ) total[s].counters[c] += stats->counters[c];
+		}
+	}
+}
+
+
+// upper bound of the histogram bucket holding the p-th percentile, in microseconds
+float Profiler::Percentile( StageStats* stats, float p )
+{
+	long long	rank = (long long)( p / 100.0 * stats->calls + 0.5 );
+	long long	seen = 0;
+
+	for ( int b = 0; b < kNumBuckets; b++ )
+	{
+		seen += stats->buckets[b];
+		if ( seen >= rank && seen > 0 ) return (float)( 2LL << b );
+	}
+	return 0.0;
+}
+
+
+// a table with one line per stage that was seen
+void Profiler::Report( ostream& os )
+{
+	StageStats	total[kNumStages];
+	char		line[256];
+	long long	dropped = 0;
+
+	if ( !sEnabled ) return;
+	Merge( total );
+
+	os << "# stage          calls   total ms    mean us  p50<= us  p99<= us     Mpixels      Gtaps   Gtaps/s   MB alloc" << endl;
+	for ( int s = 0; s < kNumStages; s++ )
+	{
+		StageStats* stats = &total[s];
+		if ( stats->calls == 0 ) continue;
+		sprintf( line, "  %-12s %7lld %10.2f %10.1f %9.0f %9.0f %11.3f %10.3f %9.3f %10.2f",
+				 gStageNames[s], stats->calls, stats->nanos * 1e-6,
+				 stats->nanos * 1e-3 / stats->calls, Percentile( stats, 50 ),
+				 Percentile( stats, 99 ), stats->pixels * 1e-6, stats->taps * 1e-9,
+				 ( stats->nanos > 0 ) ? (double)stats->taps / stats->nanos : 0.0,
+				 stats->bytes / ( 1024.0 * 1024.0 ) );
+		os << line << endl;
+	}
+	for ( ProfileThread* thread = sThreads; thread != NULL; thread = thread->next )
+		dropped += thread->dropped;
+	if ( dropped > 0 ) os << "# " << dropped << " trace events dropped" << endl;
+	if ( sCounters ) ReportCounters( os, total );
+}
+
+
+// metrics derived from the hardware counters of the sampled stages. Without counters
+// only the achieved GFLOP/s can be given, from wall time.
+void Profiler::ReportCounters( ostream& os, StageStats* total )
+{
+	bool	hardware = ( sCounterError[0] == '\0' );
+	char	line[256];
+	char	ipc[16], traffic[16], l1[16], llc[16];
+
+	if ( hardware )
+		os << "# hardware counters, user space only" << endl;
+	else
+		os << "# hardware counters unavailable (" << sCounterError << "), wall time only" << endl;
+	os << "# stage          GFLOP/s      IPC  bytes/pixel  L1 miss %  LLC miss %" << endl;
+
+	for ( int s = 0; s < kNumStages; s++ )
+	{
+		StageStats*	stats = &total[s];
+		long long*	n = stats->counters;
+		if ( stats->calls == 0 || !gCountedStages[s] ) continue;
+
+		strcpy( ipc, "n/a" );
+		strcpy( traffic, "n/a" );
+		strcpy( l1, "n/a" );
+		strcpy( llc, "n/a" );
+		if ( hardware && n[kCounterCycles] > 0 )
+			sprintf( ipc, "%.2f", (double)n[kCounterInstructions] / n[kCounterCycles] );
+		if ( hardware && stats->pixels > 0 && n[kCounterLLCRefs] > 0 )
+			sprintf( traffic, "%.2f", (double)n[kCounterLLCMisses] * kCacheLine / stats->pixels );
+		if ( hardware && n[kCounterL1Loads] > 0 )
+			sprintf( l1, "%.2f", 100.0 * n[kCounterL1Misses] / n[kCounterL1Loads] );
+		if ( hardware && n[kCounterLLCRefs] > 0 )
+			sprintf( llc, "%.2f", 100.0 * n[kCounterLLCMisses] / n[kCounterLLCRefs] );
+
+		sprintf( line, "  %-12s %9.3f %8s %12s %10s %11s", gStageNames[s],
+				 ( stats->nanos > 0 ) ? (double)stats->taps * gFlopsPerTap[s] / stats->nanos : 0.0,
+				 ipc, traffic, l1, llc );
+		os << line << endl;
+	}
+}
+
+
+// complete events in the Chrome trace-event format, one track per thread
+bool Profiler::WriteTrace( char* file )
+{
+	ofstream	outfile( file );
+	bool		first = true;
+	char		line[256];
+
+	if ( !outfile )
+	{
+		FileCreateError( file );
+		return false;
+	}
+
+	outfile << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << endl;
+	for ( ProfileThread* thread = sThreads; thread != NULL; thread = thread->next )
+	{
+		sprintf( line, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+					   "\"args\":{\"name\":\"thread %d\"}}", thread->id, thread->id );
+		outfile << ( first ? "" : ",\n" ) << line;
+		first = false;
+
+		for ( int i = 0; i < thread->numEvents; i++ )
+		{
+			TraceEvent* event = &thread->events[i];
+			sprintf( line, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+						   "\"args\":{\"pixels\":%lld,\"taps\":%lld,\"bytes\":%lld}}",
+					 gStageNames[event->stage], thread->id, event->start * 1e-3,
+					 event->nanos * 1e-3, event->pixels, event->taps, event->bytes );
+			outfile << line;
+		}
+	}
+	outfile << endl << "]}" << endl;
+	return true;
+}
+
+
+ProfileScope::ProfileScope( int stage )
+{
+	mThread = NULL;
+	mPixels = 0;
+	mTaps = 0;
+	mBytes = 0;
+	if ( !Profiler::IsEnabled() ) return;
+
+	mThread = Profiler::GetThread();
+	mParent = mThread->current;
+	mThread->current = this;
+	mStage = stage;
+	mCounted = Profiler::ReadCounters( mThread, stage, mCounters );
+	mStart = Profiler::GetNanoseconds();
+}
+
+
+ProfileScope::~ProfileScope()
+{
+	if ( mThread == NULL ) return;
+
+	long long	nanos = Profiler::GetNanoseconds() - mStart;
+	long long	counters[kNumCounters];
+
+	if ( mCounted && Profiler::ReadCounters( mThread, mStage, counters ) )
+		for ( int c = 0; c < kNumCounters; c++ ) counters[c] -= mCounters[c];
+	else
+		mCounted = false;
+
+	mThread->current = mParent;
+	Profiler::Record( mThread, mStage, mStart, nanos, mPixels, mTaps, mBytes, 
+					  mCounted ? counters : NULL );
+}
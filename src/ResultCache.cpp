@@ -0,0 +1,400 @@
+/*
+	Description:	A cache of response vectors on disk, shared between processes
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <time.h>
+#include "ResultCache.h"
+#include "GaborService.h"
+#include "Utilities.h"
+
+
+// FNV-1a, a word at a time for speed. A multiply only carries bits upwards, so the high
+// half is folded back after each one, or a difference in the top bit of two words
+// could cancel out.
+uint64_t HashBytes( const void* data, size_t bytes, uint64_t hash )
+{
+	const unsigned char*	p = (const unsigned char*)data;
+	uint64_t				word;
+
+	for ( ; bytes >= 8; bytes -= 8, p += 8 )
+	{
+		memcpy( &word, p, 8 );
+		hash = ( hash ^ word ) * kHashPrime;
+		hash ^= hash >> 32;
+	}
+	for ( ; bytes > 0; bytes--, p++ ) hash = ( hash ^ *p ) * kHashPrime;
+	return hash;
+}
+
+
+uint64_t HashString( const char* text, uint64_t hash )
+{
+	return HashBytes( text, strlen( text ), hash );
+}
+
+
+// an entry on disk, while evicting
+struct CacheFile
+{
+	char		name[kCacheMaxName];
+	off_t		size;
+	double		used;		// time of the last lookup or of the store
+};
+
+
+static int CompareUse( const void* a, const void* b )
+{
+	double	ua = ((const CacheFile*)a)->used;
+	double	ub = ((const CacheFile*)b)->used;
+
+	return ( ua < ub ) ? -1 : ( ua > ub ) ? 1 : 0;
+}
+
+
+ResultCache::ResultCache()
+{
+	mDir[0] = '\0';
+	mMaxBytes = 0;
+	mNumHits = 0;
+	mNumMisses = 0;
+	mNumStored = 0;
+	mPendingHits = 0;
+	mPendingMisses = 0;
+	pthread_mutex_init( &mMutex, NULL );
+}
+
+
+ResultCache::~ResultCache()
+{
+	ResultCacheStats	stats;
+
+// the counts of lookups since the last store go into the stats file
+	if ( mPendingHits + mPendingMisses > 0 ) GetStats( &stats );
+	pthread_mutex_destroy( &mMutex );
+}
+
+
+bool ResultCache::Open( const char* dir, long long maxBytes )
+{
+	ResultCacheStats	stats;
+	struct stat			info;
+	int					fd;
+
+	mDir[0] = '\0';
+	if ( strlen( dir ) + kCacheMaxName >= sizeof(mDir) )
+	{
+		cerr << "cache directory name longer than " << sizeof(mDir) - kCacheMaxName - 1 << " characters" << endl;
+		return false;
+	}
+	if ( mkdir( dir, 0777 ) != 0 && errno != EEXIST )
+	{
+		cerr << "cannot make cache directory \"" << dir << "\"" << endl;
+		return false;
+	}
+	if ( stat( dir, &info ) != 0 || !S_ISDIR( info.st_mode ) )
+	{
+		cerr << "\"" << dir << "\" is not a directory" << endl;
+		return false;
+	}
+	snprintf( mDir, sizeof(mDir), "%s", dir );
+	mMaxBytes = maxBytes;
+
+// make the stats file, if this is the first process to use the directory
+	if ( ( fd = Lock( &stats ) ) < 0 )
+	{
+		cerr << "cannot lock the stats of cache \"" << dir << "\"" << endl;
+		mDir[0] = '\0';
+		return false;
+	}
+	Unlock( fd, &stats );
+	return true;
+}
+
+
+// the hash of the size, the kind of pixels and the pixels themselves; rows are hashed
+// one by one since PGMImage does not promise to keep them together
+void ResultCache::MakeKey( PGMImage* image, uint64_t params, ResultCacheKey* key )
+{
+	float**		gray = image->GetGrayPixels();
+	int***		rgb = image->GetRGBPixels();
+	int			h = image->GetHeight(), w = image->GetWidth();
+	int			shape[3] = { h, w, gray != NULL };
+	uint64_t	hash = HashBytes( shape, sizeof(shape) );
+
+	if ( gray != NULL )
+	{
+		for ( int i = 0; i < h; i++ ) hash = HashBytes( gray[i], w * sizeof(float), hash );
+	}
+	else if ( rgb != NULL )
+	{
+		for ( int c = 0; c < 3; c++ )
+			for ( int i = 0; i < h; i++ ) hash = HashBytes( rgb[c][i], w * sizeof(int), hash );
+	}
+	key->pixels = hash;
+	key->params = params;
+}
+
+
+// the path of a file of the cache in path, which holds FILENAME_MAX characters; false
+// if it does not fit, which Open() sees to for the names used here
+bool ResultCache::MakePath( const char* name, char* path )
+{
+	int		n = snprintf( path, FILENAME_MAX, "%s/%s", mDir, name );
+
+	return n >= 0 && n < FILENAME_MAX;
+}
+
+
+bool ResultCache::EntryPath( const ResultCacheKey& key, char* path )
+{
+	char	name[kCacheMaxName];
+
+	snprintf( name, sizeof(name), "%016llx%016llx%s", (unsigned long long)key.pixels,
+			  (unsigned long long)key.params, kCacheSuffix );
+	return MakePath( name, path );
+}
+
+
+// lock the stats file, which is made if need be, and read it into stats; returns the
+// descriptor to unlock it with, or -1
+int ResultCache::Lock( ResultCacheStats* stats )
+{
+	char	path[FILENAME_MAX];
+	int		fd;
+
+	if ( !MakePath( kCacheStats, path ) ) return -1;
+	fd = open( path, O_RDWR | O_CREAT, 0666 );
+	if ( fd < 0 ) return -1;
+	while ( flock( fd, LOCK_EX ) != 0 )
+	{
+		if ( errno != EINTR )
+		{
+			close( fd );
+			return -1;
+		}
+	}
+	if ( pread( fd, stats, sizeof(ResultCacheStats), 0 ) != sizeof(ResultCacheStats) ||
+		 memcmp( stats->magic, kCacheMagic, 4 ) != 0 )
+	{
+		memset( stats, 0, sizeof(ResultCacheStats) );
+		memcpy( stats->magic, kCacheMagic, 4 );
+	}
+	return fd;
+}
+
+
+// write stats back and unlock them
+void ResultCache::Unlock( int fd, ResultCacheStats* stats )
+{
+	if ( pwrite( fd, stats, sizeof(ResultCacheStats), 0 ) != sizeof(ResultCacheStats) )
+		cerr << "cannot write the stats of cache \"" << mDir << "\"" << endl;
+	close( fd );	// releases the lock
+}
+
+
+// count lookups in memory only, so that they never wait on other processes
+void ResultCache::Count( int hits, int misses )
+{
+	pthread_mutex_lock( &mMutex );
+	mNumHits += hits;
+	mNumMisses += misses;
+	mPendingHits += hits;
+	mPendingMisses += misses;
+	pthread_mutex_unlock( &mMutex );
+}
+
+
+// move the counts of lookups not yet in the stats file into stats, which are locked
+void ResultCache::AddPending( ResultCacheStats* stats )
+{
+	pthread_mutex_lock( &mMutex );
+	stats->hits += mPendingHits;
+	stats->misses += mPendingMisses;
+	mPendingHits = 0;
+	mPendingMisses = 0;
+	pthread_mutex_unlock( &mMutex );
+}
+
+
+// see ResultCache.h
+float* ResultCache::Lookup( const ResultCacheKey& key, int* len )
+{
+	char				path[FILENAME_MAX];
+	ResultCacheEntry	header;
+	struct stat			info;
+	float*				response = NULL;
+	int					fd;
+
+	*len = 0;
+	if ( !IsOpen() || !EntryPath( key, path ) ) return NULL;
+	fd = open( path, O_RDONLY );
+	if ( fd >= 0 )
+	{
+	// a damaged entry is a miss, and is replaced by the next store
+		if ( ReadFully( fd, &header, sizeof(header) ) && memcmp( header.magic, kCacheMagic, 4 ) == 0 &&
+			 header.pixels == key.pixels && header.params == key.params && header.len > 0 &&
+			 fstat( fd, &info ) == 0 && info.st_size == (off_t)( sizeof(header) + header.len * sizeof(float) ) )
+		{
+			response = new float[header.len];
+			if ( ReadFully( fd, response, header.len * sizeof(float) ) )
+			{
+				*len = header.len;
+				futimens( fd, NULL );	// the use that eviction goes by
+			}
+			else
+			{
+				delete[] response;
+				response = NULL;
+			}
+		}
+		close( fd );
+		if ( response == NULL ) unlink( path );
+	}
+	Count( response != NULL, response == NULL );
+	return response;
+}
+
+
+// see ResultCache.h
+void ResultCache::Store( const ResultCacheKey& key, const float* response, int len )
+{
+	char				path[FILENAME_MAX];
+	char				temp[FILENAME_MAX];
+	ResultCacheEntry	header;
+	ResultCacheStats	stats;
+	long long			size = sizeof(header) + (long long)len * sizeof(float);
+	bool				written;
+	int					fd;
+
+// an entry over the cap would only evict all others
+	if ( !IsOpen() || response == NULL || len <= 0 || size > mMaxBytes ) return;
+
+// write it out of sight first
+	if ( !MakePath( "tmp.XXXXXX", temp ) || !EntryPath( key, path ) ) return;
+	fd = mkstemp( temp );
+	if ( fd < 0 ) return;
+	memcpy( header.magic, kCacheMagic, 4 );
+	header.len = len;
+	header.pixels = key.pixels;
+	header.params = key.params;
+	written = fchmod( fd, 0644 ) == 0 && WriteFully( fd, &header, sizeof(header) ) &&
+			  WriteFully( fd, response, len * sizeof(float) );
+	if ( close( fd ) != 0 ) written = false;
+	if ( !written || ( fd = Lock( &stats ) ) < 0 )
+	{
+		unlink( temp );
+		return;
+	}
+
+// then move it into place, unless another process got there first
+	AddPending( &stats );
+	if ( access( path, F_OK ) == 0 ) unlink( temp );
+	else if ( rename( temp, path ) != 0 ) unlink( temp );
+	else
+	{
+		stats.bytes += size;
+		stats.entries++;
+		pthread_mutex_lock( &mMutex );
+		mNumStored++;
+		pthread_mutex_unlock( &mMutex );
+	}
+	if ( stats.bytes > mMaxBytes ) Evict( &stats );
+	Unlock( fd, &stats );
+}
+
+
+// Remove the least recently used entries until they hold no more than kCacheLowWater
+// of the cap, with the stats locked. The sizes are summed from the directory itself,
+// which puts right any count a crashed process left behind, and temporary files of
+// such a process are removed as well.
+void ResultCache::Evict( ResultCacheStats* stats )
+{
+	char			path[FILENAME_MAX];
+	DIR*			dir = opendir( mDir );
+	struct dirent*	entry;
+	struct stat		info;
+	CacheFile*		files = NULL;
+	CacheFile*		more;
+	int				numFiles = 0, capacity = 0, removed = 0;
+	long long		total = 0;
+	size_t			nameLen, suffixLen = strlen( kCacheSuffix );
+	time_t			now = time( NULL );
+
+	if ( dir == NULL ) return;
+	while ( ( entry = readdir( dir ) ) != NULL )
+	{
+	// no name of ours is longer than an entry's, as Open() made room for
+		nameLen = strlen( entry->d_name );
+		if ( nameLen >= sizeof(files->name) || !MakePath( entry->d_name, path ) ) continue;
+		if ( strncmp( entry->d_name, "tmp.", 4 ) == 0 )
+		{
+			if ( stat( path, &info ) == 0 && now - info.st_mtime > kCacheStaleTemp ) unlink( path );
+			continue;
+		}
+		if ( nameLen <= suffixLen || strcmp( entry->d_name + nameLen - suffixLen, kCacheSuffix ) != 0 ||
+			 stat( path, &info ) != 0 ) continue;
+		if ( numFiles == capacity )
+		{
+			capacity = ( capacity == 0 ) ? 256 : 2 * capacity;
+			more = new CacheFile[capacity];
+			if ( numFiles > 0 ) memcpy( more, files, numFiles * sizeof(CacheFile) );
+			delete[] files;
+			files = more;
+		}
+		strcpy( files[numFiles].name, entry->d_name );
+		files[numFiles].size = info.st_size;
+		files[numFiles].used = info.st_mtim.tv_sec + 1e-9 * info.st_mtim.tv_nsec;
+		total += info.st_size;
+		numFiles++;
+	}
+	closedir( dir );
+
+	qsort( files, numFiles, sizeof(CacheFile), CompareUse );
+	for ( int i = 0; i < numFiles && total > kCacheLowWater * mMaxBytes; i++ )
+	{
+		if ( !MakePath( files[i].name, path ) || unlink( path ) != 0 ) continue;
+		total -= files[i].size;
+		removed++;
+	}
+	stats->bytes = total;
+	stats->entries = numFiles - removed;
+	stats->evicted += removed;
+	delete[] files;
+}
+
+
+bool ResultCache::GetStats( ResultCacheStats* stats )
+{
+	int		fd;
+
+	if ( !IsOpen() || ( fd = Lock( stats ) ) < 0 ) return false;
+	AddPending( stats );
+	Unlock( fd, stats );
+	return true;
+}
+
+
+void ResultCache::PrintStats( ostream& out )
+{
+	ResultCacheStats	stats;
+	int					lookups = mNumHits + mNumMisses;
+
+	out << "cache: " << mNumHits << " of " << lookups << " images found";
+	if ( lookups > 0 ) out << " (" << 100 * mNumHits / lookups << "%)";
+	out << ", " << mNumStored << " stored" << endl;
+	if ( !GetStats( &stats ) ) return;
+	lookups = stats.hits + stats.misses;
+	out << "cache, all processes: " << stats.hits << " of " << lookups << " images found";
+	if ( lookups > 0 ) out << " (" << 100 * stats.hits / lookups << "%)";
+	out << ", " << stats.entries << " entries of " << ( stats.bytes + 1023 ) / 1024 << " kB, " 
+		<< stats.evicted << " evicted" << endl;
+}
@@ -0,0 +1,114 @@
+/*
+	Description:	Parameter sweeps
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include "GaborGlobal.h"
+#include "Sweep.h"
+#include "Utilities.h"
+
+
+// Split a line into its words, and each word into its alternatives, in place. Words
+// get firsts[w] to firsts[w+1] of alts. Returns the number of words.
+static int SplitAlternatives( char* line, char** alts, int* firsts, int maxAlts )
+{
+	int		numWords = 0, numAlts = 0;
+	char*	last = NULL;
+	char*	word = strtok_r( line, " \t\r\n", &last );
+	char*	p;
+
+	while ( word != NULL && numAlts < maxAlts )
+	{
+		firsts[numWords++] = numAlts;
+		alts[numAlts++] = word;
+		for ( p = word; *p != '\0' && numAlts < maxAlts; p++ )
+		{
+			if ( *p != kSweepSeparator ) continue;
+			*p = '\0';
+			alts[numAlts++] = p + 1;
+		}
+		word = strtok_r( NULL, " \t\r\n", &last );
+	}
+	firsts[numWords] = numAlts;
+	return numWords;
+}
+
+
+bool ReadSweep( char* path, char*** sets, int* numSets )
+{
+	ifstream	infile;
+	char		line[kMaxSweepLine];
+	char		set[kMaxSweepLine];
+	char*		alts[kMaxSweepLine];
+	char*		chosen[kMaxSweepLine];
+	int			firsts[kMaxSweepLine+1];
+	int			numWords, count, choice, n, w, k;
+	char*		comment;
+
+	infile.open( path );
+	if ( infile.fail() )
+	{
+		FileOpenError( path );
+		return false;
+	}
+	*sets = new char*[kMaxSweepSets];
+	*numSets = 0;
+
+	while ( infile.getline( line, kMaxSweepLine ) )
+	{
+		if ( ( comment = strchr( line, '#' ) ) != NULL ) *comment = '\0';
+		numWords = SplitAlternatives( line, alts, firsts, kMaxSweepLine );
+		if ( numWords == 0 ) continue;
+
+		count = 1;
+		for ( w = 0; w < numWords && count <= kMaxSweepSets; w++ ) count *= firsts[w+1] - firsts[w];
+		if ( *numSets + count > kMaxSweepSets )
+		{
+			cerr << path << " stands for more than " << kMaxSweepSets << " parameter sets" << endl;
+			DisposeSweep( *sets, *numSets );
+			return false;
+		}
+
+	// every combination of the alternatives, the last word changing fastest; none is 
+	// longer than the line
+		for ( k = 0; k < count; k++ )
+		{
+			choice = k;
+			for ( w = numWords - 1; w >= 0; w-- )
+			{
+				n = firsts[w+1] - firsts[w];
+				chosen[w] = alts[firsts[w] + choice % n];
+				choice /= n;
+			}
+			set[0] = '\0';
+			for ( w = 0; w < numWords; w++ )
+			{
+				if ( w > 0 ) strcat( set, " " );
+				strcat( set, chosen[w] );
+			}
+			(*sets)[*numSets] = new char[strlen( set ) + 1];
+			strcpy( (*sets)[(*numSets)++], set );
+		}
+	}
+	if ( !infile.eof() )
+	{
+		cerr << path << " has a line longer than " << kMaxSweepLine - 1 << " characters" << endl;
+		DisposeSweep( *sets, *numSets );
+		return false;
+	}
+	if ( *numSets == 0 )
+	{
+		cerr << path << " holds no parameter sets" << endl;
+		DisposeSweep( *sets, 0 );
+		return false;
+	}
+	return true;
+}
+
+
+void DisposeSweep( char** sets, int numSets )
+{
+	for ( int i = 0; i < numSets; i++ ) delete[] sets[i];
+	delete[] sets;
+}
@@ -7,7 +7,13 @@
 #include	<math.h>
 #include	<unistd.h>
 #include	<stdlib.h>
+#include	<time.h>
 #include	"Utilities.h"
+#include	"Profiler.h"
+#include	"GaborKernels.h"
+#if kUseSSE2 && defined(__SSE2__)
+#include	<emmintrin.h>
+#endif
 
 long	gPrecision;
 long	gWidth;
@@ -133,6 +139,130 @@ void DisposeMatrix( float** matrix, int row )
 }
 
 
+// grayscale value of one rgb pixel
+static inline float GrayValue( int r, int g, int b, int conversion )
+{
+	if ( conversion == kGrayLuma ) return 0.299f * r + 0.587f * g + 0.114f * b;
+	return sqrt( (float)( r*r + g*g + b*b ) ) / sqrt( 3.0 );
+}
+
+
+// Convert rgb planes to grayscale, by default as the root mean square of the three channels
+void ConvertToGray( int*** rgb, float** gray, int h, int w, int conversion )
+{
+	PROFILE_SCOPE( profile, kStageGray );
+	PROFILE_COUNT( profile, h * w, 0 );
+
+	for ( int i = 0; i < h; i++ )
+		for ( int j = 0; j < w; j++ )
+			gray[i][j] = GrayValue( rgb[0][i][j], rgb[1][i][j], rgb[2][i][j], conversion );
+}
+
+
+// As above for interleaved rgb values
+void ConvertToGray( int* rgb, float** gray, int h, int w, int conversion )
+{
+	int	k = 0;
+
+	PROFILE_SCOPE( profile, kStageGray );
+	PROFILE_COUNT( profile, h * w, 0 );
+
+	for ( int i = 0; i < h; i++ )
+	{
+		for ( int j = 0; j < w; j++ )
+		{
+			gray[i][j] = GrayValue( rgb[k], rgb[k+1], rgb[k+2], conversion );
+			k = k + 3;
+		}
+	}
+}
+
+
+// Convert a row of w interleaved rgb bytes, as stored in a PPM file, to grayscale. With 
+// SSE2 four pixels are done at once; the root mean square is still taken in float and
+// divided in double, so the values are those of ConvertToGray.
+void ConvertRowToGray( const unsigned char* rgb, float* gray, int w, int conversion )
+{
+	int	j = 0;
+
+#if kUseSSE2 && defined(__SSE2__)
+	const __m128	lumaR = _mm_set1_ps( 0.299f );
+	const __m128	lumaG = _mm_set1_ps( 0.587f );
+	const __m128	lumaB = _mm_set1_ps( 0.114f );
+	const __m128d	root3 = _mm_set1_pd( sqrt( 3.0 ) );
+
+	for ( ; j + 4 <= w; j += 4, rgb += 12 )
+	{
+		__m128	r = _mm_set_ps( rgb[9], rgb[6], rgb[3], rgb[0] );
+		__m128	g = _mm_set_ps( rgb[10], rgb[7], rgb[4], rgb[1] );
+		__m128	b = _mm_set_ps( rgb[11], rgb[8], rgb[5], rgb[2] );
+		if ( conversion == kGrayLuma )
+		{
+			__m128	y = _mm_add_ps( _mm_add_ps( _mm_mul_ps( lumaR, r ), _mm_mul_ps( lumaG, g ) ),
+									_mm_mul_ps( lumaB, b ) );
+			_mm_storeu_ps( gray + j, y );
+		}
+		else
+		{
+		// sums of squares are below 2^24 and so exact in float
+			__m128	s = _mm_add_ps( _mm_add_ps( _mm_mul_ps( r, r ), _mm_mul_ps( g, g ) ),
+									_mm_mul_ps( b, b ) );
+			s = _mm_sqrt_ps( s );
+			__m128d	lo = _mm_div_pd( _mm_cvtps_pd( s ), root3 );
+			__m128d	hi = _mm_div_pd( _mm_cvtps_pd( _mm_movehl_ps( s, s ) ), root3 );
+			_mm_storeu_ps( gray + j, _mm_movelh_ps( _mm_cvtpd_ps( lo ), _mm_cvtpd_ps( hi ) ) );
+		}
+	}
+#endif
+	for ( ; j < w; j++, rgb += 3 ) gray[j] = GrayValue( rgb[0], rgb[1], rgb[2], conversion );
+}
+
+
+// Convert rgb planes to an opponent color space: luminance, red-green and blue-yellow
+void ConvertToOpponent( int*** rgb, float** channels[3], int h, int w )
+{
+	PROFILE_SCOPE( profile, kStageGray );
+	PROFILE_COUNT( profile, h * w, 0 );
+
+	for ( int i = 0; i < h; i++ )
+	{
+		for ( int j = 0; j < w; j++ )
+		{
+			float	r = rgb[0][i][j];
+			float	g = rgb[1][i][j];
+			float	b = rgb[2][i][j];
+			channels[0][i][j] = ( r + g + b ) / 3.0f;
+			channels[1][i][j] = r - g;
+			channels[2][i][j] = b - ( r + g ) / 2.0f;
+		}
+	}
+}
+
+
+// As above for interleaved rgb values
+void ConvertToOpponent( int* rgb, float** channels[3], int h, int w )
+{
+	int	k = 0;
+
+	PROFILE_SCOPE( profile, kStageGray );
+	PROFILE_COUNT( profile, h * w, 0 );
+
+	for ( int i = 0; i < h; i++ )
+	{
+		for ( int j = 0; j < w; j++ )
+		{
+			float	r = rgb[k];
+			float	g = rgb[k+1];
+			float	b = rgb[k+2];
+			channels[0][i][j] = ( r + g + b ) / 3.0f;
+			channels[1][i][j] = r - g;
+			channels[2][i][j] = b - ( r + g ) / 2.0f;
+			k = k + 3;
+		}
+	}
+}
+
+
 // Returns Euclidean distance between two vectors
 float ReturnDistance( float *pat1, float *pat2, int size ) 
 {
@@ -144,8 +274,50 @@ float ReturnDistance( float *pat1, float *pat2, int size )
 	return (float)( sqrt( dist ) / sqrt( (float)size ) );
 }
 
+// Read command line options from a file into text, which holds size characters, and 
+// split them into argv as from the command line. Lines starting with # are skipped.
+// Returns the number of options, or -1 if the file cannot be read or is too long.
+int ReadOptionFile( char* file, char* text, int size, char** argv, int maxArgs )
+{
+	ifstream	infile( file );
+	char		line[256];
+	char*		token;
+	char*		last;
+	int			argc = 0, used = 0;
+
+	if ( !infile ) return -1;
+	while ( infile.getline( line, sizeof(line) ) )
+	{
+		if ( line[0] == '#' ) continue;
+		for ( token = strtok_r( line, " \t\r", &last ); token != NULL; token = strtok_r( NULL, " \t\r", &last ) )
+		{
+			if ( argc == maxArgs - 1 || used + (int)strlen( token ) + 1 > size ) return -1;
+			argv[argc++] = strcpy( text + used, token );
+			used += strlen( token ) + 1;
+		}
+	}
+	if ( !infile.eof() ) return -1;		// a line was too long
+	argv[argc] = NULL;
+	return argc;
+}
+
+
+// Copy the value of an option into a field of size characters. Returns false, with a
+// message, if it does not fit, since options may come from service clients.
+bool CopyOption( char* field, size_t size, const char* option, const char* value )
+{
+	if ( strlen( value ) >= size )
+	{
+		cerr << "value of " << option << " longer than " << size - 1 << " characters" << endl;
+		return false;
+	}
+	strcpy( field, value );
+	return true;
+}
+
+
 // For file reading purposes. Skips blanks and lines starting with #
-void SkipComments( ifstream* infile )
+void SkipComments( istream* infile )
 {
 	bool garbage = true;
 	char c;
@@ -156,7 +328,7 @@ void SkipComments( ifstream* infile )
 		while ( infile->peek() == '\n' || infile->peek() == ' ' || infile->peek() == '\t' ) 
 			infile->get();	
 		while ( infile->peek() == '#' )infile->ignore( 1000, '\n' );
-		infile->get(c);
+		if ( !infile->get(c) ) return;	// nothing left to read
 		if ( c == '\n' || c == '\t' || c == ' ' || c == '#' )
 			garbage = true;
 		else
@@ -217,6 +389,16 @@ void SetStreamDefaults( ostream &os )
 }
 
 
+// monotonic wall clock in microseconds, for timing requests and stages
+long long GetMicroseconds( void )
+{
+	struct timespec	ts;
+	
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
 // return absolute value
 
 double SafeAbs( double val1, double val2 )
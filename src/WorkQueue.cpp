@@ -0,0 +1,93 @@
+/*
+	Description:	Bounded, thread-safe queue of work items shared by worker threads
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include "WorkQueue.h"
+
+WorkQueue::WorkQueue( int capacity )
+{
+	mCapacity = capacity;
+	mItems = new int[mCapacity];
+	mHead = 0;
+	mCount = 0;
+	mClosed = false;
+	pthread_mutex_init( &mLock, NULL );
+	pthread_cond_init( &mNotEmpty, NULL );
+	pthread_cond_init( &mNotFull, NULL );
+}
+
+
+WorkQueue::~WorkQueue()
+{
+	pthread_cond_destroy( &mNotFull );
+	pthread_cond_destroy( &mNotEmpty );
+	pthread_mutex_destroy( &mLock );
+	delete[] mItems;
+}
+
+
+bool WorkQueue::Push( int item )
+{
+	pthread_mutex_lock( &mLock );
+	while ( mCount == mCapacity && !mClosed ) pthread_cond_wait( &mNotFull, &mLock );
+	if ( mClosed )
+	{
+		pthread_mutex_unlock( &mLock );
+		return false;
+	}
+	mItems[( mHead + mCount ) % mCapacity] = item;
+	mCount++;
+	pthread_cond_signal( &mNotEmpty );
+	pthread_mutex_unlock( &mLock );
+	return true;
+}
+
+
+bool WorkQueue::PushOrDrop( int item, int* dropped )
+{
+	bool	full;
+
+	pthread_mutex_lock( &mLock );
+	full = ( mCount == mCapacity );
+	if ( full )
+	{
+		*dropped = mItems[mHead];
+		mHead = ( mHead + 1 ) % mCapacity;
+		mCount--;
+	}
+	mItems[( mHead + mCount ) % mCapacity] = item;
+	mCount++;
+	pthread_cond_signal( &mNotEmpty );
+	pthread_mutex_unlock( &mLock );
+	return full;
+}
+
+
+bool WorkQueue::Pop( int* item )
+{
+	pthread_mutex_lock( &mLock );
+	while ( mCount == 0 && !mClosed ) pthread_cond_wait( &mNotEmpty, &mLock );
+	if ( mCount == 0 )
+	{
+		pthread_mutex_unlock( &mLock );
+		return false;
+	}
+	*item = mItems[mHead];
+	mHead = ( mHead + 1 ) % mCapacity;
+	mCount--;
+	pthread_cond_signal( &mNotFull );
+	pthread_mutex_unlock( &mLock );
+	return true;
+}
+
+
+void WorkQueue::Close( void )
+{
+	pthread_mutex_lock( &mLock );
+	mClosed = true;
+	pthread_cond_broadcast( &mNotEmpty );
+	pthread_cond_broadcast( &mNotFull );
+	pthread_mutex_unlock( &mLock );
+}
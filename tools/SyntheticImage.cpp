@@ -0,0 +1,113 @@
+/*
+	Description:	Deterministic synthetic test images
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include <sstream>
+#include "GaborGlobal.h"
+#include "Utilities.h"
+#include "SyntheticImage.h"
+
+// small linear congruential generator, so the noise does not depend on the C library
+static unsigned int NextRandom( unsigned int* state )
+{
+	*state = *state * 1664525 + 1013904223;
+	return *state >> 8;
+}
+
+
+int*** CreateSyntheticRGB( int h, int w, unsigned int seed )
+{
+	unsigned int	state = seed;
+	int***			rgb = new int**[3];
+	float			cy = 0.45 * h, cx = 0.55 * w;
+	float			radius = 0.3 * Min( h, w );
+
+	for ( int c = 0; c < 3; c++ ) rgb[c] = CreateMatrix( (int)0, h, w );
+
+	for ( int i = 0; i < h; i++ )
+	{
+		for ( int j = 0; j < w; j++ )
+		{
+			float	dy = i - cy, dx = j - cx;
+			float	disk = ( dx*dx + dy*dy < radius*radius ) ? 50.0 : -20.0;
+			float	base = 110.0 + disk + 45.0 * sin( 0.21 * j + 0.07 * i ) 
+										+ 30.0 * cos( 0.05 * j - 0.17 * i );
+
+			for ( int c = 0; c < 3; c++ )
+			{
+				int v = (int)( base + 15.0 * c ) + (int)( NextRandom( &state ) % 31 ) - 15;
+				rgb[c][i][j] = Max( 0, Min( 255, v ) );
+			}
+		}
+	}
+	return rgb;
+}
+
+
+void DisposeSyntheticRGB( int*** rgb, int h )
+{
+	for ( int c = 0; c < 3; c++ ) DisposeMatrix( rgb[c], h );
+	delete[] rgb;
+}
+
+
+int* CreateSyntheticInterleaved( int*** rgb, int h, int w )
+{
+	int*	data = new int[h*w*3];
+	int		k = 0;
+
+	for ( int i = 0; i < h; i++ )
+		for ( int j = 0; j < w; j++ )
+			for ( int c = 0; c < 3; c++ ) data[k++] = rgb[c][i][j];
+	return data;
+}
+
+
+char* EncodeSyntheticImage( int*** rgb, int h, int w, char magic, int* len )
+{
+	ostringstream	out;
+	bool			raw = ( magic >= '4' );
+	int				i, j;
+
+	out << 'P' << magic << endl;
+	out << "# synthetic image" << endl;
+	out << w << " " << h << endl;
+	if ( magic != '1' && magic != '4' ) out << 255 << endl;
+
+	for ( i = 0; i < h; i++ )
+	{
+		for ( j = 0; j < w; j++ )
+		{
+			int r = rgb[0][i][j], g = rgb[1][i][j], b = rgb[2][i][j];
+			int gray = ( r + g + b ) / 3;
+
+			if ( magic == '3' )
+				out << r << " " << g << " " << b << " ";
+			else if ( magic == '6' )
+				out << (char)r << (char)g << (char)b;
+			else if ( magic == '2' )
+				out << gray << " ";
+			else if ( magic == '5' )
+				out << (char)gray;
+			else if ( magic == '1' )
+				out << ( gray < 128 ) << " ";
+			else if ( j % 8 == 0 )		// '4', eight pixels to a byte
+			{
+				int bits = 0;
+				for ( int k = 0; k < 8; k++ )
+					if ( j + k < w && ( rgb[0][i][j+k] + rgb[1][i][j+k] + rgb[2][i][j+k] ) / 3 < 128 )
+						bits |= 0x80 >> k;
+				out << (char)bits;
+			}
+		}
+		if ( !raw ) out << endl;
+	}
+
+	string	bytes = out.str();
+	char*	data = new char[bytes.size()];
+	memcpy( data, bytes.data(), bytes.size() );
+	*len = (int)bytes.size();
+	return data;
+}
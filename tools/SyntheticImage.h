@@ -0,0 +1,23 @@
+/*
+	Description:	Deterministic synthetic test images, so that benchmarks and checks 
+					do not depend on external data
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#ifndef __SYNTHETIC_IMAGE__
+#define __SYNTHETIC_IMAGE__
+
+// rgb planes of h x w pixels: a mix of oriented gratings, a soft disk and noise from 
+// a fixed seed. The same seed always gives the same image. Dispose with DisposeSyntheticRGB.
+int***		CreateSyntheticRGB( int h, int w, unsigned int seed );
+void		DisposeSyntheticRGB( int*** rgb, int h );
+
+// interleaved rgb values of the same image, as piped from a camera; dispose with delete[]
+int*		CreateSyntheticInterleaved( int*** rgb, int h, int w );
+
+// encode rgb planes as a PBM/PGM/PPM file in memory, magic being '1' to '6'. 
+// Returns the bytes, to be disposed with delete[], and their number in len.
+char*		EncodeSyntheticImage( int*** rgb, int h, int w, char magic, int* len );
+
+#endif
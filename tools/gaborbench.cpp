@@ -0,0 +1,656 @@
+/*
+	Description:	Microbenchmarks for the hot paths of the Gabor API. Every kernel runs on
+					deterministic synthetic images across image sizes, filter sizes, angle
+					and frequency counts and thread counts. Results go out as JSON with
+					ns/pixel and GFLOP/s per case. Built once per library variant, as the
+					global and local GaborJet cannot be linked into one executable.
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "GaborGlobal.h"
+#include "GaborJet.h"
+#include "GaborFilter.h"
+#include "ContrastFilter.h"
+#include "LogPolar.h"
+#include "PGMImage.h"
+#include "Arena.h"
+#include "Utilities.h"
+#include "SyntheticImage.h"
+
+// set by the Makefile when building against the fiducial library
+#ifndef kBenchLocal
+#define kBenchLocal		0
+#endif
+
+#define kSeed			20030401	// seed of the synthetic images
+#define kTrials			3			// timed trials per case, the best one is reported
+#define kNumLocs		16			// fiducials of the local jet, on a 4 x 4 grid
+#define kSigma			2.0			// sigma modulator of the filters
+#define kMinFreq		0.25
+#define kMaxFreq		1.5
+
+// one benchmark case
+struct BenchParams
+{
+	const char*	kernel;		// name in the output
+	int			height;		// image size
+	int			width;
+	char		magic;		// image format for the decoder
+	int			filter;		// filter window, in pixels per side
+	int			angles;
+	int			freqs;
+	int			threads;
+	int			engine;		// convolution engine of the jet
+	int			layout;		// layout of the global jet's responses
+	int			border;		// border policy of the global jet
+	bool		color;		// the global jet filters three channels at once
+	bool		gray;		// the decoder converts color straight to grayscale
+	bool		untiled;	// the global jet filters one window at a time
+};
+
+// a kernel holds its own input and output, so that each thread runs its own instance
+class Kernel
+{
+public:
+
+	Kernel() { mPixels = 0; mFlops = 0; mBytes = 0; }
+	virtual ~Kernel() {}
+
+	virtual void	Run( void ) = 0;
+
+	double			mPixels;	// pixels (or filter taps) per run
+	double			mFlops;		// floating point operations per run
+	double			mBytes;		// bytes each run reads and writes at least once, 0 if not counted
+};
+
+typedef Kernel* (*KernelFactory)( BenchParams* params );
+
+// what a timing thread runs
+struct Worker
+{
+	Kernel*		kernel;
+	int			reps;
+};
+
+// lets PGMImage::Read parse image bytes without copying them
+class MemoryBuffer : public streambuf
+{
+public:
+	MemoryBuffer( char* data, int len ) { setg( data, data, data + len ); }
+};
+
+
+// GLOBALS
+double		gMinTime = 0.1;		//	-T	: seconds each trial should at least take
+int			gMaxThreads = 4;	//	-t	: highest thread count to measure
+bool		gQuick = false;		//	-q	: small sweep, for a smoke test
+ostream*	gOut = &cout;		//	-o	: where the JSON goes
+bool		gFirstResult = true;
+
+// PROTOTYPES
+void		Measure( KernelFactory factory, BenchParams* params );
+void*		RunWorker( void* worker );
+float**		CreateInput( int h, int w, bool contrast );
+void		Usage( void );
+
+
+// decoding a PBM/PGM/PPM image from memory
+class ReadKernel : public Kernel
+{
+public:
+
+	ReadKernel( BenchParams* p )
+	{
+		int*** rgb = CreateSyntheticRGB( p->height, p->width, kSeed );
+		mData = EncodeSyntheticImage( rgb, p->height, p->width, p->magic, &mLen );
+		DisposeSyntheticRGB( rgb, p->height );
+		mImage.SetVerbosity( false );
+		mImage.SetGrayDecode( p->gray );
+		mPixels = (double)p->height * p->width;
+	}
+	~ReadKernel() { delete[] mData; }
+
+	void Run( void )
+	{
+		MemoryBuffer	buffer( mData, mLen );
+		istream			stream( &buffer );
+		mImage.Read( stream );
+	}
+
+protected:
+
+	char*		mData;
+	int			mLen;
+	PGMImage	mImage;
+};
+
+
+// rgb planes to grayscale
+class GrayKernel : public Kernel
+{
+public:
+
+	GrayKernel( BenchParams* p )
+	{
+		mHeight = p->height;
+		mWidth = p->width;
+		mRGB = CreateSyntheticRGB( mHeight, mWidth, kSeed );
+		mGray = CreateMatrix( (float)0.0, mHeight, mWidth );
+		mPixels = (double)mHeight * mWidth;
+		mFlops = 7.0 * mPixels;		// 3 mul, 2 add, sqrt, div
+	}
+	~GrayKernel() { DisposeSyntheticRGB( mRGB, mHeight ); DisposeMatrix( mGray, mHeight ); }
+
+	void Run( void ) { ConvertToGray( mRGB, mGray, mHeight, mWidth ); }
+
+protected:
+
+	int***		mRGB;
+	float**		mGray;
+	int			mHeight, mWidth;
+};
+
+
+// the 9 x 9 contrast filter
+class ContrastKernel : public Kernel
+{
+public:
+
+	ContrastKernel( BenchParams* p )
+	{
+		mHeight = p->height;
+		mWidth = p->width;
+		mImage = CreateInput( mHeight, mWidth, false );
+		mFilter = new ContrastFilter( mImage, mHeight, mWidth, &mArena );
+		mPixels = (double)mHeight * mWidth;
+		mFlops = 2.0 * 81 * ( mHeight - 8 ) * ( mWidth - 8 );
+	}
+	~ContrastKernel() { delete mFilter; DisposeMatrix( mImage, mHeight ); }
+
+	void Run( void ) { mFilter->ApplyFilter( mImage, mHeight, mWidth ); }
+
+protected:
+
+	Arena			mArena;
+	ContrastFilter*	mFilter;
+	float**			mImage;
+	int				mHeight, mWidth;
+};
+
+
+// the log-polar transform, with the output size used by the global variant
+class LogPolarKernel : public Kernel
+{
+public:
+
+	LogPolarKernel( BenchParams* p )
+	{
+		mHeight = p->height;
+		mWidth = p->width;
+		mImage = CreateInput( mHeight, mWidth, false );
+		mFilter = new LogPolar( mImage, mHeight, mWidth, Min( mHeight, mWidth ),
+								mHeight/2, mWidth/3, &mArena );
+		mPixels = (double)mHeight * mWidth;
+	// per output pixel: rho and theta, the sampling point, the 3 x 3 sum and its average,
+	// counting each call to the math library as one operation
+		mFlops = 20.0 * ( mHeight / 2 ) * ( mWidth / 3 );
+	}
+	~LogPolarKernel() { delete mFilter; DisposeMatrix( mImage, mHeight ); }
+
+	void Run( void ) { mFilter->ApplyFilter( mImage, mHeight, mWidth ); }
+
+protected:
+
+	Arena			mArena;
+	LogPolar*		mFilter;
+	float**			mImage;
+	int				mHeight, mWidth;
+};
+
+
+// building a bank of angles x freqs filters
+class FilterInitKernel : public Kernel
+{
+public:
+
+	FilterInitKernel( BenchParams* p )
+	{
+		mFilter = p->filter;
+		mAngles = p->angles;
+		mFreqs = p->freqs;
+		mBank = new GaborFilter[mAngles * mFreqs];
+		mPixels = (double)mAngles * mFreqs * mFilter * mFilter;	// filter taps
+		mFlops = 21.0 * mPixels;	// per tap, counting each call to the math library as one
+	}
+	~FilterInitKernel() { delete[] mBank; }
+
+	void Run( void )
+	{
+		for ( int a = 0; a < mAngles; a++ )
+		{
+			float angle = (float)a * M_PI / (float)mAngles;
+			for ( int f = 0; f < mFreqs; f++ )
+			{
+				float freq = kMinFreq + ( f * ( kMaxFreq - kMinFreq ) ) / (float)mFreqs;
+			#if kBenchLocal
+				mBank[a*mFreqs+f].Initialize( mFilter / 2, angle, freq, kSigma * M_PI * M_PI );
+			#else
+				mBank[a*mFreqs+f].Initialize( mFilter, mFilter, angle, freq, kSigma * M_PI * M_PI );
+			#endif
+			}
+		}
+	}
+
+protected:
+
+	GaborFilter*	mBank;
+	int				mFilter, mAngles, mFreqs;
+};
+
+
+// GaborJet::Filter on a contrast map, the way the processing contexts call it
+class JetKernel : public Kernel
+{
+public:
+
+	JetKernel( BenchParams* p )
+	{
+		mHeight = p->height - 8;
+		mWidth = p->width - 8;
+		mImage = CreateInput( p->height, p->width, true );
+		mPixels = (double)p->height * p->width;
+	#if kBenchLocal
+		int radius = p->filter / 2;
+		mLocs = CreateMatrix( (int)0, kNumLocs, 2 );
+		for ( int i = 0; i < kNumLocs; i++ )
+		{
+			mLocs[i][0] = mWidth * ( i % 4 + 1 ) / 5;
+			mLocs[i][1] = mHeight * ( i / 4 + 1 ) / 5;
+		}
+		mJet.Initialize( mHeight, mWidth, mLocs[0][0], mLocs[0][1], radius, kSigma,
+						 p->freqs, kMaxFreq, kMinFreq, p->angles );
+		mFlops = 4.0 * kNumLocs * p->angles * p->freqs * p->filter * p->filter;
+	#else
+		int spacing = Max( 1, p->filter / 4 );
+		mJet.SetLayout( p->layout );
+		mJet.SetBorder( p->border );
+		mJet.Initialize( mHeight, mWidth, p->filter, p->filter, spacing, spacing, kSigma,
+						 p->freqs, kMaxFreq, kMinFreq, p->angles );
+		double cells = (double)mJet.GetResponseHeight() * mJet.GetResponseWidth();
+		mFlops = ( p->layout != kLayoutCombined ? 8.0 : 4.0 ) * cells * p->angles * p->freqs * p->filter * p->filter;
+	// the image, the real and imaginary parts of the filters and the responses
+		mBytes = sizeof(float) * ( (double)mHeight * mWidth + 2.0 * p->angles * p->freqs * p->filter * p->filter + cells );
+		mJet.SetTiling( !p->untiled );
+		mColor = p->color;
+		mResponse = NULL;
+		if ( mColor )
+		{
+			mFlops = kColorChannels * mFlops;
+			mBytes = kColorChannels * mBytes;
+			mResponse = new float[kColorChannels*(int)cells];
+		}
+	#endif
+		mJet.SetEngine( p->engine );
+	}
+	~JetKernel()
+	{
+		DisposeMatrix( mImage, mHeight );
+	#if kBenchLocal
+		DisposeMatrix( mLocs, kNumLocs );
+	#else
+		delete[] mResponse;
+	#endif
+	}
+
+	void Run( void )
+	{
+		int len;
+	#if kBenchLocal
+		for ( int i = 0; i < kNumLocs; i++ )
+		{
+			mJet.SetLocation( mLocs[i][0], mLocs[i][1] );
+			mJet.Filter( mImage, &len );
+		}
+	#else
+		if ( mColor )
+		{
+			float**	images[kColorChannels] = { mImage, mImage, mImage };
+			mJet.FilterChannels( images, mResponse, &len );
+		}
+		else
+			mJet.Filter( mImage, &len );
+	#endif
+	}
+
+protected:
+
+	GaborJet	mJet;
+	float**		mImage;
+	int			mHeight, mWidth;
+#if kBenchLocal
+	int**		mLocs;
+#else
+	bool		mColor;
+	float*		mResponse;
+#endif
+};
+
+
+Kernel* NewRead( BenchParams* p ) { return new ReadKernel( p ); }
+Kernel* NewGray( BenchParams* p ) { return new GrayKernel( p ); }
+Kernel* NewContrast( BenchParams* p ) { return new ContrastKernel( p ); }
+Kernel* NewLogPolar( BenchParams* p ) { return new LogPolarKernel( p ); }
+Kernel* NewFilterInit( BenchParams* p ) { return new FilterInitKernel( p ); }
+Kernel* NewJet( BenchParams* p ) { return new JetKernel( p ); }
+
+
+int main( int argc, char *argv[] )
+{
+	ofstream	outfile;
+	int			arg = 1;
+
+	while ( arg < argc && argv[arg][0] == '-' )
+	{
+		if ( strcmp( argv[arg], "-T" ) == 0 && arg + 1 < argc ) gMinTime = atof( argv[++arg] );
+		else if ( strcmp( argv[arg], "-t" ) == 0 && arg + 1 < argc )
+		{
+			gMaxThreads = atoi( argv[++arg] );
+			gMaxThreads = Max( gMaxThreads, 1 );
+		}
+		else if ( strcmp( argv[arg], "-o" ) == 0 && arg + 1 < argc )
+		{
+			outfile.open( argv[++arg] );
+			if ( !outfile )
+			{
+				FileCreateError( argv[arg] );
+				return 1;
+			}
+			gOut = &outfile;
+		}
+		else if ( strcmp( argv[arg], "-q" ) == 0 ) gQuick = true;
+		else Usage();
+		arg++;
+	}
+
+	int		sizes[] = { 64, 128, 256, 512 };
+#if kBenchLocal
+	int		filters[] = { 20, 32, 64 };		// radius 10, 16 and 32
+#else
+	int		filters[] = { 8, 16, 32 };
+#endif
+	int		bank[][2] = { { 4, 2 }, { 6, 4 }, { 8, 4 } };
+	int		numSizes = gQuick ? 2 : 4;
+	int		numFilters = gQuick ? 1 : 3;
+	int		numBanks = gQuick ? 1 : 3;
+#if kBenchLocal
+	int		numLayouts = 1;
+#else
+	int		numLayouts = kNumLayouts;
+#endif
+	const char*	magics = "123456";
+
+	*gOut << "{" << endl;
+	*gOut << "  \"benchmark\": \"gaborbench\"," << endl;
+	*gOut << "  \"variant\": \"" << ( kBenchLocal ? "local" : "global" ) << "\"," << endl;
+	*gOut << "  \"cpus\": " << sysconf( _SC_NPROCESSORS_ONLN ) << "," << endl;
+	*gOut << "  \"min_time\": " << gMinTime << "," << endl;
+	*gOut << "  \"results\": [";
+
+	BenchParams	p;
+	memset( &p, 0, sizeof(p) );
+	p.filter = 8;
+	p.angles = 6;
+	p.freqs = 4;
+	p.threads = 1;
+
+// image decoding, one case per format
+	p.kernel = "pgm_read";
+	for ( int s = 0; s < numSizes; s++ )
+		for ( int m = 0; m < 6; m++ )
+		{
+			p.height = p.width = sizes[s];
+			p.magic = magics[m];
+			Measure( NewRead, &p );
+		}
+
+// color decoding fused with the grayscale conversion
+	p.kernel = "ppm_read_gray";
+	p.gray = true;
+	for ( int s = 0; s < numSizes; s++ )
+		for ( int m = 2; m < 6; m += 3 )
+		{
+			p.height = p.width = sizes[s];
+			p.magic = magics[m];
+			Measure( NewRead, &p );
+		}
+	p.gray = false;
+	p.magic = 0;
+
+// per-pixel stages
+	for ( int s = 0; s < numSizes; s++ )
+	{
+		p.height = p.width = sizes[s];
+		p.kernel = "rgb_to_gray";
+		Measure( NewGray, &p );
+		p.kernel = "logpolar";
+		Measure( NewLogPolar, &p );
+		p.kernel = "contrast";
+		for ( p.threads = 1; p.threads <= gMaxThreads; p.threads *= 2 ) Measure( NewContrast, &p );
+		p.threads = 1;
+	}
+
+// filter bank construction
+	p.kernel = "filter_init";
+	p.height = p.width = 0;
+	for ( int f = 0; f < numFilters; f++ )
+		for ( int b = 0; b < numBanks; b++ )
+		{
+			p.filter = filters[f];
+			p.angles = bank[b][0];
+			p.freqs = bank[b][1];
+			Measure( NewFilterInit, &p );
+		}
+
+// the convolution itself
+	p.kernel = kBenchLocal ? "jet_filter_local" : "jet_filter_global";
+	for ( int s = 0; s < numSizes; s++ )
+		for ( int f = 0; f < numFilters; f++ )
+			for ( int b = 0; b < numBanks; b++ )
+				for ( p.threads = 1; p.threads <= gMaxThreads; p.threads *= 2 )
+					for ( p.layout = 0; p.layout < numLayouts; p.layout++ )
+						for ( p.engine = 0; p.engine < kNumEngines; p.engine++ )
+						{
+							p.height = p.width = sizes[s];
+							p.filter = filters[f];
+							p.angles = bank[b][0];
+							p.freqs = bank[b][1];
+							if ( p.filter + 8 > p.height ) continue;
+						// a map per filter is always filtered by the generic loops
+							if ( p.layout != 0 && p.engine != kEngineGeneric ) continue;
+							Measure( NewJet, &p );
+						}
+
+#if !kBenchLocal
+// windows over the whole image, on a copy padded by each border policy
+	p.kernel = "jet_filter_border";
+	p.layout = kLayoutCombined;
+	p.filter = filters[0];
+	p.angles = bank[0][0];
+	p.freqs = bank[0][1];
+	p.threads = 1;
+	for ( int s = 0; s < numSizes; s++ )
+		for ( p.border = kBorderZero; p.border < kNumBorders; p.border++ )
+			for ( p.engine = 0; p.engine < kNumEngines; p.engine++ )
+			{
+				p.height = p.width = sizes[s];
+				Measure( NewJet, &p );
+			}
+	p.border = kBorderSkip;
+
+// the combined map one window at a time, for comparison with the tiles of jet_filter_global
+	p.kernel = "jet_filter_untiled";
+	p.untiled = true;
+	p.angles = bank[1 % numBanks][0];
+	p.freqs = bank[1 % numBanks][1];
+	for ( int s = 0; s < numSizes; s++ )
+		for ( int f = 0; f < numFilters; f++ )
+			for ( p.engine = 0; p.engine < kNumEngines; p.engine++ )
+			{
+				p.height = p.width = sizes[s];
+				p.filter = filters[f];
+				if ( p.filter + 8 > p.height || p.engine == kEngineInt16 ) continue;
+				Measure( NewJet, &p );
+			}
+	p.untiled = false;
+
+// the three channels of a color image in one pass
+	p.kernel = "jet_filter_color";
+	p.layout = kLayoutCombined;
+	p.color = true;
+	for ( int s = 0; s < numSizes; s++ )
+		for ( int f = 0; f < numFilters; f++ )
+			for ( int b = 0; b < numBanks; b++ )
+				for ( p.threads = 1; p.threads <= gMaxThreads; p.threads *= 2 )
+					for ( p.engine = 0; p.engine < kNumEngines; p.engine++ )
+					{
+						p.height = p.width = sizes[s];
+						p.filter = filters[f];
+						p.angles = bank[b][0];
+						p.freqs = bank[b][1];
+						if ( p.filter + 8 > p.height ) continue;
+						Measure( NewJet, &p );
+					}
+	p.color = false;
+#endif
+
+	*gOut << endl << "  ]" << endl << "}" << endl;
+	return 0;
+}
+
+
+// time a case: one warm-up run, then kTrials trials of p->threads threads each running
+// enough repetitions to take gMinTime, and write the best trial as a JSON record
+void Measure( KernelFactory factory, BenchParams* p )
+{
+	Kernel**	kernels = new Kernel*[p->threads];
+	Worker*		workers = new Worker[p->threads];
+	pthread_t*	threads = new pthread_t[p->threads];
+	long long	start, elapsed, best = 0;
+	int			reps;
+
+	for ( int t = 0; t < p->threads; t++ ) kernels[t] = factory( p );
+
+// warm up and size the trials
+	start = GetMicroseconds();
+	kernels[0]->Run();
+	elapsed = Max( GetMicroseconds() - start, 1LL );
+	reps = Max( 1, (int)( gMinTime * 1e6 / elapsed ) );
+
+	for ( int trial = 0; trial < kTrials; trial++ )
+	{
+		start = GetMicroseconds();
+		for ( int t = 0; t < p->threads; t++ )
+		{
+			workers[t].kernel = kernels[t];
+			workers[t].reps = reps;
+			if ( p->threads > 1 )
+				pthread_create( &threads[t], NULL, RunWorker, &workers[t] );
+			else
+				RunWorker( &workers[t] );
+		}
+		if ( p->threads > 1 )
+			for ( int t = 0; t < p->threads; t++ ) pthread_join( threads[t], NULL );
+		elapsed = Max( GetMicroseconds() - start, 1LL );
+		if ( trial == 0 || elapsed < best ) best = elapsed;
+	}
+
+	double	seconds = best * 1e-6;
+	double	runs = (double)reps * p->threads;
+	double	nsPerPixel = seconds * 1e9 / ( runs * kernels[0]->mPixels );
+	double	gflops = kernels[0]->mFlops * runs / seconds * 1e-9;
+	double	gbytes = kernels[0]->mBytes * runs / seconds * 1e-9;
+
+	*gOut << ( gFirstResult ? "" : "," ) << endl << "    { ";
+	*gOut << "\"kernel\": \"" << p->kernel << "\", ";
+	if ( p->height > 0 ) *gOut << "\"height\": " << p->height << ", \"width\": " << p->width << ", ";
+	if ( p->magic != 0 ) *gOut << "\"magic\": \"P" << p->magic << "\", ";
+	if ( factory == NewFilterInit || factory == NewJet )
+	{
+		*gOut << "\"filter\": " << p->filter << ", ";
+		*gOut << "\"angles\": " << p->angles << ", \"freqs\": " << p->freqs << ", ";
+	}
+	if ( factory == NewJet ) *gOut << "\"engine\": \"" << gEngineNames[p->engine] << "\", ";
+#if !kBenchLocal
+	if ( factory == NewJet ) *gOut << "\"layout\": \"" << gLayoutNames[p->layout] << "\", ";
+	if ( factory == NewJet ) *gOut << "\"border\": \"" << gBorderNames[p->border] << "\", ";
+#endif
+	*gOut << "\"threads\": " << p->threads << ", \"reps\": " << reps << ", ";
+	*gOut << "\"seconds\": " << seconds << ", ";
+	*gOut << "\"ns_per_pixel\": " << nsPerPixel << ", ";
+	*gOut << "\"gflops\": " << gflops;
+	if ( gbytes > 0.0 ) *gOut << ", \"gbytes_per_s\": " << gbytes;
+	*gOut << " }";
+	gOut->flush();
+	gFirstResult = false;
+
+	cerr << p->kernel << " ";
+	if ( p->height > 0 ) cerr << p->height << "x" << p->width << " ";
+	if ( factory == NewFilterInit || factory == NewJet ) cerr << "filter " << p->filter << " ";
+	if ( factory == NewJet ) cerr << gEngineNames[p->engine] << " ";
+#if !kBenchLocal
+	if ( factory == NewJet ) cerr << gLayoutNames[p->layout] << " " << gBorderNames[p->border] << " ";
+#endif
+	cerr << "threads " << p->threads;
+	cerr << ": " << nsPerPixel << " ns/pixel, " << gflops << " GFLOP/s";
+	if ( gbytes > 0.0 ) cerr << ", " << gbytes << " GB/s";
+	cerr << endl;
+
+	for ( int t = 0; t < p->threads; t++ ) delete kernels[t];
+	delete[] threads;
+	delete[] workers;
+	delete[] kernels;
+}
+
+
+void* RunWorker( void* arg )
+{
+	Worker* worker = (Worker*)arg;
+
+	for ( int i = 0; i < worker->reps; i++ ) worker->kernel->Run();
+	return NULL;
+}
+
+
+// grayscale synthetic image, optionally passed through the contrast filter as the
+// processing contexts do before convolution
+float** CreateInput( int h, int w, bool contrast )
+{
+	int***	rgb = CreateSyntheticRGB( h, w, kSeed );
+	float**	gray = CreateMatrix( (float)0.0, h, w );
+
+	ConvertToGray( rgb, gray, h, w );
+	DisposeSyntheticRGB( rgb, h );
+	if ( !contrast ) return gray;
+
+	ContrastFilter	filter( gray, h, w );
+	float**			map = CreateMatrix( (float)0.0, h - 8, w - 8 );
+	for ( int i = 0; i < h - 8; i++ )
+		for ( int j = 0; j < w - 8; j++ ) map[i][j] = filter.GetContrast()[i][j];
+	DisposeMatrix( gray, h );
+	return map;
+}
+
+
+void Usage( void )
+{
+    cerr << "Usage: gaborbench (-OPTIONS)" << endl;
+    cerr << "    -T = minimum seconds per timed trial (default 0.1)" << endl;
+    cerr << "    -t = highest number of threads to measure (default 4)" << endl;
+    cerr << "    -q = quick run over a small set of cases" << endl;
+    cerr << "    -o = write the JSON results to a file instead of stdout" << endl;
+	exit(0);
+}
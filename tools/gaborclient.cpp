@@ -0,0 +1,195 @@
+/*
+	Description:	Small client for the Gabor service mode, for local testing
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include "GaborGlobal.h"
+#include "GaborService.h"
+#include "Utilities.h"
+
+char		gSocketPath[256];	//	-D	: socket of a running service
+char		gCommand[1024];		//	-e	: service command to spawn on a pipe
+char		gOptions[1024];		//	-o	: options sent with each request
+char*		gFiducials = NULL;	//	-F	: fiducials sent with each request
+bool		gSendBytes = false;	//	-i	: send image bytes instead of paths
+int			gRepeat = 1;		//	-n	: number of times each image is sent
+bool		gStats = false;		//	-s	: ask the service for its latency statistics
+bool		gQuit = false;		//	-q	: ask the service to quit when done
+
+bool		Connect( int* in, int* out, pid_t* child );
+char*		ReadFile( char* file, int* len );
+void		Usage( void );
+
+
+int main( int argc, char *argv[] )
+{
+	int					arg = 1;
+	int					in, out, len;
+	int					capacity = 0;
+	float*				response = NULL;
+	char*				data;
+	pid_t				child = 0;
+	bool				fits = true;
+	GaborResponseHeader	header;
+	LatencyStats		roundTrip;
+
+	gSocketPath[0] = gCommand[0] = gOptions[0] = '\0';
+	while ( arg < argc && argv[arg][0] == '-' )
+	{
+		if ( strcmp( argv[arg], "-D" ) == 0 && arg + 1 < argc ) fits = CopyOption( gSocketPath, sizeof(gSocketPath), "-D", argv[++arg] );
+		else if ( strcmp( argv[arg], "-e" ) == 0 && arg + 1 < argc ) fits = CopyOption( gCommand, sizeof(gCommand), "-e", argv[++arg] );
+		else if ( strcmp( argv[arg], "-o" ) == 0 && arg + 1 < argc ) fits = CopyOption( gOptions, sizeof(gOptions), "-o", argv[++arg] );
+		else if ( strcmp( argv[arg], "-F" ) == 0 && arg + 1 < argc ) gFiducials = ReadFile( argv[++arg], &len );
+		else if ( strcmp( argv[arg], "-n" ) == 0 && arg + 1 < argc ) gRepeat = atoi( argv[++arg] );
+		else if ( strcmp( argv[arg], "-i" ) == 0 ) gSendBytes = true;
+		else if ( strcmp( argv[arg], "-s" ) == 0 ) gStats = true;
+		else if ( strcmp( argv[arg], "-q" ) == 0 ) gQuit = true;
+		else Usage();
+		if ( !fits ) return 1;
+		arg++;
+	}
+	if ( gSocketPath[0] == '\0' && gCommand[0] == '\0' ) Usage();
+	if ( ! Connect( &in, &out, &child ) ) return 1;
+
+// send each image and print its response in the same format as the command line tools
+	for ( int i = arg; i < argc; i++ )
+	{
+		data = argv[i];
+		len = strlen( argv[i] );
+		if ( gSendBytes && ( data = ReadFile( argv[i], &len ) ) == NULL ) continue;
+
+		for ( int n = 0; n < gRepeat; n++ )
+		{
+			long long start = GetMicroseconds();
+			if ( ! WriteRequest( out, gSendBytes ? kRequestImage : kRequestPath,
+								 gOptions, gFiducials, data, len ) ||
+				 ! ReadResponse( in, &header, &response, &capacity ) )
+			{
+				cerr << "Error: lost connection to service" << endl;
+				return 1;
+			}
+			roundTrip.Add( GetMicroseconds() - start );
+			if ( n > 0 ) continue;
+
+			if ( header.status != kStatusOK )
+			{
+				cerr << "Error: service returned status " << header.status << " for " << argv[i] << endl;
+				continue;
+			}
+			cout << "# " << argv[i] << " " << header.len << endl;
+			for ( int j = 0; j < header.len; j++ ) cout << response[j] << " ";
+			cout << endl;
+		}
+		if ( gSendBytes ) delete[] data;
+	}
+	roundTrip.Report( cerr, "client round trip" );
+
+	if ( gStats && WriteRequest( out, kRequestStats, NULL, NULL, NULL, 0 ) &&
+		 ReadResponse( in, &header, &response, &capacity ) && header.len == kStatsLen )
+	{
+		cerr << "service: " << (int)response[0] << " requests, latency p50 " << response[1];
+		cerr << " ms, p90 " << response[2] << " ms, p99 " << response[3];
+		cerr << " ms, max " << response[4] << " ms" << endl;
+	}
+	if ( gQuit && WriteRequest( out, kRequestQuit, NULL, NULL, NULL, 0 ) )
+		ReadResponse( in, &header, &response, &capacity );
+
+// hang up and let a spawned service run down
+	close( out );
+	if ( in != out ) close( in );
+	if ( child > 0 ) waitpid( child, NULL, 0 );
+
+	delete[] response;
+	delete[] gFiducials;
+	return 0;
+}
+
+
+// connect to the socket, or spawn the service command with its stdin/stdout on pipes
+bool Connect( int* in, int* out, pid_t* child )
+{
+	if ( gSocketPath[0] != '\0' )
+	{
+		struct sockaddr_un	addr;
+		int					sock = socket( AF_UNIX, SOCK_STREAM, 0 );
+
+		if ( strlen( gSocketPath ) >= sizeof(addr.sun_path) )
+		{
+			cerr << "Error: socket path too long: " << gSocketPath << endl;
+			if ( sock >= 0 ) close( sock );
+			return false;
+		}
+		memset( &addr, 0, sizeof(addr) );
+		addr.sun_family = AF_UNIX;
+		strcpy( addr.sun_path, gSocketPath );
+		if ( sock < 0 || connect( sock, (struct sockaddr*)&addr, sizeof(addr) ) < 0 )
+		{
+			FileOpenError( gSocketPath );
+			return false;
+		}
+		*in = *out = sock;
+		return true;
+	}
+
+	int	toChild[2], fromChild[2];
+	if ( pipe( toChild ) < 0 || pipe( fromChild ) < 0 ) return false;
+	*child = fork();
+	if ( *child < 0 ) return false;
+	if ( *child == 0 )
+	{
+		dup2( toChild[0], 0 );
+		dup2( fromChild[1], 1 );
+		close( toChild[1] );
+		close( fromChild[0] );
+		execl( "/bin/sh", "sh", "-c", gCommand, (char*)NULL );
+		_exit( 127 );
+	}
+	close( toChild[0] );
+	close( fromChild[1] );
+	*in = fromChild[0];
+	*out = toChild[1];
+	return true;
+}
+
+
+// read a whole file; the buffer is NUL-terminated and must be disposed by the caller
+char* ReadFile( char* file, int* len )
+{
+	ifstream infile( file, ios::in | ios::binary );
+
+	if ( !infile )
+	{
+		FileOpenError( file );
+		return NULL;
+	}
+	infile.seekg( 0, ios::end );
+	*len = (int)infile.tellg();
+	infile.seekg( 0, ios::beg );
+
+	char* data = new char[*len + 1];
+	infile.read( data, *len );
+	data[*len] = '\0';
+	return data;
+}
+
+
+void Usage( void )
+{
+    cerr << "Usage: gaborclient (-D <socket> | -e <command>) (-OPTIONS) <image files>" << endl;
+    cerr << "    -D = unix socket of a running service" << endl;
+    cerr << "    -e = service command to spawn, talking over its stdin/stdout" << endl;
+    cerr << "    -o = options sent with each request, e.g. \"-X 8 -Y 8 -a 6\"" << endl;
+    cerr << "    -F = text file with coordinates of fiducials (gaborlocal)" << endl;
+    cerr << "    -i = send the image bytes instead of the file name" << endl;
+    cerr << "    -n = send each image n times" << endl;
+    cerr << "    -s = print the latency statistics of the service" << endl;
+    cerr << "    -q = tell the service to quit when done" << endl;
+	exit(0);
+}
@@ -0,0 +1,446 @@
+/*
+	Description:	End-to-end throughput harness. Decodes and filters batches of synthetic
+					images with full ProcessFile runs over image size x threads x engine,
+					writes images/second and latency percentiles as CSV, compares them with
+					a stored baseline and checks the output on the sample files against
+					golden results. Exits with 1 on a regression or a golden mismatch.
+					Built once per library variant, as for the benchmark.
+	Author:			Adriaan Tijsseling (AGT)
+	Copyright: 		(c) Copyright 2002-3 Adriaan Tijsseling. All rights reserved.
+*/
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <sstream>
+#include "GaborGlobal.h"
+#include "GaborConfig.h"
+#include "GaborContext.h"
+#include "GaborService.h"
+#include "PGMImage.h"
+#include "WorkQueue.h"
+#include "Utilities.h"
+#include "SyntheticImage.h"
+
+// set by the Makefile when building against the fiducial library
+#ifndef kHarnessLocal
+#define kHarnessLocal	0
+#endif
+
+#define kSeed			20030401	// seed of the first synthetic image
+#define kNumLocs		16			// fiducials of the local variant, on a 4 x 4 grid
+
+// a named set of command line options
+struct Preset
+{
+	const char*		name;
+	const char*		options;
+};
+
+// a golden result: the response of the sample image under a preset
+struct Golden
+{
+	const char*		preset;		// options, as for the command line tool
+	const char*		images[2];	// sample images, NULL terminated
+	const char*		file;		// stored output in the golden directory
+};
+
+// realistic configurations, as in the quickstart of the README
+#if kHarnessLocal
+Preset	gPresets[] = { { "readme", "-s 15 -a 4 -f 2 -l 0.5 -u 0.75 -r 10" } };
+Golden	gGolden[] = { { "-s 15 -a 4 -f 2 -l 0.5 -u 0.75 -r 10", { "face.ppm", NULL }, "local-readme.txt" } };
+#else
+Preset	gPresets[] = { { "readme", "-X 8 -Y 8 -x 2 -y 2 -s 3 -a 6 -f 4 -l 0.25 -u 1.5" },
+					   { "default", "" } };
+Golden	gGolden[] = { { "-X 8 -Y 8 -x 2 -y 2 -s 3 -a 6 -f 4 -l 0.25 -u 1.5", { "lena.ppm", NULL }, "global-readme.txt" },
+					  { "", { "lena.ppm", "face.ppm" }, "global-default.txt" } };
+#endif
+
+// filter implementations to compare, selected by their options. Exact engines must match
+// the golden output within -e, lossy ones within the error bound given here.
+struct Engine
+{
+	const char*		name;
+	const char*		options;
+	float			bound;		// allowed deviation from the float engines, 0 if exact
+};
+
+Engine	gEngines[] = { { "generic", "-E generic", 0 }, { "auto", "-E auto", 0 }, 
+					   { "int16", "-E int16", 1e-3 } };
+
+#define kNumPresets		(int)( sizeof(gPresets) / sizeof(Preset) )
+#define kNumGolden		(int)( sizeof(gGolden) / sizeof(Golden) )
+#define kNumEngines		(int)( sizeof(gEngines) / sizeof(Engine) )
+
+// a batch of encoded images shared by the worker threads
+struct Job
+{
+	char**			data;		// PPM bytes per image
+	int*			lens;		// number of bytes per image
+	WorkQueue*		queue;		// indices of images still to be filtered
+	LatencyStats*	latency;	// decode and filter time per image
+};
+
+// what each worker thread owns
+struct Worker
+{
+	Job*			job;
+	GaborContext*	context;
+	PGMImage		image;
+	float*			response;
+};
+
+// lets PGMImage::Read parse image bytes without copying them
+class MemoryBuffer : public streambuf
+{
+public:
+	MemoryBuffer( char* data, int len ) { setg( data, data, data + len ); }
+};
+
+
+// GLOBALS
+int			gMaxThreads = 4;		//	-t	: highest thread count to measure
+bool		gQuick = false;			//	-q	: small sweep, for a smoke test
+float		gThreshold = 0.10;		//	-r	: allowed loss of throughput against the baseline
+float		gTolerance = 1e-5;		//	-e	: allowed deviation from the golden output
+char*		gBaseline = NULL;		//	-b	: baseline CSV to compare with
+char*		gGoldenDir = NULL;		//	-g	: directory with the sample images and golden/
+ostream*	gOut = &cout;			//	-o	: where the CSV goes
+
+// PROTOTYPES
+bool		ParseConfig( GaborConfig* config, const char* preset, const char* engine );
+void		Measure( Preset* preset, Engine* engine, int size, int threads, ostream& csv );
+void*		RunWorker( void* worker );
+int			CompareBaseline( char* file, string& results );
+int			CheckGolden( Golden* golden, Engine* engine );
+void		Usage( void );
+
+
+int main( int argc, char *argv[] )
+{
+	ofstream		outfile;
+	ostringstream	results;
+	int				arg = 1;
+	int				failures = 0;
+
+	while ( arg < argc && argv[arg][0] == '-' )
+	{
+		if ( strcmp( argv[arg], "-t" ) == 0 && arg + 1 < argc )
+		{
+			gMaxThreads = atoi( argv[++arg] );
+			gMaxThreads = Max( gMaxThreads, 1 );
+		}
+		else if ( strcmp( argv[arg], "-r" ) == 0 && arg + 1 < argc ) gThreshold = atof( argv[++arg] );
+		else if ( strcmp( argv[arg], "-e" ) == 0 && arg + 1 < argc ) gTolerance = atof( argv[++arg] );
+		else if ( strcmp( argv[arg], "-b" ) == 0 && arg + 1 < argc ) gBaseline = argv[++arg];
+		else if ( strcmp( argv[arg], "-g" ) == 0 && arg + 1 < argc ) gGoldenDir = argv[++arg];
+		else if ( strcmp( argv[arg], "-o" ) == 0 && arg + 1 < argc )
+		{
+			outfile.open( argv[++arg] );
+			if ( !outfile )
+			{
+				FileCreateError( argv[arg] );
+				return 1;
+			}
+			gOut = &outfile;
+		}
+		else if ( strcmp( argv[arg], "-q" ) == 0 ) gQuick = true;
+		else Usage();
+		arg++;
+	}
+
+// golden checks first: a fast engine with wrong output is of no use
+	if ( gGoldenDir != NULL )
+		for ( int e = 0; e < kNumEngines; e++ )
+			for ( int g = 0; g < kNumGolden; g++ ) failures += CheckGolden( &gGolden[g], &gEngines[e] );
+
+	int		sizes[] = { 128, 256, 512 };
+	int		numSizes = gQuick ? 1 : 3;
+
+	results << "variant,preset,engine,height,width,threads,images,seconds,images_per_s,p50_ms,p90_ms,p99_ms" << endl;
+	for ( int p = 0; p < kNumPresets; p++ )
+		for ( int e = 0; e < kNumEngines; e++ )
+			for ( int s = 0; s < numSizes; s++ )
+				for ( int t = 1; t <= gMaxThreads; t *= 2 )
+					Measure( &gPresets[p], &gEngines[e], sizes[s], t, results );
+
+	string	csv = results.str();
+	*gOut << csv;
+	gOut->flush();
+
+	if ( gBaseline != NULL ) failures += CompareBaseline( gBaseline, csv );
+	if ( failures > 0 ) cerr << failures << " check(s) failed" << endl;
+	return ( failures > 0 ) ? 1 : 0;
+}
+
+
+// settings of a preset with the options of an engine on top
+bool ParseConfig( GaborConfig* config, const char* preset, const char* engine )
+{
+	char	options[1024];
+	char*	argv[64];
+	int		argc;
+
+	strcpy( options, preset );
+	strcat( options, " " );
+	strcat( options, engine );
+	argc = SplitOptions( options, argv, 64 );
+	if ( config->ParseOptions( argc, argv, 0, NULL ) != argc ) return false;
+	config->verbosity = false;
+	config->saveFilter = false;
+	return true;
+}
+
+
+// decode and filter a batch of size x size synthetic images on a number of threads, each
+// with its own context. The contexts are warmed up on one image before the clock starts.
+void Measure( Preset* preset, Engine* engine, int size, int threads, ostream& csv )
+{
+	GaborConfig		config;
+	Job				job;
+	LatencyStats	latency;
+	int				numImages = Max( 8, 4 * threads );
+	Worker*			workers = new Worker[threads];
+	pthread_t*		ids = new pthread_t[threads];
+	int**			locations = NULL;
+
+	if ( ! ParseConfig( &config, preset->options, engine->options ) )
+	{
+		cerr << "Error: bad options for " << preset->name << "/" << engine->name << endl;
+		return;
+	}
+
+	job.data = new char*[numImages];
+	job.lens = new int[numImages];
+	job.latency = &latency;
+	for ( int i = 0; i < numImages; i++ )
+	{
+		int*** rgb = CreateSyntheticRGB( size, size, kSeed + i );
+		job.data[i] = EncodeSyntheticImage( rgb, size, size, '6', &job.lens[i] );
+		DisposeSyntheticRGB( rgb, size );
+	}
+
+#if kHarnessLocal
+// fiducials spread over the contrast map
+	locations = CreateMatrix( (int)0, kNumLocs, 2 );
+	for ( int i = 0; i < kNumLocs; i++ )
+	{
+		locations[i][0] = ( size - 8 ) * ( i % 4 + 1 ) / 5;
+		locations[i][1] = ( size - 8 ) * ( i / 4 + 1 ) / 5;
+	}
+#endif
+
+// warm up: every context filters one image, building its filter bank and arenas
+	for ( int t = 0; t < threads; t++ )
+	{
+		int len;
+		workers[t].job = &job;
+		workers[t].context = new GaborContext( config );
+		workers[t].image.SetVerbosity( false );
+	#if kHarnessLocal
+		workers[t].context->SetLocations( locations, kNumLocs );
+		workers[t].response = new float[workers[t].context->GetResponseLength()];
+	#else
+		workers[t].response = new float[workers[t].context->GetResponseLength( size, size )];
+	#endif
+		MemoryBuffer	buffer( job.data[0], job.lens[0] );
+		istream			stream( &buffer );
+		workers[t].context->PrepareImage( &workers[t].image );
+		workers[t].image.Read( stream );
+		workers[t].context->ProcessImage( (char*)"harness.ppm", &workers[t].image, 
+										  workers[t].response, &len );
+	}
+
+// timed pass
+	job.queue = new WorkQueue( numImages );
+	for ( int i = 0; i < numImages; i++ ) job.queue->Push( i );
+	job.queue->Close();
+
+	long long start = GetMicroseconds();
+	for ( int t = 0; t < threads; t++ ) pthread_create( &ids[t], NULL, RunWorker, &workers[t] );
+	for ( int t = 0; t < threads; t++ ) pthread_join( ids[t], NULL );
+	double seconds = ( GetMicroseconds() - start ) * 1e-6;
+
+	csv << ( kHarnessLocal ? "local" : "global" ) << "," << preset->name << "," << engine->name << ",";
+	csv << size << "," << size << "," << threads << "," << numImages << ",";
+	csv << seconds << "," << numImages / seconds << ",";
+	csv << latency.Percentile( 50 ) << "," << latency.Percentile( 90 ) << "," << latency.Percentile( 99 ) << endl;
+	cerr << preset->name << "/" << engine->name << " " << size << "x" << size << " threads " << threads;
+	cerr << ": " << numImages / seconds << " images/s, p50 " << latency.Percentile( 50 ) << " ms" << endl;
+
+// clean up
+	for ( int t = 0; t < threads; t++ )
+	{
+		delete workers[t].context;
+		delete[] workers[t].response;
+	}
+	for ( int i = 0; i < numImages; i++ ) delete[] job.data[i];
+	if ( locations != NULL ) DisposeMatrix( locations, kNumLocs );
+	delete job.queue;
+	delete[] job.data;
+	delete[] job.lens;
+	delete[] ids;
+	delete[] workers;
+}
+
+
+void* RunWorker( void* arg )
+{
+	Worker*	worker = (Worker*)arg;
+	Job*	job = worker->job;
+	int		i, len;
+
+	while ( job->queue->Pop( &i ) )
+	{
+		long long		start = GetMicroseconds();
+		MemoryBuffer	buffer( job->data[i], job->lens[i] );
+		istream			stream( &buffer );
+
+		worker->image.Read( stream );
+		worker->context->ProcessImage( (char*)"harness.ppm", &worker->image, worker->response, &len );
+		job->latency->Add( GetMicroseconds() - start );
+	}
+	return NULL;
+}
+
+
+// compare images/s with the rows of a baseline CSV that have the same variant, preset,
+// engine, size and threads; returns the number of regressions
+int CompareBaseline( char* file, string& results )
+{
+	ifstream		infile( file );
+	istringstream	current( results );
+	string			line, key;
+	int				regressions = 0, compared = 0;
+
+	if ( !infile )
+	{
+		FileOpenError( file );
+		return 1;
+	}
+
+// the key is everything up to the number of images, throughput is the 9th column
+	while ( getline( current, line ) )
+	{
+		if ( line.compare( 0, 8, "variant," ) == 0 ) continue;
+		size_t	pos = 0;
+		for ( int c = 0; c < 6 && pos != string::npos; c++ ) pos = line.find( ',', pos + 1 );
+		key = line.substr( 0, pos + 1 );
+
+		string	base;
+		infile.clear();
+		infile.seekg( 0, ios::beg );
+		while ( getline( infile, base ) )
+		{
+			if ( base.compare( 0, key.size(), key ) != 0 ) continue;
+
+			float	now, then;
+			string	field;
+			istringstream	a( line ), b( base );
+			for ( int c = 0; c < 9; c++ ) getline( a, field, ',' );
+			now = atof( field.c_str() );
+			for ( int c = 0; c < 9; c++ ) getline( b, field, ',' );
+			then = atof( field.c_str() );
+
+			compared++;
+			if ( now < then * ( 1.0 - gThreshold ) )
+			{
+				cerr << "REGRESSION " << key << " " << now << " images/s against " << then << endl;
+				regressions++;
+			}
+			break;
+		}
+	}
+	cerr << "baseline: " << compared << " cases compared, " << regressions << " regression(s)" << endl;
+	return regressions;
+}
+
+
+// filter the sample images under a preset and compare with the stored output
+int CheckGolden( Golden* golden, Engine* engine )
+{
+	GaborConfig		config;
+	char			path[512];
+	string			name;
+	int				failures = 0;
+	float			tolerance = Max( gTolerance, engine->bound );
+
+	if ( ! ParseConfig( &config, golden->preset, engine->options ) ) return 1;
+
+	sprintf( path, "%s/golden/%s", gGoldenDir, golden->file );
+	ifstream	expected( path );
+	if ( !expected )
+	{
+		FileOpenError( path );
+		return 1;
+	}
+
+	GaborContext	context( config );
+#if kHarnessLocal
+	int**	locations = NULL;
+	int		numLocs = 0;
+	sprintf( path, "%s/face-fiducials.txt", gGoldenDir );
+	ifstream fiducials( path );
+	if ( ! ReadLocations( fiducials, &locations, &numLocs ) )
+	{
+		FileOpenError( path );
+		return 1;
+	}
+	context.SetLocations( locations, numLocs );
+#endif
+
+	for ( int i = 0; i < 2 && golden->images[i] != NULL; i++ )
+	{
+		PGMImage	image;
+		float*		response = NULL;
+		int			len = 0, count = 0;
+		float		worst = 0.0;
+		char		hash;
+
+		sprintf( path, "%s/%s", gGoldenDir, golden->images[i] );
+		image.SetVerbosity( false );
+		context.PrepareImage( &image );
+		image.Read( path );
+		response = context.ProcessImage( path, &image, response, &len );
+
+	// each image is stored as "# name length" followed by the values
+		expected >> hash >> name >> count;
+		if ( count != len ) worst = 1e30;
+		for ( int j = 0; j < count; j++ )
+		{
+			float value;
+			expected >> value;
+			if ( j < len ) worst = Max( worst, (float)fabs( value - response[j] ) );
+		}
+		if ( !expected || worst > tolerance )
+		{
+			cerr << "GOLDEN MISMATCH " << golden->file << " " << name << " (" << engine->name;
+			cerr << "): length " << len << "/" << count << ", deviation " << worst << endl;
+			failures++;
+		}
+		else
+		{
+			cerr << "golden " << golden->file << " " << name << " (" << engine->name;
+			cerr << "): ok, deviation " << worst << endl;
+		}
+		delete[] response;
+	}
+
+#if kHarnessLocal
+	DisposeMatrix( locations, numLocs );
+#endif
+	return failures;
+}
+
+
+void Usage( void )
+{
+    cerr << "Usage: gaborharness (-OPTIONS)" << endl;
+    cerr << "    -g = directory with the sample images, checked against its golden/ output" << endl;
+    cerr << "    -e = allowed deviation from the golden output (default 1e-5)" << endl;
+    cerr << "    -b = baseline CSV to compare throughput with" << endl;
+    cerr << "    -r = allowed loss of throughput against the baseline (default 0.10)" << endl;
+    cerr << "    -t = highest number of threads to measure (default 4)" << endl;
+    cerr << "    -q = quick run on the smallest image size only" << endl;
+    cerr << "    -o = write the CSV to a file instead of stdout" << endl;
+	exit(0);
+}